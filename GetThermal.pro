@@ -16,7 +16,7 @@ DebugBuild {
     DESTDIR  = $${OUT_PWD}/release
 }
 
-QT += qml quick multimedia
+QT += qml quick multimedia concurrent
 
 QT_CONFIG -= no-pkg-config
 CONFIG += c++11 \
@@ -43,6 +43,26 @@ SOURCES += \
     src/dataformatter.cpp \
     src/rangeprovider.cpp \
     src/bosonvariation.cpp \
+    src/temporalstats.cpp \
+    src/focusmetric.cpp \
+    src/detailenhancer.cpp \
+    src/remapengine.cpp \
+    src/motiondetector.cpp \
+    src/duplicatedetector.cpp \
+    src/commandexecutor.cpp \
+    src/commandstats.cpp \
+    src/capabilitycache.cpp \
+    src/i2csensor.cpp \
+    src/i2csensormanager.cpp \
+    src/mlx90614.cpp \
+    src/camerastats.cpp \
+    src/leptonport.cpp \
+    src/simulatedlepton.cpp \
+    src/controlbenchmark.cpp \
+    src/virtualuvcdevice.cpp \
+    src/pipelinebenchmark.cpp \
+    src/bosonbenchmark.cpp \
+    src/syntheticscene.cpp \
     boson_sdk/Client_API.c \
     boson_sdk/Client_Dispatcher.c \
     boson_sdk/Client_Packager.c \
@@ -81,6 +101,29 @@ HEADERS += \
     inc/dataformatter.h \
     inc/rangeprovider.h \
     inc/bosonvariation.h \
+    inc/rowbands.h \
+    inc/temporalstats.h \
+    inc/focusmetric.h \
+    inc/detailenhancer.h \
+    inc/remapengine.h \
+    inc/motiondetector.h \
+    inc/duplicatedetector.h \
+    inc/frametelemetry.h \
+    inc/commandexecutor.h \
+    inc/functionthread.h \
+    inc/commandstats.h \
+    inc/capabilitycache.h \
+    inc/i2csensor.h \
+    inc/i2csensormanager.h \
+    inc/mlx90614.h \
+    inc/camerastats.h \
+    inc/leptonport.h \
+    inc/simulatedlepton.h \
+    inc/controlbenchmark.h \
+    inc/virtualuvcdevice.h \
+    inc/pipelinebenchmark.h \
+    inc/bosonbenchmark.h \
+    inc/syntheticscene.h \
     boson_sdk/Client_API.h \
     boson_sdk/Client_Dispatcher.h \
     boson_sdk/Client_Packager.h \
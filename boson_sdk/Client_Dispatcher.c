@@ -17,7 +17,31 @@
 
 #include "Client_Dispatcher.h"
 
+static CLIENT_DISPATCH_OBSERVER dispatchObserver;
+
+void CLIENT_setDispatchObserver(const CLIENT_DISPATCH_OBSERVER *observer) {
+	if (observer) {
+		dispatchObserver = *observer;
+	} else {
+		dispatchObserver.begin = 0;
+		dispatchObserver.end = 0;
+		dispatchObserver.context = 0;
+	}
+}
+
+static FLR_RESULT dispatch(uint32_t seqNum, FLR_FUNCTION fnID, const uint8_t *sendData, const uint32_t sendBytes, const uint8_t *receiveData, uint32_t *receiveBytes);
+
 FLR_RESULT CLIENT_dispatcher(uint32_t seqNum, FLR_FUNCTION fnID, const uint8_t *sendData, const uint32_t sendBytes, const uint8_t *receiveData, uint32_t *receiveBytes) {
+	if (!dispatchObserver.begin || !dispatchObserver.end)
+		return dispatch(seqNum, fnID, sendData, sendBytes, receiveData, receiveBytes);
+
+	uint64_t token = dispatchObserver.begin(dispatchObserver.context, fnID);
+	FLR_RESULT result = dispatch(seqNum, fnID, sendData, sendBytes, receiveData, receiveBytes);
+	dispatchObserver.end(dispatchObserver.context, fnID, result, token);
+	return result;
+}
+
+static FLR_RESULT dispatch(uint32_t seqNum, FLR_FUNCTION fnID, const uint8_t *sendData, const uint32_t sendBytes, const uint8_t *receiveData, uint32_t *receiveBytes) {
 	
 	uint32_t i;
 	
@@ -96,4 +120,4 @@ FLR_RESULT CLIENT_dispatcher(uint32_t seqNum, FLR_FUNCTION fnID, const uint8_t *
 	}
 	
 	return R_SUCCESS;
-} // End CLIENT_dispatcher()
+} // End dispatch()
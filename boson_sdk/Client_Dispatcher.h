@@ -26,5 +26,16 @@
 
 FLR_RESULT CLIENT_dispatcher(uint32_t seqNum, FLR_FUNCTION fnID, const uint8_t *sendData, const uint32_t sendBytes, const uint8_t *receiveData, uint32_t *receiveBytes);
 
+// Optional instrumentation around each dispatched command: begin's return
+// value is handed back to end along with the result.
+typedef struct {
+	uint64_t (*begin)(void *context, FLR_FUNCTION fnID);
+	void (*end)(void *context, FLR_FUNCTION fnID, FLR_RESULT result, uint64_t token);
+	void *context;
+} CLIENT_DISPATCH_OBSERVER;
+
+// NULL removes the observer
+void CLIENT_setDispatchObserver(const CLIENT_DISPATCH_OBSERVER *observer);
+
 
 #endif
@@ -27,6 +27,7 @@ void send_to_camera(libusb_device_handle *devh, uint8_t channel_ID, uint32_t sen
 // void read_command(int32_t port_num, uint8_t channel_ID, uint32_t sendBytes, uint8_t *sendPayload, uint32_t *receiveBytes, uint8_t *receivePayload);
 void read_frame(libusb_device_handle *devh,uint8_t channel_ID, uint16_t start_byte_ms,uint32_t *receiveBytes, uint8_t *receiveBuffer);
 void read_unframed(libusb_device_handle *devh, uint16_t start_byte_ms,uint32_t *receiveBytes, uint8_t *receiveBuffer);
+void get_transport_stats(TRANSPORT_STATS *stats);
 
 static uint8_t isInitialized = 0;
 
@@ -79,3 +80,8 @@ void ReadUnframed(uint32_t *receiveBytes, uint8_t *receiveData)
 	// hardcoded 25ms polling delay for now
     read_unframed(devh, 25, receiveBytes,receiveData);
 }
+
+void GetTransportStats(TRANSPORT_STATS *stats)
+{
+    get_transport_stats(stats);
+}
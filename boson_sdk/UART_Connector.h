@@ -19,10 +19,25 @@
 #include <stdint.h>
 #include "ReturnCodes.h"
 
+// Counters since Initialize, for comparing transports. Round trip is from
+// sending a command to its response frame; CPU is on the calling thread,
+// plus, with the async transport, in transfer callbacks.
+typedef struct {
+	uint8_t async;
+	uint64_t commands;
+	uint64_t timeouts;
+	uint64_t roundTripNs;
+	uint64_t callerCpuNs;
+	uint64_t callbackCpuNs;
+	uint64_t bytesReceived;
+	uint32_t overruns;
+} TRANSPORT_STATS;
+
 void SendToCamera( uint8_t channelID,  uint32_t sendBytes, uint8_t *sendData);
 void ReadFrame( uint8_t channelID, uint32_t *receiveBytes, uint8_t *receiveData);
 void ReadUnframed(uint32_t *receiveBytes, uint8_t *receiveData);
 FLR_RESULT Initialize(libusb_device_handle *devh);
 void Close();
+void GetTransportStats(TRANSPORT_STATS *stats);
 
 #endif //UART_CONNECTOR_H
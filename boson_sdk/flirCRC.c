@@ -124,3 +124,15 @@ uint16_t calcFlirCRC16Bytes(unsigned int count, char *buffer)
 
    return (uint16_t) crc;
 }
+
+//
+//  ===== updateFlirCRC16Bytes =====
+//      Continue a CRC over a buffer of 8-bit bytes, e.g. as the bytes
+//  arrive; start from FLIR_CRC_INITIAL_VALUE.  count may be 0.
+//
+uint16_t updateFlirCRC16Bytes(uint16_t crc, unsigned int count, const uint8_t *buffer)
+{
+   while ( count-- )
+      crc = (uint16_t)((crc << 8) ^ ccitt_16Table[((crc >> 8) ^ *buffer++) & 255]);
+   return crc;
+}
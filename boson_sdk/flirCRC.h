@@ -8,4 +8,5 @@
 uint16_t calcFlirCRC16Words(unsigned int count, short *buffer);
 uint16_t calcFlirCRC16Bytes(unsigned int count, char *buffer);
 int ByteCRC16(int value, int crcin);
+uint16_t updateFlirCRC16Bytes(uint16_t crc, unsigned int count, const uint8_t *buffer);
 #endif // _FLIR_CRC_H_
@@ -1,5 +1,7 @@
 #include "flirChannels.h"
 
+#include <string.h>
+
 static uint8_t is_initialized = 0;
 
 int16_t get_channel(uint8_t channel_ID, CHANNEL_T **return_channel){
@@ -19,11 +21,9 @@ void get_unframed(CHANNEL_T **return_channel){
 }
 
 void add_byte(uint8_t inbyte,CHANNEL_T *channel_ptr){
-	uint32_t index;
 	uint16_t start = (channel_ptr->start);
 	if (channel_ptr->len != CHANNEL_BUF_SIZ){
-		index = start + (channel_ptr->len);
-		(channel_ptr->buff)[index] = inbyte;
+		(channel_ptr->buff)[(start + channel_ptr->len) % CHANNEL_BUF_SIZ] = inbyte;
 		(channel_ptr->len)++;
 	} else {
 		(channel_ptr->buff)[start] = inbyte;
@@ -31,17 +31,50 @@ void add_byte(uint8_t inbyte,CHANNEL_T *channel_ptr){
 	}
 }
 
+void add_bytes(const uint8_t *inbytes, uint32_t count, CHANNEL_T *channel_ptr){
+	//oldest bytes are overwritten when full, as with add_byte
+	uint32_t index, span;
+	if (count > CHANNEL_BUF_SIZ) {
+		inbytes += count - CHANNEL_BUF_SIZ;
+		count = CHANNEL_BUF_SIZ;
+	}
+	index = (channel_ptr->start + channel_ptr->len) % CHANNEL_BUF_SIZ;
+	span = CHANNEL_BUF_SIZ - index;
+	if (span > count) span = count;
+	memcpy(&(channel_ptr->buff)[index], inbytes, span);
+	memcpy(channel_ptr->buff, inbytes + span, count - span);
+	if (channel_ptr->len + count > CHANNEL_BUF_SIZ) {
+		channel_ptr->start = (channel_ptr->start + channel_ptr->len + count - CHANNEL_BUF_SIZ) % CHANNEL_BUF_SIZ;
+		channel_ptr->len = CHANNEL_BUF_SIZ;
+	} else {
+		channel_ptr->len += count;
+	}
+}
+
 int32_t get_byte(uint8_t *outbyte,CHANNEL_T *channel_ptr){
 	//return remaining length if success, -1 if channel already empty
 	if (channel_ptr->len == 0) {
 		return -1;
 	} else {
 		*outbyte = (channel_ptr->buff)[(channel_ptr->start)];
-		(channel_ptr->start)++;
+		(channel_ptr->start) = (channel_ptr->start + 1)%CHANNEL_BUF_SIZ;
 		return --(channel_ptr->len);
 	}
 }
 
+int32_t peek_bytes(uint8_t **outbytes,CHANNEL_T *channel_ptr){
+	//return how many bytes from the front are contiguous, without removing them
+	uint32_t span = CHANNEL_BUF_SIZ - channel_ptr->start;
+	*outbytes = &(channel_ptr->buff)[(channel_ptr->start)];
+	return channel_ptr->len < span ? channel_ptr->len : span;
+}
+
+void drop_bytes(uint32_t count,CHANNEL_T *channel_ptr){
+	if (count > channel_ptr->len) count = channel_ptr->len;
+	(channel_ptr->start) = (channel_ptr->start + count)%CHANNEL_BUF_SIZ;
+	(channel_ptr->len) -= count;
+}
+
 void initialize_channels(){
 	if (is_initialized==0) {
 		chan_ptr = &(channel_list[0]);
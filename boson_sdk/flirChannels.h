@@ -22,7 +22,10 @@ extern void initialize_channels();
 extern int16_t get_channel(uint8_t channel_ID, CHANNEL_T **return_channel);
 extern void get_unframed(CHANNEL_T **return_channel);
 extern void add_byte(uint8_t inbyte,CHANNEL_T *channel_ptr);
+extern void add_bytes(const uint8_t *inbytes, uint32_t count, CHANNEL_T *channel_ptr);
 extern int32_t get_byte(uint8_t *outbyte,CHANNEL_T *channel_ptr);
+extern int32_t peek_bytes(uint8_t **outbytes,CHANNEL_T *channel_ptr);
+extern void drop_bytes(uint32_t count,CHANNEL_T *channel_ptr);
 
 /* Maybe later if number of channels becomes large.
 int16_t channel_nums[256] = {
@@ -2,8 +2,23 @@
 #include <libusb-1.0/libusb.h>
 #include "flirCRC.h"
 #include "flirChannels.h"
+#include "UART_Connector.h"
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(Q_OS_WIN32) && !defined(BOSON_SYNC_TRANSPORT)
+// the async transport needs pthreads; Windows keeps the blocking one
+#define BOSON_SYNC_TRANSPORT
+#endif
+#ifndef BOSON_SYNC_TRANSPORT
+#include <errno.h>
+#include <pthread.h>
+#endif
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #ifdef Q_OS_WIN32
 
@@ -63,18 +78,110 @@ static int IF_CDC_DATA = 3;
 #define POLL_TIMEOUT_SEC   0.025
 #define BYTE_TIMEOUT_SEC    0.005
 
-static uint8_t in_frame_buf[FRAME_BUF_SIZ];
 static uint8_t out_frame_buf[FRAME_BUF_SIZ];
 
 enum frame_state_e {
     UNFRAMED = 0,
     CORRECT_FRAME = 1,
     OTHER_FRAME = 2,
+    FRAME_START = 3,
 };
 typedef enum frame_state_e frame_state;
 
-static frame_state am_in_frame;
-static uint8_t other_frame_ID;
+/* Incoming bytes are decoded a block at a time: the runs between start,
+ * end and escape bytes are found with find_special() and copied whole,
+ * and the CRC is brought up to date after each block instead of over the
+ * finished frame. The decoder keeps all of its state here, so it can live
+ * on the stack of whoever is reading.
+ */
+struct frame_decoder {
+    uint8_t channel_ID;     // frames for this channel are decoded into buf
+    frame_state state;
+    uint8_t in_escape;
+    CHANNEL_T *other;       // where another channel's frame goes, still framed; NULL drops it
+    CHANNEL_T *unframed;    // where bytes outside frames go; NULL drops them
+    uint32_t len;           // channel ID, payload and CRC bytes in buf
+    uint32_t crc_len;       // how many of them crc covers
+    uint16_t crc;
+    uint8_t buf[FRAME_BUF_SIZ];
+};
+
+#define IN_BLOCK_SIZ        4096
+// from reading: nothing more will arrive until the port is reopened
+#define RX_FAILED           (-2)
+
+/* The reading side of a port: what was read but not yet decoded, as a
+ * block can end with the start of the frame after the one asked for.
+ */
+struct frame_reader {
+    uint8_t block[IN_BLOCK_SIZ];
+    uint32_t pos, len;
+};
+
+// the open port's
+static struct frame_reader port_reader;
+
+/* Define BOSON_SYNC_TRANSPORT to read with a blocking bulk transfer per
+ * 512 bytes, as before, e.g. to compare against the async transport. */
+#ifndef BOSON_SYNC_TRANSPORT
+
+/* The IN endpoint always has transfers posted; their completions append to
+ * a byte ring that readers wait on. Commands no longer pay for a transfer
+ * setup and teardown per read, and bytes that arrive between commands are
+ * kept.
+ *
+ * There is no event thread here: completions run on libuvc's. libuvc starts
+ * one for a libusb context it created itself (uvc_init with a NULL libusb
+ * context, as UvcAcquisition does) at the first uvc_open and stops it at the
+ * last uvc_close, and it doesn't hand that context out for a thread of our
+ * own. So the port has to be opened on a handle from such a context and
+ * closed before the device is; open_port checks that events are handled
+ * and fails otherwise. */
+#define IN_TRANSFERS        2
+#define IN_TRANSFER_SIZ     512
+#define RX_RING_SIZ         65536
+#define RX_WAIT_MS          100
+#define OUT_TIMEOUT_MS      1000
+#define CANCEL_WAIT_MS      1000
+// bad packets in a row before the channel is given up on
+#define MAX_IN_ERRORS       16
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int initialized;
+
+    uint8_t ring[RX_RING_SIZ];
+    uint32_t head, tail; // free-running, head - tail bytes are waiting
+    uint32_t overruns;
+    uint64_t bytes;
+
+    struct libusb_transfer *in[IN_TRANSFERS];
+    uint8_t in_buf[IN_TRANSFERS][IN_TRANSFER_SIZ];
+    int in_flight;
+    int stopping;
+    int in_errors;
+    int failed;
+
+    struct libusb_transfer *out;
+    int out_done;
+    struct libusb_transfer *probe;
+    uint64_t callback_cpu_ns;
+} rx;
+
+#endif
+
+// round trips and CPU, for comparing transports
+static struct {
+    uint64_t commands, timeouts;
+    uint64_t round_trip_ns, caller_cpu_ns;
+    uint64_t pending_since_ns, pending_cpu_ns;
+} transport_stats;
+
+#ifndef BOSON_SYNC_TRANSPORT
+static int start_transport(libusb_device_handle *devh);
+static void stop_transport(void);
+#endif
 
 uint8_t open_port(libusb_device_handle *devh){
 
@@ -87,12 +194,26 @@ uint8_t open_port(libusb_device_handle *devh){
     if (rc < 0) {
         fprintf(stderr, "Error claiming interface: %s\n",
                 libusb_error_name(rc));
+        return (uint8_t) rc;
     }
 
+    memset(&transport_stats, 0, sizeof(transport_stats));
+    port_reader.pos = port_reader.len = 0;
+#ifndef BOSON_SYNC_TRANSPORT
+    rc = start_transport(devh);
+    if (rc < 0) {
+        fprintf(stderr, "Error starting transport: %s\n", libusb_error_name(rc));
+        libusb_release_interface(devh, IF_CDC_DATA);
+    }
+#endif
+
     return (uint8_t) rc; // 0 == success.
 }
 
 void close_port(libusb_device_handle *devh){
+#ifndef BOSON_SYNC_TRANSPORT
+    stop_transport();
+#endif
     libusb_release_interface(devh, IF_CDC_DATA);
 }
 
@@ -103,398 +224,664 @@ double diff_timespec(struct timespec *current, struct timespec *reference)
     return elapsed_sec;
 }
 
-static int16_t read_byte(libusb_device_handle *devh)
+static uint64_t clock_ns(int clock)
 {
-    struct timespec start_t,current_t;
-    double elapsed_sec;
-    clock_gettime(CLOCK_MONOTONIC, &start_t);
+    struct timespec t;
+    clock_gettime(clock, &t);
+    return (uint64_t)t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
 
-    /* To receive characters from the device initiate a bulk_transfer to the
-     * Endpoint with address ep_in_addr.
-     */
-    static int actual_length = 0, index = 0;
-    static uint8_t in_byte[512] = { 0 };
-    if (index >= actual_length)
-    {
-        index = 0;
-        int rc = libusb_bulk_transfer(devh, EP_IN_ADDR, in_byte, sizeof(in_byte), &actual_length, 1000);
-        if (rc == LIBUSB_ERROR_TIMEOUT) {
-            printf("%s (%d)\n", libusb_error_name(rc), actual_length);
-            return -1;
-        } else if (rc < 0) {
-            fprintf(stderr, "Error while waiting for char: %s\n", libusb_error_name(rc));
-            return -1;
+// CPU time of the calling thread, 0 where there is no clock for it
+static uint64_t thread_cpu_ns(void)
+{
+#ifdef CLOCK_THREAD_CPUTIME_ID
+    return clock_ns(CLOCK_THREAD_CPUTIME_ID);
+#else
+    return 0;
+#endif
+}
+
+#ifndef BOSON_SYNC_TRANSPORT
+
+// with rx.lock held
+static void fail_channel(int status)
+{
+    if (!rx.failed)
+        fprintf(stderr, "Boson command channel failed (transfer status %d), reopen the camera\n", status);
+    rx.failed = 1;
+}
+
+static void LIBUSB_CALL in_callback(struct libusb_transfer *transfer)
+{
+    uint64_t cpu_start = thread_cpu_ns();
+    int resubmit = 1;
+    pthread_mutex_lock(&rx.lock);
+
+    switch (transfer->status) {
+    case LIBUSB_TRANSFER_COMPLETED: {
+        uint32_t len = transfer->actual_length;
+        uint32_t space = RX_RING_SIZ - (rx.head - rx.tail);
+        if (len > space) {
+            // nobody is reading; the newest bytes go
+            rx.overruns++;
+            len = space;
         }
+        uint32_t at = rx.head % RX_RING_SIZ;
+        uint32_t first = len < RX_RING_SIZ - at ? len : RX_RING_SIZ - at;
+        memcpy(&rx.ring[at], transfer->buffer, first);
+        memcpy(rx.ring, transfer->buffer + first, len - first);
+        rx.head += len;
+        rx.bytes += len;
+        rx.in_errors = 0;
+        break;
     }
-    return in_byte[index++];
+    case LIBUSB_TRANSFER_TIMED_OUT:
+        break;
+    case LIBUSB_TRANSFER_CANCELLED:
+        resubmit = 0;
+        break;
+    case LIBUSB_TRANSFER_ERROR:
+    case LIBUSB_TRANSFER_OVERFLOW:
+        // a bad packet; the endpoint goes on working
+        fprintf(stderr, "Boson IN transfer failed: %d\n", transfer->status);
+        if (++rx.in_errors > MAX_IN_ERRORS)
+            fail_channel(transfer->status);
+        break;
+    default:
+        // stalled or unplugged: nothing more comes without a reopen
+        fail_channel(transfer->status);
+        break;
+    }
+
+    if (rx.stopping || rx.failed)
+        resubmit = 0;
+    if (resubmit && libusb_submit_transfer(transfer) < 0) {
+        fail_channel(transfer->status);
+        resubmit = 0;
+    }
+    if (!resubmit)
+        rx.in_flight--;
+
+    pthread_cond_broadcast(&rx.cond);
+    rx.callback_cpu_ns += thread_cpu_ns() - cpu_start;
+    pthread_mutex_unlock(&rx.lock);
 }
 
-static void extract_payload(uint8_t* raw_payload_buf, uint32_t raw_payload_len, uint8_t* payload_buf, uint32_t* payload_len)
+/* Frames are copied into a buffer the transfer owns, so one abandoned in
+ * flight never points at the next frame being built. */
+static struct libusb_transfer *alloc_out_transfer(void)
 {
-    uint32_t i;
+    struct libusb_transfer *transfer = libusb_alloc_transfer(0);
+    if (transfer == NULL)
+        return NULL;
+    transfer->buffer = malloc(FRAME_BUF_SIZ);
+    if (transfer->buffer == NULL) {
+        libusb_free_transfer(transfer);
+        return NULL;
+    }
+    transfer->flags = LIBUSB_TRANSFER_FREE_BUFFER;
+    return transfer;
+}
 
-    for(*payload_len=0, i=0; i < raw_payload_len; i++)
-    {
-        // if (raw_payload_buf[i] == ESCAPE_BYTE) i++;
-        payload_buf[(*payload_len)++] = raw_payload_buf[i];
+static void LIBUSB_CALL out_callback(struct libusb_transfer *transfer)
+{
+    pthread_mutex_lock(&rx.lock);
+    if (transfer != rx.out) {
+        // write_frame gave up waiting for this one and has a new one
+        libusb_free_transfer(transfer);
+    } else {
+        rx.out_done = 1;
+        pthread_cond_broadcast(&rx.cond);
     }
+    pthread_mutex_unlock(&rx.lock);
 }
 
-void read_frame(libusb_device_handle *devh,uint8_t channel_ID, uint16_t start_byte_ms,uint32_t *receiveBytes, uint8_t *receiveBuffer)
+// on the monotonic clock, which rx.cond waits against
+static void deadline_after(struct timespec *deadline, int ms)
 {
-    int byte_idx = 0;
-    int tempval = 0;
-    frame_state am_in_frame = UNFRAMED;
-    uint8_t found_complete_frame=0, in_escape=0;
-    uint8_t c;
-    // uint8_t failedcrc = 0;
-    uint16_t calc_crc;
+    clock_gettime(CLOCK_MONOTONIC, deadline);
+    uint64_t ns = (uint64_t)deadline->tv_nsec + (uint64_t)ms * 1000000;
+    deadline->tv_sec += ns / 1000000000;
+    deadline->tv_nsec = ns % 1000000000;
+}
 
-    tempval = get_channel(channel_ID, &chan_ptr);
-    get_unframed(&unframed_ptr);
+// with rx.lock held: 0 when signalled, ETIMEDOUT once the deadline passes
+static int wait_until(const struct timespec *deadline)
+{
+#ifdef __APPLE__
+    // no pthread_condattr_setclock; a relative wait doesn't follow the wall clock either
+    struct timespec now, left;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    left.tv_sec = deadline->tv_sec - now.tv_sec;
+    left.tv_nsec = deadline->tv_nsec - now.tv_nsec;
+    if (left.tv_nsec < 0) {
+        left.tv_sec--;
+        left.tv_nsec += 1000000000;
+    }
+    if (left.tv_sec < 0)
+        return ETIMEDOUT;
+    return pthread_cond_timedwait_relative_np(&rx.cond, &rx.lock, &left);
+#else
+    return pthread_cond_timedwait(&rx.cond, &rx.lock, deadline);
+#endif
+}
 
-    struct timespec start_t,current_t;
-    double elapsed_sec;
-    clock_gettime(CLOCK_MONOTONIC, &start_t);
-    double timeout = (double)start_byte_ms/1000.0;
-    *receiveBytes =  0;
+static void LIBUSB_CALL probe_callback(struct libusb_transfer *transfer)
+{
+    pthread_mutex_lock(&rx.lock);
+    if (transfer == rx.probe) {
+        rx.probe = NULL;
+        pthread_cond_broadcast(&rx.cond);
+    }
+    pthread_mutex_unlock(&rx.lock);
+}
 
-    if (tempval > 0 && chan_ptr->len > 0){
-#ifdef DEBUGPRINT
-        int i,j;
-        printf("POLL buffer start = %d, len = %d \n",chan_ptr->start,chan_ptr->len);
-        printf("current buffer[20] : ");
-        for (j=0; j<20; j++){
-            i = ( (chan_ptr->start + j ) % CHANNEL_BUF_SIZ);
-            printf(" %02X",chan_ptr->buff[i]);
-        }
-        printf("\n");
-#endif
-        while(chan_ptr->len > 0){
-// #ifdef DEBUGPRINT
-            // if (i==poll_idx_lo) printf("Entered PROCESS_BUFF_%02d\n",chan_ptr->channel);
-// #endif
-            tempval = get_byte(&c,chan_ptr);
-            if (tempval < 0){
-                break;
-            }
-            if (c == START_FRAME_BYTE)
-            {
-#ifdef DEBUGPRINT
-                printf("     POLL_RX_BUF StartByte \n ");
-#endif
-                timeout = FRAME_TIMEOUT_SEC;
-                byte_idx = 0;
-                am_in_frame = CORRECT_FRAME;
-                continue;
-            }
-            if (am_in_frame) {
-
-                if (c == ESCAPE_BYTE)
-                {
-                    in_escape = 1;
-                    tempval = get_byte(&c,chan_ptr);
-                    if (tempval < 0){
-                        break;
-                    }
-                    switch (c){
-                        case ESCAPED_END_FRAME_BYTE:
-                            c = END_FRAME_BYTE;
-                            break;
-                        case ESCAPED_START_FRAME_BYTE:
-                            c = START_FRAME_BYTE;
-                            break;
-                        case ESCAPED_ESCAPE_BYTE:
-                            c = ESCAPE_BYTE;
-                            break;
-                        default:
-                            break;
-                    }
-                    in_frame_buf[byte_idx++] = c;
-#ifdef DEBUGPRINT
-                    printf(" %02X",c);
-#endif
-                    continue;
-                }
+/* With rx.lock held: 0 if a thread is handling events for the handle's
+ * context, found with a GET_STATUS that needs nothing from the data
+ * interface. One that never completes is freed by libusb if it ever does. */
+static int check_event_thread(libusb_device_handle *devh)
+{
+    struct timespec deadline;
+    struct libusb_transfer *probe = libusb_alloc_transfer(0);
+    uint8_t *buf = malloc(LIBUSB_CONTROL_SETUP_SIZE + 2);
+    int rc;
 
-                if (c == END_FRAME_BYTE)
-                {
-                    am_in_frame = UNFRAMED;
-                    /*
-                     * Check CRC: if good end loop.  If bad, start looking for start byte.
-                     * Check Frame Status:  If zero, end loop.  If non-zero, start looking for start byte.
-                     */
-
-                     /*
-                      * byte_idx - 3 = total frame length - channel_ID byte - crc_bytes[2]
-                      * &(frame_buf[1]) is first byte after channel_ID byte
-                      */
-                    calc_crc = calcFlirCRC16Bytes((byte_idx - 2), &(in_frame_buf[CRC_START_IDX]));
-
-                    if ( (((calc_crc >> 8) &0xFF) != in_frame_buf[byte_idx - 2]) || ((calc_crc &0xFF) != in_frame_buf[byte_idx - 1]) )
-                    {
-                        printf("\nFailed packet integrity check (calc) %02X%02X !=  (recd) %02X%02X\n",((calc_crc >> 8) &0xFF),(calc_crc&0xFF),in_frame_buf[byte_idx - 2],in_frame_buf[byte_idx - 1]);
-                        printf("RAW Receive Packet: ");
-                        for (tempval=0;tempval<byte_idx;tempval++){
-                            printf(" %02X",in_frame_buf[tempval]);
-                        }
-                        printf("\n");
-                        // printf("     Failed time %f:\n",elapsed_sec);
-                        // failedcrc = 1;
-                        byte_idx = 0;
-
-                        timeout=POLL_TIMEOUT_SEC;
-                        continue;
-                    }
-#ifdef DEBUGPRINT
-                    else {
-                        printf("\n");
-                    }
+    if (probe == NULL || buf == NULL) {
+        libusb_free_transfer(probe);
+        free(buf);
+        return LIBUSB_ERROR_NO_MEM;
+    }
+    libusb_fill_control_setup(buf, LIBUSB_ENDPOINT_IN | LIBUSB_REQUEST_TYPE_STANDARD | LIBUSB_RECIPIENT_DEVICE,
+                              LIBUSB_REQUEST_GET_STATUS, 0, 0, 2);
+    libusb_fill_control_transfer(probe, devh, buf, probe_callback, NULL, OUT_TIMEOUT_MS);
+    probe->flags = LIBUSB_TRANSFER_FREE_BUFFER | LIBUSB_TRANSFER_FREE_TRANSFER;
+    rc = libusb_submit_transfer(probe);
+    if (rc < 0) {
+        libusb_free_transfer(probe);
+        return rc;
+    }
+    rx.probe = probe;
+    deadline_after(&deadline, OUT_TIMEOUT_MS + CANCEL_WAIT_MS);
+    while (rx.probe != NULL) {
+        if (wait_until(&deadline) != 0)
+            break;
+    }
+    if (rx.probe != NULL) {
+        rx.probe = NULL;
+        fprintf(stderr, "No thread is handling libusb events for the Boson; "
+                        "open it through a libuvc context that owns its libusb context\n");
+        return LIBUSB_ERROR_NOT_SUPPORTED;
+    }
+    return 0;
+}
+
+static int start_transport(libusb_device_handle *devh)
+{
+    int i, rc = 0;
+
+    if (!rx.initialized) {
+        pthread_condattr_t attr;
+        pthread_condattr_init(&attr);
+#ifndef __APPLE__
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
 #endif
-                    found_complete_frame = 1;
-                    break;
-                }
+        pthread_mutex_init(&rx.lock, NULL);
+        pthread_cond_init(&rx.cond, &attr);
+        pthread_condattr_destroy(&attr);
+        rx.initialized = 1;
+    }
 
-                in_frame_buf[byte_idx++] = c;
-    #ifdef DEBUGPRINT
-                printf(" %02X",c);
-    #endif
-                continue;
-            }
-        }
+    pthread_mutex_lock(&rx.lock);
+    rx.head = rx.tail = 0;
+    rx.overruns = 0;
+    rx.bytes = 0;
+    rx.callback_cpu_ns = 0;
+    rx.stopping = 0;
+    rx.in_flight = 0;
+    rx.in_errors = 0;
+    rx.failed = 0;
+    rc = check_event_thread(devh);
+    if (rc < 0) {
+        pthread_mutex_unlock(&rx.lock);
+        return rc;
+    }
+    rx.out = alloc_out_transfer();
+    if (rx.out == NULL)
+        rc = LIBUSB_ERROR_NO_MEM;
+    for (i = 0; i < IN_TRANSFERS && rc == 0; i++) {
+        rx.in[i] = libusb_alloc_transfer(0);
+        libusb_fill_bulk_transfer(rx.in[i], devh, EP_IN_ADDR, rx.in_buf[i], IN_TRANSFER_SIZ,
+                                  in_callback, NULL, 0);
+        rc = libusb_submit_transfer(rx.in[i]);
+        if (rc == 0)
+            rx.in_flight++;
     }
+    pthread_mutex_unlock(&rx.lock);
 
-    if (found_complete_frame) {
-#ifdef DEBUGPRINT
-        printf("Found Complete Frame in channel_buf_%02d\n",chan_ptr->channel);
-        printf("current buffer start = %d, len = %d \n",chan_ptr->start,chan_ptr->len);
-#endif
-        extract_payload(&(in_frame_buf[FRAME_START_IDX]), (byte_idx - NUM_FRAMING_BYTES), receiveBuffer, receiveBytes);
+    if (rc < 0)
+        stop_transport();
+    return rc;
+}
+
+static void stop_transport(void)
+{
+    int i;
+    struct timespec deadline;
+
+    if (!rx.initialized)
         return;
+
+    pthread_mutex_lock(&rx.lock);
+    rx.stopping = 1;
+    for (i = 0; i < IN_TRANSFERS; i++) {
+        if (rx.in[i])
+            libusb_cancel_transfer(rx.in[i]);
     }
-#ifdef DEBUGPRINT
-    printf("Entering serial loop...\n");
+    deadline_after(&deadline, CANCEL_WAIT_MS);
+    while (rx.in_flight > 0) {
+        if (wait_until(&deadline) != 0)
+            break;
+    }
+    if (rx.in_flight > 0) {
+        // no one is handling events; freeing them now would be worse
+        fprintf(stderr, "Boson IN transfers did not cancel, leaking them\n");
+    } else {
+        for (i = 0; i < IN_TRANSFERS; i++) {
+            libusb_free_transfer(rx.in[i]);
+            rx.in[i] = NULL;
+        }
+        libusb_free_transfer(rx.out);
+        rx.out = NULL;
+    }
+    pthread_mutex_unlock(&rx.lock);
+}
+
+/* Up to size bytes from the ring, waiting up to timeout_ms for the first;
+ * -1 if none came, RX_FAILED if none ever will.
+ */
+static int ring_read(uint8_t *buf, int size, int timeout_ms)
+{
+    struct timespec deadline;
+    int count;
+
+    pthread_mutex_lock(&rx.lock);
+    deadline_after(&deadline, timeout_ms);
+    while (rx.head == rx.tail && rx.in_flight > 0) {
+        if (wait_until(&deadline) != 0)
+            break;
+    }
+    count = rx.head - rx.tail;
+    if (count == 0 && rx.in_flight == 0) {
+        pthread_mutex_unlock(&rx.lock);
+        return RX_FAILED;
+    }
+    if (count > size)
+        count = size;
+    uint32_t at = rx.tail % RX_RING_SIZ;
+    int first = count < (int)(RX_RING_SIZ - at) ? count : (int)(RX_RING_SIZ - at);
+    memcpy(buf, &rx.ring[at], first);
+    memcpy(buf + first, rx.ring, count - first);
+    rx.tail += count;
+    pthread_mutex_unlock(&rx.lock);
+
+    return count > 0 ? count : -1;
+}
+
 #endif
-    clock_gettime(CLOCK_MONOTONIC, &start_t);
-    while(1)
-    {
 
-        // if (failedcrc){
-            // printf("AFTER FAIL: %f\n",elapsed_sec);
-        // }
-        if (byte_idx == FRAME_BUF_SIZ)
-        {
-            // Buffer overrun
-            return;
-        }
-        clock_gettime(CLOCK_MONOTONIC, &current_t);
-        elapsed_sec = diff_timespec(&current_t, &start_t);
-        if (elapsed_sec >= timeout){
-            if (am_in_frame==CORRECT_FRAME) {
-                printf("ReadFrameTimeout after: %f s\n",elapsed_sec);
-                printf("partial rx frame[%d] : ",byte_idx);
-                for (tempval=0; tempval<byte_idx; tempval++){
-                    printf(" %02X",in_frame_buf[tempval]);
-                }
-                printf("\n");
-            } else {
-#ifdef DEBUGPRINT
-                printf("Timed out after %f s\n",elapsed_sec);
+// refills the reader's block, -1 when nothing arrived, RX_FAILED when nothing will
+static int read_block(libusb_device_handle *devh, struct frame_reader *reader)
+{
+    int actual_length;
+#ifndef BOSON_SYNC_TRANSPORT
+    actual_length = ring_read(reader->block, sizeof(reader->block), RX_WAIT_MS);
+    if (actual_length < 0)
+        return actual_length;
+#else
+    int rc = libusb_bulk_transfer(devh, EP_IN_ADDR, reader->block, sizeof(reader->block), &actual_length, 1000);
+    if (rc == LIBUSB_ERROR_TIMEOUT) {
+        printf("%s (%d)\n", libusb_error_name(rc), actual_length);
+        return -1;
+    } else if (rc < 0) {
+        fprintf(stderr, "Error while waiting for char: %s\n", libusb_error_name(rc));
+        return -1;
+    }
 #endif
-            }
-            *receiveBytes =  0;
-            am_in_frame = UNFRAMED;
-            return;
-        }
+    reader->pos = 0;
+    reader->len = actual_length;
+    return actual_length;
+}
 
-        if (in_escape && (am_in_frame==CORRECT_FRAME)){
-            //carryover escape character from buffer
-            tempval = ESCAPE_BYTE;
-        } else {
-            //normal operations
-            tempval = read_byte(devh);
-        }
+// a response to the last frame sent has arrived
+static void note_response(void)
+{
+    if (!transport_stats.pending_since_ns)
+        return;
+    transport_stats.commands++;
+    transport_stats.round_trip_ns += clock_ns(CLOCK_MONOTONIC) - transport_stats.pending_since_ns;
+    transport_stats.caller_cpu_ns += thread_cpu_ns() - transport_stats.pending_cpu_ns;
+    transport_stats.pending_since_ns = 0;
+}
 
-        if (tempval<0) {
-#ifdef DEBUGPRINT
-            //printf("ReadByteTimeout: %f\n",elapsed_sec);
+void get_transport_stats(TRANSPORT_STATS *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->commands = transport_stats.commands;
+    stats->timeouts = transport_stats.timeouts;
+    stats->roundTripNs = transport_stats.round_trip_ns;
+    stats->callerCpuNs = transport_stats.caller_cpu_ns;
+#ifndef BOSON_SYNC_TRANSPORT
+    stats->async = 1;
+    if (rx.initialized) {
+        pthread_mutex_lock(&rx.lock);
+        stats->callbackCpuNs = rx.callback_cpu_ns;
+        stats->bytesReceived = rx.bytes;
+        stats->overruns = rx.overruns;
+        pthread_mutex_unlock(&rx.lock);
+    }
 #endif
-            continue; //byte read timeout.
-        } else {
-            c = (uint8_t) tempval;
-        }
+}
 
-        if ((c & 0xFF) == (START_FRAME_BYTE & 0xFF))
-        {
-#ifdef DEBUGPRINT
-            printf("     StartByte time %f:\n     ",elapsed_sec);
+static void extract_payload(uint8_t* raw_payload_buf, uint32_t raw_payload_len, uint8_t* payload_buf, uint32_t* payload_len)
+{
+    memcpy(payload_buf, raw_payload_buf, raw_payload_len);
+    *payload_len = raw_payload_len;
+}
+
+static uint8_t unescape(uint8_t c)
+{
+    switch (c){
+        case ESCAPED_END_FRAME_BYTE:
+            return END_FRAME_BYTE;
+        case ESCAPED_START_FRAME_BYTE:
+            return START_FRAME_BYTE;
+        case ESCAPED_ESCAPE_BYTE:
+            return ESCAPE_BYTE;
+        default:
+            return c;
+    }
+}
+
+/* First start or end byte, or escape byte if with_escape, in [p, end).
+ * Escaped bytes never look like a start or end byte, so the rest of a
+ * frame can be skipped without looking for escapes.
+ */
+static const uint8_t *find_special(const uint8_t *p, const uint8_t *end, int with_escape)
+{
+#ifdef __SSE2__
+    const __m128i start_byte = _mm_set1_epi8((char)START_FRAME_BYTE);
+    const __m128i end_byte = _mm_set1_epi8((char)END_FRAME_BYTE);
+    const __m128i escape_byte = with_escape ? _mm_set1_epi8((char)ESCAPE_BYTE) : end_byte;
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, start_byte), _mm_cmpeq_epi8(v, end_byte)),
+                                   _mm_cmpeq_epi8(v, escape_byte));
+        int mask = _mm_movemask_epi8(hit);
+        if (mask)
+            return p + __builtin_ctz(mask);
+        p += 16;
+    }
 #endif
-            timeout = FRAME_TIMEOUT_SEC;
-            byte_idx = 0;
-            do {
-                clock_gettime(CLOCK_MONOTONIC, &current_t);
-                elapsed_sec = diff_timespec(&current_t, &start_t);
-                if (elapsed_sec>timeout) continue;
-                tempval = read_byte(devh);
-            } while (tempval < 0);
-            c = (uint8_t) tempval & 0xFF;
-            uint8_t needs_escape = 0;
-            if (c == ESCAPE_BYTE){
-                needs_escape = 1;
-                do {
-                    clock_gettime(CLOCK_MONOTONIC, &current_t);
-                    elapsed_sec = diff_timespec(&current_t, &start_t);
-                    if (elapsed_sec>timeout) continue;
-                    tempval = read_byte(devh);
-                } while (tempval < 0);
-                c = (uint8_t) tempval & 0xFF;
+    for (; p < end; p++) {
+        if (*p == START_FRAME_BYTE || *p == END_FRAME_BYTE || (with_escape && *p == ESCAPE_BYTE))
+            return p;
+    }
+    return end;
+}
+
+static void init_decoder(struct frame_decoder *dec, uint8_t channel_ID, CHANNEL_T *unframed)
+{
+    dec->channel_ID = channel_ID;
+    dec->state = UNFRAMED;
+    dec->in_escape = 0;
+    dec->other = NULL;
+    dec->unframed = unframed;
+    dec->len = 0;
+    dec->crc_len = 0;
+    dec->crc = FLIR_CRC_INITIAL_VALUE;
+}
+
+// the last two bytes so far may turn out to be the CRC
+static void update_crc(struct frame_decoder *dec)
+{
+    if (dec->len > dec->crc_len + 2) {
+        dec->crc = updateFlirCRC16Bytes(dec->crc, dec->len - 2 - dec->crc_len, &(dec->buf[dec->crc_len]));
+        dec->crc_len = dec->len - 2;
+    }
+}
+
+// at the end byte: 1 if the frame checks out
+static int check_frame(struct frame_decoder *dec)
+{
+    uint32_t i;
+
+    update_crc(dec);
+    if (dec->len >= NUM_FRAMING_BYTES
+            && ((dec->crc >> 8) & 0xFF) == dec->buf[dec->len - 2]
+            && (dec->crc & 0xFF) == dec->buf[dec->len - 1])
+        return 1;
+
+    if (dec->len < NUM_FRAMING_BYTES) {
+        printf("\nFailed packet integrity check, %u bytes\n", dec->len);
+        return 0;
+    }
+    printf("\nFailed packet integrity check (calc) %02X%02X !=  (recd) %02X%02X\n",((dec->crc >> 8) &0xFF),(dec->crc&0xFF),dec->buf[dec->len - 2],dec->buf[dec->len - 1]);
+    printf("RAW Receive Packet: ");
+    for (i=0;i<dec->len;i++){
+        printf(" %02X",dec->buf[i]);
+    }
+    printf("\n");
+    return 0;
+}
+
+// too long for buf; skip to its end
+static void drop_frame(struct frame_decoder *dec)
+{
+    printf("Frame longer than %d bytes, dropped\n", FRAME_BUF_SIZ);
+    dec->state = OTHER_FRAME;
+    dec->other = NULL;
+}
+
+/* Takes up to len bytes. Returns 1 once a frame for dec->channel_ID has
+ * arrived whole and passed its CRC, with the frame in dec->buf and *used
+ * set to the bytes taken; 0 when all len were taken without one.
+ */
+static int decode_block(struct frame_decoder *dec, const uint8_t *data, uint32_t len, uint32_t *used)
+{
+    const uint8_t *p = data, *end = data + len, *q;
+    uint8_t c, escaped;
+    uint32_t n;
+
+    while (p < end) {
+        switch (dec->state) {
+        case UNFRAMED:
+            q = memchr(p, START_FRAME_BYTE, end - p);
+            if (q == NULL)
+                q = end;
+            if (dec->unframed)
+                add_bytes(p, q - p, dec->unframed);
+            p = q;
+            if (p < end) {
+                p++;
+                dec->state = FRAME_START;
+                dec->in_escape = 0;
             }
-            if (c == channel_ID) {
-                //found correct frame
-                am_in_frame = CORRECT_FRAME;
-                in_frame_buf[byte_idx++] = c;
+            break;
+
+        case FRAME_START:
+            c = *p++;
+            if (!dec->in_escape && c == ESCAPE_BYTE) {
+                dec->in_escape = 1;
+                break;
+            }
+            if (!dec->in_escape && c == START_FRAME_BYTE)
+                break;
+            escaped = dec->in_escape;
+            dec->in_escape = 0;
+            if ((escaped ? unescape(c) : c) == dec->channel_ID) {
+                dec->state = CORRECT_FRAME;
+                dec->buf[0] = dec->channel_ID;
+                dec->len = 1;
+                dec->crc_len = 0;
+                dec->crc = FLIR_CRC_INITIAL_VALUE;
+                break;
+            }
+            if (get_channel(escaped ? unescape(c) : c, &(dec->other)) >= 0) {
+                dec->state = OTHER_FRAME;
             } else {
-                am_in_frame = OTHER_FRAME;
-                other_frame_ID = c;
-                tempval = get_channel(other_frame_ID, &chan_ptr);
-                if (tempval < 0){
-                    chan_ptr = unframed_ptr;
-                    am_in_frame = UNFRAMED;
+                // not a channel we know: keep it as it came
+                dec->state = UNFRAMED;
+                dec->other = dec->unframed;
+            }
+            if (dec->other) {
+                add_byte(START_FRAME_BYTE, dec->other);
+                if (escaped)
+                    add_byte(ESCAPE_BYTE, dec->other);
+                add_byte(c, dec->other);
+            }
+            break;
+
+        case CORRECT_FRAME:
+            if (dec->in_escape) {
+                // whatever follows an escape is data
+                dec->in_escape = 0;
+                if (dec->len == FRAME_BUF_SIZ) {
+                    drop_frame(dec);
+                    break;
                 }
-                add_byte(START_FRAME_BYTE,chan_ptr);
-                if(needs_escape) add_byte(ESCAPE_BYTE,chan_ptr);
-                add_byte(c,chan_ptr);
+                dec->buf[dec->len++] = unescape(*p++);
+                break;
             }
-            continue;
-        }
-        if (am_in_frame == CORRECT_FRAME) {
-            if ((c & 0xFF) == (ESCAPE_BYTE & 0xFF))
-            {
-                in_escape = 1;
-
-                do {
-                    clock_gettime(CLOCK_MONOTONIC, &current_t);
-                    elapsed_sec = diff_timespec(&current_t, &start_t);
-                    if (elapsed_sec>timeout) continue;
-                    tempval = read_byte(devh);
-                } while (tempval < 0);
-
-                c = (uint8_t) tempval;
-                switch (c){
-                    case ESCAPED_END_FRAME_BYTE:
-                        c = END_FRAME_BYTE;
-                        break;
-                    case ESCAPED_START_FRAME_BYTE:
-                        c = START_FRAME_BYTE;
-                        break;
-                    case ESCAPED_ESCAPE_BYTE:
-                        c = ESCAPE_BYTE;
-                        break;
-                    default:
-                        break;
+            q = find_special(p, end, 1);
+            n = q - p;
+            if (n > FRAME_BUF_SIZ - dec->len) {
+                drop_frame(dec);
+                break;
+            }
+            memcpy(&(dec->buf[dec->len]), p, n);
+            dec->len += n;
+            p = q;
+            if (p == end)
+                break;
+            c = *p++;
+            if (c == ESCAPE_BYTE) {
+                dec->in_escape = 1;
+            } else if (c == START_FRAME_BYTE) {
+                // cut short by the next frame
+                dec->state = FRAME_START;
+            } else {
+                dec->state = UNFRAMED;
+                if (check_frame(dec)) {
+                    *used = p - data;
+                    return 1;
                 }
-                in_frame_buf[byte_idx++] = c;
-                in_escape = 0;
-    #ifdef DEBUGPRINT
-                printf(" %02X",c);
-    #endif
-                continue;
             }
+            break;
 
-            if ((c & 0xFF) == (END_FRAME_BYTE & 0xFF))
-            {
-                // printf("\n     EndByte time %f:\n",elapsed_sec);
-                // frame_buf[byte_idx++] = c;
+        case OTHER_FRAME:
+            q = find_special(p, end, 0);
+            if (q < end && *q == END_FRAME_BYTE) {
+                q++;
+                dec->state = UNFRAMED;
+            }
+            if (dec->other)
+                add_bytes(p, q - p, dec->other);
+            p = q;
+            if (p < end && *p == START_FRAME_BYTE) {
+                p++;
+                dec->state = FRAME_START;
+                dec->in_escape = 0;
+            }
+            break;
+        }
+    }
+    update_crc(dec);
+    *used = len;
+    return 0;
+}
 
-                /*
-                 * Check CRC: if good end loop.  If bad, start looking for start byte.
-                 * Check Frame Status:  If zero, end loop.  If non-zero, start looking for start byte.
-                 */
+void read_frame(libusb_device_handle *devh,uint8_t channel_ID, uint16_t start_byte_ms,uint32_t *receiveBytes, uint8_t *receiveBuffer)
+{
+    struct frame_decoder dec;
+    CHANNEL_T *channel, *unframed;
+    uint8_t *span;
+    int32_t span_len;
+    uint32_t used, i;
 
-                 /*
-                  * byte_idx - 3 = total frame length - channel_ID byte - crc_bytes[2]
-                  * &(frame_buf[1]) is first byte after channel_ID byte
-                  */
+    *receiveBytes =  0;
 
-                am_in_frame = UNFRAMED;
+    // a frame may have been put aside while waiting for another channel's
+    if (get_channel(channel_ID, &channel) >= 0) {
+        init_decoder(&dec, channel_ID, NULL);
+        while ((span_len = peek_bytes(&span, channel)) > 0) {
+            if (decode_block(&dec, span, span_len, &used)) {
+                drop_bytes(used, channel);
+                extract_payload(&(dec.buf[FRAME_START_IDX]), (dec.len - NUM_FRAMING_BYTES), receiveBuffer, receiveBytes);
+                note_response();
+                return;
+            }
+            drop_bytes(used, channel);
+        }
+    }
 
-                calc_crc = calcFlirCRC16Bytes((byte_idx - 2), &(in_frame_buf[CRC_START_IDX]));
+    get_unframed(&unframed);
+    init_decoder(&dec, channel_ID, unframed);
 
-                if ( (((calc_crc >> 8) &0xFF) != in_frame_buf[byte_idx - 2]) || ((calc_crc &0xFF) != in_frame_buf[byte_idx - 1]) )
-                {
-                    printf("Failed POLL packet integrity check (calc) %02X%02X !=  (recd) %02X%02X\n",((calc_crc >> 8) &0xFF),(calc_crc&0xFF),in_frame_buf[byte_idx - 2],in_frame_buf[byte_idx - 1]);
-                    printf("RAW Receive Packet: ");
-                    for (tempval=0;tempval<byte_idx;tempval++){
-                        printf(" %02X",in_frame_buf[tempval]);
+    /* start_byte_ms to see a frame begin, FRAME_TIMEOUT_SEC for it to end,
+     * both from the call; frames that fail their CRC don't extend it, so a
+     * noisy link can't keep the caller waiting.
+     */
+    struct frame_reader *reader = &port_reader;
+    struct timespec start_t,current_t;
+    double elapsed_sec;
+    double timeout = (double)start_byte_ms/1000.0;
+    clock_gettime(CLOCK_MONOTONIC, &start_t);
+
+    while (1)
+    {
+        if (reader->pos == reader->len) {
+            clock_gettime(CLOCK_MONOTONIC, &current_t);
+            elapsed_sec = diff_timespec(&current_t, &start_t);
+            if (elapsed_sec >= timeout) {
+                if (dec.state == CORRECT_FRAME) {
+                    printf("ReadFrameTimeout after: %f s\n",elapsed_sec);
+                    printf("partial rx frame[%d] : ",dec.len);
+                    for (i=0; i<dec.len; i++){
+                        printf(" %02X",dec.buf[i]);
                     }
                     printf("\n");
-                    // printf("     Failed time %f:\n",elapsed_sec);
-                    // failedcrc = 1;
-                    byte_idx = 0;
-                    clock_gettime(CLOCK_MONOTONIC, &start_t);
-                    timeout= (double)start_byte_ms/1000.0;
-                    continue;
                 }
-    #ifdef DEBUGPRINT
+#ifdef DEBUGPRINT
                 else {
-                    printf("\n");
+                    printf("Timed out after %f s\n",elapsed_sec);
                 }
-    #endif
-                found_complete_frame = 1;
-                break;
-            }
-
-            in_frame_buf[byte_idx++] = c;
-#ifdef DEBUGPRINT
-            printf(" %02X",c);
 #endif
-        } else if(am_in_frame == OTHER_FRAME) {
-            if ((c & 0xFF) == (ESCAPE_BYTE & 0xFF)) {
-                in_escape = 1;
-                add_byte(c,chan_ptr);
-                do {
-                    clock_gettime(CLOCK_MONOTONIC, &current_t);
-                    elapsed_sec = diff_timespec(&current_t, &start_t);
-                    if (elapsed_sec>timeout) continue;
-                    tempval = read_byte(devh);
-                } while (tempval < 0);
-                c = (uint8_t) tempval;
-                add_byte(c,chan_ptr);
-                in_escape = 0;
-
-            } else if ((c & 0xFF) == (END_FRAME_BYTE & 0xFF)) {
-                add_byte(c,chan_ptr);
-                am_in_frame = UNFRAMED;
+                return;
             }
+            int rc = read_block(devh, reader);
+            if (rc == RX_FAILED)
+                return;
+            if (rc < 0)
+                continue;
+        }
 
-#ifdef DEBUGPRINT
-            printf("(%02d:%02X)",chan_ptr->channel,c);
-#endif
-            continue;
-        } else { //Unframed data
-#ifdef DEBUGPRINT
-            printf("(U:%02X)",c);
-#endif
-            add_byte(c,unframed_ptr);
+        if (decode_block(&dec, &(reader->block[reader->pos]), reader->len - reader->pos, &used)) {
+            reader->pos += used;
+            extract_payload(&(dec.buf[FRAME_START_IDX]), (dec.len - NUM_FRAMING_BYTES), receiveBuffer, receiveBytes);
+            note_response();
+            return;
         }
-    }
-    if (found_complete_frame) {
-        extract_payload(&(in_frame_buf[FRAME_START_IDX]), (byte_idx - NUM_FRAMING_BYTES), receiveBuffer, receiveBytes);
-        return;
-    } else {
-        *receiveBytes =  0;
-        return;
+        reader->pos = reader->len;
+
+        if (dec.state == CORRECT_FRAME && timeout < FRAME_TIMEOUT_SEC)
+            timeout = FRAME_TIMEOUT_SEC;
     }
 }
 
 
 void read_unframed(libusb_device_handle *devh, uint16_t start_byte_ms, uint32_t *receiveBytes, uint8_t *receiveBuffer){
     int tempval = 0;
-    // frame_state am_in_frame = UNFRAMED;
-    uint8_t found_complete_frame=0, in_escape=0;
     uint8_t c;
-    // uint8_t failedcrc = 0;
-    uint16_t calc_crc;
 
     get_unframed(&unframed_ptr);
 
@@ -634,11 +1021,57 @@ static int write_frame(libusb_device_handle *devh,uint8_t *frame_buf, uint32_t l
 #endif
 
     int actual_length;
+#ifndef BOSON_SYNC_TRANSPORT
+    /* The completion comes on the event thread; the transfer's own timeout
+     * bounds the wait, the deadline only covers nobody handling events. */
+    struct timespec deadline;
+    int status;
+
+    pthread_mutex_lock(&rx.lock);
+    if (rx.out == NULL || rx.failed || len > FRAME_BUF_SIZ) {
+        pthread_mutex_unlock(&rx.lock);
+        return -1;
+    }
+    memcpy(rx.out->buffer, frame_buf, len);
+    libusb_fill_bulk_transfer(rx.out, devh, EP_OUT_ADDR, rx.out->buffer, len,
+                              out_callback, NULL, OUT_TIMEOUT_MS);
+    rx.out_done = 0;
+    if (libusb_submit_transfer(rx.out) < 0) {
+        pthread_mutex_unlock(&rx.lock);
+        fprintf(stderr, "Error while sending char\n");
+        return -1;
+    }
+    deadline_after(&deadline, OUT_TIMEOUT_MS + CANCEL_WAIT_MS);
+    int cancelled = 0;
+    while (!rx.out_done) {
+        if (wait_until(&deadline) == 0)
+            continue;
+        if (cancelled) {
+            // still in flight, so it can't be reused; its callback frees it
+            fprintf(stderr, "Boson OUT transfer did not complete, replacing it\n");
+            rx.out = alloc_out_transfer();
+            pthread_mutex_unlock(&rx.lock);
+            return -1;
+        }
+        libusb_cancel_transfer(rx.out);
+        cancelled = 1;
+        deadline_after(&deadline, CANCEL_WAIT_MS);
+    }
+    status = rx.out->status;
+    actual_length = rx.out->actual_length;
+    pthread_mutex_unlock(&rx.lock);
+
+    if (status != LIBUSB_TRANSFER_COMPLETED) {
+        fprintf(stderr, "Error while sending char\n");
+        return -1;
+    }
+#else
     if (libusb_bulk_transfer(devh, EP_OUT_ADDR, frame_buf, len,
                              &actual_length, 0) < 0) {
         fprintf(stderr, "Error while sending char\n");
         return -1;
     }
+#endif
     if (actual_length != len)
     {
 #ifdef DEBUGPRINT
@@ -660,6 +1093,11 @@ void send_to_camera(libusb_device_handle *devh, uint8_t channel_ID, uint32_t sen
     int success=0;//, i=0;
 
     int32_t out_len;//, in_payload_len, out_payload_len;
+    if (transport_stats.pending_since_ns)
+        transport_stats.timeouts++;
+    transport_stats.pending_since_ns = clock_ns(CLOCK_MONOTONIC);
+    transport_stats.pending_cpu_ns = thread_cpu_ns();
+
     out_len = create_frame(out_frame_buf,channel_ID, sendPayload, sendBytes);
 #ifdef DEBUGPRINT
     printf("sendBytes = %u, out_len = %d\n",sendBytes, out_len);
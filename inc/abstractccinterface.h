@@ -2,8 +2,20 @@
 #define ABSTRACTCCINTERFACE_H
 
 #include <QObject>
+#include <QAtomicInt>
+#include <QFuture>
+#include <QJsonValue>
+#include <QList>
+#include <QRect>
+#include <QStringList>
+#include <QTimer>
+#include <QVariantMap>
 #include <QVideoSurfaceFormat>
 
+#include "commandexecutor.h"
+#include "commandstats.h"
+#include "frametelemetry.h"
+
 class AbstractCCInterface : public QObject
 {
     Q_OBJECT
@@ -17,8 +29,134 @@ public:
     Q_PROPERTY(const QVideoSurfaceFormat defaultFormat READ getDefaultFormat)
     virtual const QVideoSurfaceFormat getDefaultFormat() = 0;
 
+    // control commands that shouldn't block the caller go through here
+    Q_PROPERTY(CommandExecutor* executor READ executor CONSTANT)
+    CommandExecutor* executor() const { return m_executor; }
+
+    // per-command transfer counts, errors and latencies
+    Q_PROPERTY(CommandStats* commandStats READ commandStats CONSTANT)
+    CommandStats* commandStats() const { return m_commandStats; }
+
+    /* In-band telemetry: when enabled, the default format includes extra rows
+     * of metadata which UvcAcquisition splits off and hands to parseTelemetry
+     * before the image reaches the rest of the pipeline. */
+    Q_PROPERTY(bool supportsTelemetry READ getSupportsTelemetry CONSTANT)
+    virtual bool getSupportsTelemetry() const { return false; }
+
+    Q_PROPERTY(bool telemetryEnabled READ getTelemetryEnabled WRITE setTelemetryEnabled NOTIFY telemetryChanged)
+    virtual bool getTelemetryEnabled() const { return false; }
+    virtual void setTelemetryEnabled(bool) { }
+
+    virtual int getTelemetryRows() const { return 0; }
+    virtual bool getTelemetryAtTop() const { return false; }
+
+    // data points at the first telemetry row; called from the UVC callback,
+    // so implementations may only touch state that is safe to share with it
+    virtual bool parseTelemetry(const uint8_t *, int /*width*/, int /*rows*/, int /*step*/, FrameTelemetry *)
+    {
+        return false;
+    }
+
+    /* Camera-side pseudo-color with a palette from the host: the stream
+     * format in which the camera applies it (invalid if it can't), and the
+     * upload of 256 RGB triples, to be called on the executor. */
+    virtual const QVideoSurfaceFormat getCameraColorFormat() { return QVideoSurfaceFormat(); }
+    virtual bool uploadPalette(const QByteArray &) { return false; }
+
+    /* Statistics the camera computes over its scene ROI (sensor coordinates),
+     * in the units of the default stream; called on the executor. */
+    struct SceneStats {
+        uint16_t minVal, maxVal, meanVal;
+        QRect roi;
+    };
+    virtual bool getSceneStats(SceneStats *) { return false; }
+
+    /* FFC state, from telemetry via updateFfcState when the camera has it,
+     * otherwise from polling the camera on a worker thread. */
+    Q_PROPERTY(bool ffcInProgress READ getFfcInProgress NOTIFY ffcStateChanged)
+    bool getFfcInProgress() const { return m_ffcInProgress.load() != 0; }
+
+    // safe to call from the UVC callback
+    void updateFfcState(bool inProgress);
+
+    // keep polling the FFC state, to catch automatic FFCs without telemetry
+    void setFfcMonitoring(bool enabled);
+
+    // whether the running stream has telemetry rows feeding updateFfcState;
+    // otherwise performFfc asks the camera
+    void setFfcStateFromStream(bool fromStream);
+
+    /* Attribute registry: the settable camera attributes of the subclass,
+     * taken from its properties, with the type metadata needed to store
+     * them. Configurations are exported and applied as a versioned JSON
+     * file; applying writes every attribute and then reads them all back
+     * in one pass on the executor. */
+    struct Attribute {
+        QString name;
+        int type;           // QMetaType id
+        QString typeName;
+        bool isEnum;
+        QStringList keys;   // enum keys by value, when the enum is known
+        int property;       // index in the subclass' QMetaObject
+        int phase;          // lower phases are applied first
+    };
+    const QList<Attribute> &attributes();
+
+    // name, type and (for enums) keys of each attribute, for QML
+    Q_INVOKABLE QVariantList attributeList();
+
+    QVariantMap exportConfig();
+    bool applyConfig(const QVariantMap &config);
+
+    Q_INVOKABLE bool exportConfigFile(const QString &path);
+    // returns once the file is read; false if it can't be, otherwise
+    // configApplied follows
+    Q_INVOKABLE bool applyConfigFile(const QString &path);
+
+signals:
+    void telemetryChanged(bool enabled);
+    void ffcStateChanged(bool inProgress);
+    void ffcFinished(bool ok);
+    void configApplied(bool ok);
+
 public slots:
-    virtual void performFfc() = 0;
+    // starts an FFC on a worker thread and returns; ffcFinished follows
+    void performFfc();
+
+protected:
+    // both run on the executor thread
+    virtual bool startFfc() = 0;
+    virtual bool queryFfcInProgress() { return false; }
+
+    // for subclass destructors: finishes queued commands and the FFC worker
+    // before anything they use goes away
+    void shutdownWorkers();
+
+    // registry hooks: which properties are configuration, in what order
+    // they go to the camera, and what to drop so read back hits the device
+    virtual bool isConfigAttribute(const QString &) const { return true; }
+    virtual int attributePhase(const QString &) const { return 0; }
+    virtual void invalidateForVerify() { }
+
+private slots:
+    void pollFfcState();
+
+private:
+    void runFfc();
+    QJsonValue encodeAttribute(const Attribute &attribute, const QVariant &value) const;
+    bool decodeAttribute(const Attribute &attribute, const QJsonValue &json, QVariant *value) const;
+
+    QList<Attribute> m_attributes;
+    bool m_attributesBuilt;
+
+    QAtomicInt m_ffcInProgress;
+    QAtomicInt m_ffcWorkerBusy;
+    QAtomicInt m_ffcFromStream;
+    QAtomicInt m_stopping;
+    QFuture<void> m_ffcWorker;
+    QTimer *m_ffcPollTimer;
+    CommandExecutor *m_executor;
+    CommandStats *m_commandStats;
 };
 
 #endif // ABSTRACTCCINTERFACE_H
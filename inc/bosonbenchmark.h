@@ -0,0 +1,21 @@
+#ifndef BOSONBENCHMARK_H
+#define BOSONBENCHMARK_H
+
+/* Times the command channel of an attached Boson: <n> serial number reads,
+ * each a full command round trip, then the transport's own counters as
+ * BosonVariation prints them on close. Build once as is and once with
+ * DEFINES+=BOSON_SYNC_TRANSPORT to compare the two transports on the same
+ * camera. */
+class BosonBenchmark
+{
+public:
+    explicit BosonBenchmark(int commands);
+
+    // 0 when a Boson was found and every command was answered
+    int run();
+
+private:
+    int m_commands;
+};
+
+#endif // BOSONBENCHMARK_H
@@ -2,6 +2,9 @@
 #define BOSONVARIATION_H
 
 #include <QObject>
+#include <QAtomicInt>
+#include <QMutex>
+#include <QTimer>
 
 #include <libuvc/libuvc.h>
 
@@ -70,13 +73,24 @@ public:
     Q_PROPERTY(const QVideoSurfaceFormat defaultFormat READ getDefaultFormat)
     virtual const QVideoSurfaceFormat getDefaultFormat();
 
+    virtual bool getSupportsTelemetry() const { return m_telemetrySize.isValid(); }
+    virtual bool getTelemetryEnabled() const { return m_telemetryEnabled; }
+    virtual void setTelemetryEnabled(bool enabled);
+    virtual int getTelemetryRows() const;
+    virtual bool getTelemetryAtTop() const { return false; }
+    virtual bool parseTelemetry(const uint8_t *data, int width, int rows, int step, FrameTelemetry *out);
+
 signals:
     void cameraInternalTempChanged(float temp);
 
     void colorLutIdChanged(COLORLUT_ID_E val);
 
-public slots:
-    virtual void performFfc();
+private slots:
+    void pollFpaTemp();
+
+protected:
+    virtual bool startFfc();
+    virtual bool queryFfcInProgress();
 
 private:
 
@@ -96,16 +110,35 @@ private:
     template <class T, class W>
     W pget(function<FLR_RESULT(T*)> F)
     {
+        QMutexLocker lock(&m_mutex);
         T var;
         F(&var);
         return (W)var;
     }
 
+    // queued on the executor, announced once the camera has it; writes
+    // through the same SDK setter are coalesced, latest value wins; on the
+    // executor itself the write happens right away
     template <class T, class W>
     void pset(function<FLR_RESULT(T)> F, function<void(W)> E, W var)
     {
-        F((T)var);
-        emit E(var);
+        typedef FLR_RESULT (*Setter)(T);
+        const Setter *setter = F.template target<Setter>();
+
+        auto write = [this, F, E, var]() {
+            {
+                QMutexLocker lock(&m_mutex);
+                F((T)var);
+            }
+            emit E(var);
+        };
+
+        if (executor()->isExecutorThread())
+            write();
+        else if (setter)
+            executor()->postCoalesced(reinterpret_cast<quintptr>(*setter), write);
+        else
+            executor()->post(write);
     }
 
     uvc_context_t *ctx;
@@ -113,6 +146,19 @@ private:
     uvc_device_handle_t *devh;
     libusb_device_handle *usb_devh;
     uvc_device_descriptor_t *desc;
+
+    // the SDK's serial channel is shared with the FFC worker
+    QMutex m_mutex;
+
+    QSize m_sensorSize;
+    QSize m_telemetrySize;
+    bool m_telemetryEnabled;
+
+    // written from the UVC callback or the poll on the executor; INT_MIN
+    // until the first value
+    QAtomicInt m_fpaTempCx10;
+    QAtomicInt m_fpaTempPending;
+    QTimer *m_fpaTempTimer;
 };
 
 Q_DECLARE_METATYPE(COLORLUT_ID_E)
@@ -0,0 +1,92 @@
+#ifndef CAMERASTATS_H
+#define CAMERASTATS_H
+
+#include <QObject>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QSize>
+#include <QTimer>
+
+#include "abstractccinterface.h"
+
+/* Min/max the camera computed over its scene ROI, fetched every interval ms
+ * on the control executor, so the host doesn't need a full min/max pass per
+ * frame. lookup() hands them to the UVC callback while they are fresh and
+ * the ROI covers the whole frame; otherwise the host reduction runs and its
+ * range goes to noteHostRange().
+ *
+ * Every few seconds the host pass runs anyway and the two are compared: the
+ * camera's statistics aren't in the units of the stream in every mode (e.g.
+ * TLinear on some firmware), and are dropped after repeated mismatches until
+ * re-enabled. The camera has no positions, so DataFormatter's min/max points
+ * are only updated by those host passes. */
+class CameraStats : public QObject
+{
+    Q_OBJECT
+
+public:
+    CameraStats();
+
+    // GUI thread; NULL while there is no camera
+    void setCci(AbstractCCInterface *cci);
+
+    Q_PROPERTY(bool enabled READ isEnabled WRITE setEnabled NOTIFY enabledChanged)
+    bool isEnabled() const { return m_enabled.load() != 0; }
+    void setEnabled(bool enabled);
+
+    Q_PROPERTY(int interval READ getInterval WRITE setInterval NOTIFY intervalChanged)
+    int getInterval() const { return m_interval; }
+    void setInterval(int ms);
+
+    // false after the camera's statistics didn't match the frames
+    Q_PROPERTY(bool trusted READ isTrusted NOTIFY countersChanged)
+    bool isTrusted() const { return m_trusted.load() != 0; }
+
+    // per second, over the last publishing interval
+    Q_PROPERTY(float cameraRate READ getCameraRate NOTIFY countersChanged)
+    float getCameraRate() const;
+
+    Q_PROPERTY(float hostRate READ getHostRate NOTIFY countersChanged)
+    float getHostRate() const;
+
+    // UVC callback: the camera's range for a frame of this size, if usable
+    bool lookup(const QSize &frameSize, uint16_t *minVal, uint16_t *maxVal);
+    // UVC callback: the range the host found instead
+    void noteHostRange(const QSize &frameSize, uint16_t minVal, uint16_t maxVal);
+
+signals:
+    void enabledChanged(bool enabled);
+    void intervalChanged(int ms);
+    void countersChanged();
+
+private slots:
+    void fetch();
+
+private:
+    bool fresh(const QSize &frameSize, qint64 now) const;
+    void count(bool camera);
+
+    AbstractCCInterface *m_cci;
+    QAtomicInt m_enabled;
+    int m_interval;
+    QTimer *m_timer;
+    QAtomicInt m_fetchPending;
+    QAtomicInt m_trusted;
+
+    // shared by the executor, the UVC callback and the GUI
+    mutable QMutex m_mutex;
+    QElapsedTimer m_clock;
+    AbstractCCInterface::SceneStats m_stats;
+    qint64 m_fetchedAt;
+    QAtomicInt m_maxAge;
+    qint64 m_lastVerify;
+    int m_mismatches;
+    float m_cameraRate, m_hostRate;
+
+    // UVC callback only
+    quint64 m_windowCamera, m_windowHost;
+    QElapsedTimer m_window;
+};
+
+#endif // CAMERASTATS_H
@@ -0,0 +1,33 @@
+#ifndef CAPABILITYCACHE_H
+#define CAPABILITYCACHE_H
+
+#include <QString>
+#include <QVariant>
+#include <QVariantMap>
+
+/* Facts about a device that only change with its firmware, kept on disk
+ * between runs so a warm start can skip rediscovering them. Profiles are
+ * keyed by USB vendor/product and an ID of the device itself, not anything
+ * two units can share; callers check a profile against something cheap to
+ * read from the device, like its firmware, before trusting it. */
+class CapabilityCache
+{
+public:
+    CapabilityCache(quint16 vendorId, quint16 productId, const QString &deviceId);
+
+    bool isEmpty() const { return m_values.isEmpty(); }
+    bool contains(const QString &name) const { return m_values.contains(name); }
+    QVariant value(const QString &name) const { return m_values.value(name); }
+    void setValue(const QString &name, const QVariant &value) { m_values[name] = value; }
+
+    void clear() { m_values.clear(); }
+    bool save();
+
+    static QString path();
+
+private:
+    QString m_group;
+    QVariantMap m_values;
+};
+
+#endif // CAPABILITYCACHE_H
@@ -0,0 +1,188 @@
+#ifndef COMMANDEXECUTOR_H
+#define COMMANDEXECUTOR_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QFutureInterface>
+#include <QHash>
+#include <QMutex>
+#include <QList>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <functional>
+#include <memory>
+
+/* Serializes a device's control traffic on its own thread, so control
+ * transfers never block the GUI. The queue is drained before the thread
+ * exits.
+ *
+ * Writes posted with a key are coalesced: while one is waiting, a newer
+ * write with the same key replaces it in place, and writes with the same
+ * key start at least minWriteInterval apart. Dragging a slider thus sends
+ * its first and last values and a bounded rate in between.
+ *
+ * Control transfers share the link and the camera's MCU with video, so
+ * commands carry a priority. The highest priority runnable command goes
+ * first, FIFO within a priority. While frame arrival jitter is above
+ * jitterTolerance (as a fraction of the frame interval), polls and, for
+ * longer, cosmetic refreshes wait up to a bound; both also wait for a slot in the
+ * maxCommandRate budget. User writes are never held back. */
+class CommandExecutor : public QObject
+{
+    Q_OBJECT
+    Q_ENUMS(Priority)
+
+public:
+    enum Priority {
+        UserWrite = 0,
+        Poll,
+        Cosmetic
+    };
+
+    explicit CommandExecutor(const QString &name, QObject *parent = 0);
+    virtual ~CommandExecutor();
+
+    // false, and the command dropped, once shutdown has begun
+    bool post(std::function<void()> command, Priority priority = UserWrite);
+    void postCoalesced(quintptr key, std::function<void()> command);
+
+    template <class T>
+    QFuture<T> submit(std::function<T()> command, Priority priority = UserWrite)
+    {
+        auto promise = std::make_shared<QFutureInterface<T>>();
+        promise->reportStarted();
+        QFuture<T> future = promise->future();
+        bool queued = post([promise, command]() {
+            T result = command();
+            promise->reportResult(result);
+            promise->reportFinished();
+        }, priority);
+        if (!queued)
+        {
+            // nothing will run it; waiters get a default (failed) result
+            // instead of blocking forever
+            promise->reportResult(T());
+            promise->reportFinished();
+        }
+        return future;
+    }
+
+    // blocking; runs inline when already on the executor thread
+    template <class T>
+    T call(std::function<T()> command, Priority priority = UserWrite)
+    {
+        if (isExecutorThread())
+            return command();
+        return submit<T>(command, priority).result();
+    }
+
+    bool isExecutorThread() const { return QThread::currentThread() == m_thread; }
+
+    // runs what is queued, then stops the thread; later posts are dropped
+    void shutdown();
+
+    // from the frame callback, feeds the jitter estimate
+    void noteFrameArrival();
+
+    Q_PROPERTY(int queueDepth READ getQueueDepth NOTIFY metricsChanged)
+    int getQueueDepth();
+
+    // from submission to completion
+    Q_PROPERTY(float lastLatencyMs READ getLastLatencyMs NOTIFY metricsChanged)
+    float getLastLatencyMs() const { return m_lastLatencyMs; }
+
+    Q_PROPERTY(float averageLatencyMs READ getAverageLatencyMs NOTIFY metricsChanged)
+    float getAverageLatencyMs() const { return m_averageLatencyMs; }
+
+    Q_PROPERTY(float maxLatencyMs READ getMaxLatencyMs NOTIFY metricsChanged)
+    float getMaxLatencyMs() const { return m_maxLatencyMs; }
+
+    Q_PROPERTY(quint64 completed READ getCompleted NOTIFY metricsChanged)
+    quint64 getCompleted() const { return m_completed; }
+
+    // writes superseded by a newer one with the same key
+    Q_PROPERTY(quint64 coalesced READ getCoalesced NOTIFY metricsChanged)
+    quint64 getCoalesced() const { return m_coalesced; }
+
+    Q_PROPERTY(int minWriteInterval READ getMinWriteInterval WRITE setMinWriteInterval NOTIFY minWriteIntervalChanged)
+    int getMinWriteInterval() const { return m_minWriteInterval; }
+    void setMinWriteInterval(int ms);
+
+    // commands per second for polls and refreshes, 0 for no limit
+    Q_PROPERTY(int maxCommandRate READ getMaxCommandRate WRITE setMaxCommandRate NOTIFY schedulingChanged)
+    int getMaxCommandRate() const { return m_maxCommandRate; }
+    void setMaxCommandRate(int rate);
+
+    Q_PROPERTY(float jitterTolerance READ getJitterTolerance WRITE setJitterTolerance NOTIFY schedulingChanged)
+    float getJitterTolerance() const { return m_jitterTolerance; }
+    void setJitterTolerance(float tolerance);
+
+    // smoothed frame interval and its mean absolute deviation
+    Q_PROPERTY(float frameIntervalMs READ getFrameIntervalMs NOTIFY metricsChanged)
+    float getFrameIntervalMs() const { return m_frameIntervalMs; }
+
+    Q_PROPERTY(float frameJitterMs READ getFrameJitterMs NOTIFY metricsChanged)
+    float getFrameJitterMs() const { return m_frameJitterMs; }
+
+    // something is currently held back by jitter or budget
+    Q_PROPERTY(bool deferring READ isDeferring NOTIFY metricsChanged)
+    bool isDeferring() const { return m_deferring; }
+
+    // commands that had to wait, counted once each
+    Q_PROPERTY(quint64 deferredByJitter READ getDeferredByJitter NOTIFY metricsChanged)
+    quint64 getDeferredByJitter() const { return m_deferredByJitter; }
+
+    Q_PROPERTY(quint64 deferredByBudget READ getDeferredByBudget NOTIFY metricsChanged)
+    quint64 getDeferredByBudget() const { return m_deferredByBudget; }
+
+    Q_INVOKABLE void resetMetrics();
+
+signals:
+    void metricsChanged();
+    void minWriteIntervalChanged(int ms);
+    void schedulingChanged();
+
+private:
+    struct Command {
+        std::function<void()> fn;   // empty for keyed writes, see m_latest
+        quintptr key;
+        bool keyed;
+        Priority priority;
+        bool heldByJitter, heldByBudget;
+        QElapsedTimer queued;
+    };
+
+    void enqueue(const Command &entry);
+    void run();
+    int nextRunnable(qint64 now, qint64 *wait);
+    bool streamJittery(qint64 now) const;
+
+    QThread *m_thread;
+    QMutex m_mutex;
+    QWaitCondition m_wake;
+    QList<Command> m_queue;
+    bool m_stopping;
+
+    QHash<quintptr, std::function<void()>> m_latest;
+    QHash<quintptr, qint64> m_lastRun;
+    QElapsedTimer m_clock;
+    int m_minWriteInterval;
+
+    int m_maxCommandRate;
+    float m_tokens;
+    qint64 m_lastRefill;
+
+    float m_jitterTolerance;
+    qint64 m_lastFrame;
+    float m_frameIntervalMs, m_frameJitterMs;
+    bool m_deferring;
+    quint64 m_deferredByJitter, m_deferredByBudget;
+
+    float m_lastLatencyMs, m_averageLatencyMs, m_maxLatencyMs;
+    quint64 m_completed;
+    quint64 m_coalesced;
+};
+
+#endif // COMMANDEXECUTOR_H
@@ -0,0 +1,73 @@
+#ifndef COMMANDSTATS_H
+#define COMMANDSTATS_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QVariantList>
+
+#include <functional>
+
+/* Per-command counters for a device's control channel: transfers, errors,
+ * cache hits and a latency histogram for each command ID (Lepton
+ * LEP_COMMAND_ID, Boson FLR_FUNCTION). Bin 0 counts transfers under 64 us,
+ * bin i those under 64 us << i, and the last bin everything slower.
+ *
+ * Recording may happen on any thread; the updated signal is published at
+ * most once a second. */
+class CommandStats : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit CommandStats(QObject *parent = 0);
+
+    static const int HistogramBins = 16;
+
+    struct Entry {
+        quint64 calls;
+        quint64 errors;
+        quint64 cacheHits;
+        qint64 totalNs;
+        qint64 maxNs;
+        quint64 histogram[HistogramBins];
+    };
+
+    // turns a command ID into something readable for snapshots and exports
+    void setNamer(std::function<QString(quint32)> namer) { m_namer = namer; }
+
+    void recordCall(quint32 id, bool ok, qint64 nsecs);
+    void recordCacheHit(quint32 id);
+
+    Q_PROPERTY(quint64 totalCalls READ getTotalCalls NOTIFY updated)
+    quint64 getTotalCalls() const { return m_totalCalls; }
+
+    Q_PROPERTY(quint64 totalErrors READ getTotalErrors NOTIFY updated)
+    quint64 getTotalErrors() const { return m_totalErrors; }
+
+    /* One map per command, busiest first: id, name, calls, errors,
+     * cacheHits, meanMs, maxMs and histogram (list of counts). */
+    Q_INVOKABLE QVariantList snapshot(int limit = -1);
+
+    Q_INVOKABLE QString toCsv();
+    Q_INVOKABLE bool exportCsv(const QString &path);
+
+    Q_INVOKABLE void reset();
+
+signals:
+    void updated();
+
+private:
+    Entry &entry(quint32 id);
+    void publish();
+    QList<quint32> busiest();
+
+    QMutex m_mutex;
+    QHash<quint32, Entry> m_entries;
+    std::function<QString(quint32)> m_namer;
+    quint64 m_totalCalls, m_totalErrors;
+    QElapsedTimer m_published;
+};
+
+#endif // COMMANDSTATS_H
@@ -0,0 +1,32 @@
+#ifndef CONTROLBENCHMARK_H
+#define CONTROLBENCHMARK_H
+
+#include <QString>
+
+/* Drives a LeptonVariation on a SimulatedLepton the way the UI does and
+ * prints what the control path costs: startup, attribute reads through the
+ * cache, bursts of coalesced writes, configuration batches and spotmeter
+ * polls, all through the executor. Needs no camera and no QML; the same
+ * seed gives the same transfers and injected errors. */
+class ControlBenchmark
+{
+public:
+    ControlBenchmark(int rounds, quint32 seed);
+
+    void setLatency(int latencyUs, int jitterUs);
+    void setErrorRate(double rate);
+    // per-command statistics go here as CSV, if set
+    void setCsvPath(const QString &path) { m_csvPath = path; }
+
+    // 0 when every configuration batch verified
+    int run();
+
+private:
+    int m_rounds;
+    quint32 m_seed;
+    int m_latencyUs, m_jitterUs;
+    double m_errorRate;
+    QString m_csvPath;
+};
+
+#endif // CONTROLBENCHMARK_H
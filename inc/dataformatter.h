@@ -5,6 +5,9 @@
 #include <libuvc/libuvc.h>
 #include <QVideoFrame>
 
+#include "detailenhancer.h"
+#include "remapengine.h"
+
 typedef struct { const uint8_t colormap[256 * 3]; } colormap_t;
 
 class DataFormatter : public QObject
@@ -22,11 +25,17 @@ public:
     };
     Q_ENUMS(Palette)
     Q_PROPERTY(Palette pseudocolorPalette MEMBER m_pseudocolor_palette NOTIFY psuedocolorPaletteChanged)
+    Palette getPseudocolorPalette() const { return m_pseudocolor_palette; }
 
     void FindMinMax(const uvc_frame_t *input, QPoint &minPoint, uint16_t &minVal, QPoint &maxPoint, uint16_t &maxVal) const;
     void AutoGain(uvc_frame_t *input_output);
+    // with a range from elsewhere, e.g. the camera; the points stay as they were
+    void AutoGain(uvc_frame_t *input_output, ushort minval, ushort maxval);
     void FixedGain(uvc_frame_t *input_output, QPoint minpoint, ushort minval, QPoint maxpoint, ushort maxval);
     void Colorize(const uvc_frame_t *input, QVideoFrame &output) const;
+    // colorize through the remap, sampling the input once per output pixel;
+    // false, with output unwritten, if the geometry no longer fits output
+    bool Colorize(const uvc_frame_t *input, QVideoFrame &output, RemapEngine &remap) const;
 
     static const colormap_t* getPalette(Palette palette);
 
@@ -42,6 +51,16 @@ public:
     Q_PROPERTY(QPoint maxPoint READ getMaxPoint NOTIFY maxPointChanged)
     QPoint getMaxPoint() const { return m_maxPoint; }
 
+    Q_PROPERTY(bool detailEnhancement MEMBER m_detailEnhancement NOTIFY detailEnhancementChanged)
+
+    Q_PROPERTY(float detailGain READ getDetailGain WRITE setDetailGain NOTIFY detailGainChanged)
+    float getDetailGain() const { return m_dde.gain(); }
+    void setDetailGain(float gain);
+
+    Q_PROPERTY(int detailRadius READ getDetailRadius WRITE setDetailRadius NOTIFY detailRadiusChanged)
+    int getDetailRadius() const { return m_dde.radius(); }
+    void setDetailRadius(int radius);
+
 signals:
 
     void psuedocolorPaletteChanged(Palette val);
@@ -49,12 +68,17 @@ signals:
     void maxValChanged(ushort val);
     void minPointChanged(QPoint point);
     void maxPointChanged(QPoint point);
+    void detailEnhancementChanged(bool enabled);
+    void detailGainChanged(float gain);
+    void detailRadiusChanged(int radius);
 
 private:
 
     Palette m_pseudocolor_palette;
     ushort m_minVal, m_maxVal;
     QPoint m_minPoint, m_maxPoint;
+    bool m_detailEnhancement;
+    DetailEnhancer m_dde;
 };
 
 #endif // DATAFORMATTER_H
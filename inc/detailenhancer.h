@@ -0,0 +1,44 @@
+#ifndef DETAILENHANCER_H
+#define DETAILENHANCER_H
+
+#include <QVector>
+#include <libuvc/libuvc.h>
+
+/* Digital detail enhancement on 16-bit data: the frame is split into a base
+ * layer (separable box filter) and a detail layer (input - base), and the
+ * detail is amplified before the result goes through the 8-bit gain stage,
+ * so fine structure survives the quantization.
+ *
+ * The filter runs in two passes over horizontal row bands, which are spread
+ * across threads when threaded is set. */
+class DetailEnhancer
+{
+public:
+    DetailEnhancer();
+
+    void apply(uvc_frame_t *input_output);
+
+    int radius() const { return m_radius; }
+    void setRadius(int radius);
+
+    float gain() const { return m_gain; }
+    void setGain(float gain) { m_gain = gain; }
+
+    bool threaded() const { return m_threaded; }
+    void setThreaded(bool threaded) { m_threaded = threaded; }
+
+    static const int MaxRadius = 7;
+
+private:
+    void horizontalPass(const uvc_frame_t *frame, int r, int rowBegin, int rowEnd);
+    void verticalPass(uvc_frame_t *frame, int r, float gain, int rowBegin, int rowEnd);
+
+    int m_radius;
+    float m_gain;
+    bool m_threaded;
+
+    int m_width, m_height;
+    QVector<uint32_t> m_rowSums;
+};
+
+#endif // DETAILENHANCER_H
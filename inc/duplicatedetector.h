@@ -0,0 +1,70 @@
+#ifndef DUPLICATEDETECTOR_H
+#define DUPLICATEDETECTOR_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <libuvc/libuvc.h>
+
+/* Detects frames the camera repeated. Lepton modules run their core at 27Hz
+ * but only deliver new data at ~9Hz, and PureThermal boards pass the repeats
+ * through. If the frame carries a counter (telemetry), it is compared
+ * directly; otherwise a position-sensitive checksum of the whole payload is.
+ *
+ * check() runs on the UVC callback thread; counters are published once a
+ * second. */
+class DuplicateDetector : public QObject
+{
+    Q_OBJECT
+
+public:
+    DuplicateDetector();
+
+    // true if the frame repeats the previous one; frameCounter < 0 means unknown
+    bool check(const uvc_frame_t *frame, qint64 frameCounter = -1);
+
+    Q_PROPERTY(bool enabled MEMBER m_enabled NOTIFY enabledChanged)
+
+    // drop duplicates in the callback; otherwise they are only flagged in the
+    // "duplicate" metadata of the emitted frame
+    Q_PROPERTY(bool skipDuplicates READ skipDuplicates WRITE setSkipDuplicates NOTIFY skipDuplicatesChanged)
+    bool skipDuplicates() const { return m_enabled && m_skipDuplicates; }
+    void setSkipDuplicates(bool skip);
+
+    Q_PROPERTY(quint64 duplicateFrames READ getDuplicateFrames NOTIFY countersChanged)
+    quint64 getDuplicateFrames() const { return m_duplicateFrames; }
+
+    Q_PROPERTY(quint64 uniqueFrames READ getUniqueFrames NOTIFY countersChanged)
+    quint64 getUniqueFrames() const { return m_uniqueFrames; }
+
+    // per second, over the last publishing interval
+    Q_PROPERTY(float duplicateRate READ getDuplicateRate NOTIFY countersChanged)
+    float getDuplicateRate() const { return m_duplicateRate; }
+
+    Q_PROPERTY(float uniqueRate READ getUniqueRate NOTIFY countersChanged)
+    float getUniqueRate() const { return m_uniqueRate; }
+
+    static quint64 payloadHash(const uint8_t *data, size_t bytes);
+
+signals:
+    void enabledChanged(bool enabled);
+    void skipDuplicatesChanged(bool skip);
+    void countersChanged();
+
+private:
+    void count(bool duplicate);
+
+    bool m_enabled;
+    bool m_skipDuplicates;
+
+    bool m_havePrevious;
+    qint64 m_lastCounter;
+    quint64 m_lastHash;
+    size_t m_lastBytes;
+
+    quint64 m_duplicateFrames, m_uniqueFrames;
+    quint64 m_windowDuplicates, m_windowUnique;
+    float m_duplicateRate, m_uniqueRate;
+    QElapsedTimer m_window;
+};
+
+#endif // DUPLICATEDETECTOR_H
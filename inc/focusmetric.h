@@ -0,0 +1,62 @@
+#ifndef FOCUSMETRIC_H
+#define FOCUSMETRIC_H
+
+#include <QObject>
+#include <QMutex>
+#include <QRect>
+#include <libuvc/libuvc.h>
+
+/* Per-frame sharpness score computed on the raw Y16 frame, for focusing
+ * lenses by hand. This replaces polling LEP_GetVidFocusMetric, which is a
+ * control transfer per sample and only supports the camera's own ROI. */
+class FocusMetric : public QObject
+{
+    Q_OBJECT
+
+public:
+    FocusMetric();
+
+    enum Method {
+        LaplacianVariance,
+        Tenengrad,
+    };
+    Q_ENUMS(Method)
+
+    void update(const uvc_frame_t *frame);
+
+    Q_PROPERTY(bool enabled MEMBER m_enabled NOTIFY enabledChanged)
+    bool isEnabled() const { return m_enabled; }
+    Q_PROPERTY(Method method MEMBER m_method NOTIFY methodChanged)
+
+    // region in sensor pixels; an empty rect means the whole frame
+    Q_PROPERTY(QRect roi READ getRoi WRITE setRoi NOTIFY roiChanged)
+    QRect getRoi();
+    void setRoi(const QRect &roi);
+
+    Q_PROPERTY(float score READ getScore NOTIFY scoreChanged)
+    float getScore() const;
+
+    Q_PROPERTY(float peakScore READ getPeakScore NOTIFY scoreChanged)
+    float getPeakScore() const;
+
+    Q_INVOKABLE void resetPeak();
+
+signals:
+    void enabledChanged(bool enabled);
+    void methodChanged(Method method);
+    void roiChanged(const QRect &roi);
+    void scoreChanged(float score);
+
+private:
+    float laplacianVariance(const uvc_frame_t *frame, const QRect &roi) const;
+    float tenengrad(const uvc_frame_t *frame, const QRect &roi) const;
+
+    // guards the ROI and the scores, which the UVC callback writes
+    mutable QMutex m_mutex;
+    bool m_enabled;
+    Method m_method;
+    QRect m_roi;
+    float m_score, m_peakScore;
+};
+
+#endif // FOCUSMETRIC_H
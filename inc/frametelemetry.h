@@ -0,0 +1,45 @@
+#ifndef FRAMETELEMETRY_H
+#define FRAMETELEMETRY_H
+
+#include <QMetaType>
+
+/* Per-frame metadata decoded from the camera's in-band telemetry rows. Only
+ * the fields both Lepton and Boson provide are here; valid is false when the
+ * frame carried no telemetry. */
+struct FrameTelemetry
+{
+    enum FfcState {
+        FfcUnknown,
+        FfcNeverCommanded,
+        FfcImminent,
+        FfcInProgress,
+        FfcComplete,
+    };
+
+    FrameTelemetry()
+        : valid(false)
+        , frameCounter(0)
+        , uptimeMs(0)
+        , fpaTempKelvin(0.0f)
+        , housingTempKelvin(0.0f)
+        , ffcState(FfcUnknown)
+        , ffcDesired(false)
+        , agcEnabled(false)
+        , gainMode(-1)
+    {
+    }
+
+    bool valid;
+    quint32 frameCounter;
+    quint32 uptimeMs;
+    float fpaTempKelvin;
+    float housingTempKelvin;   // 0 if the camera doesn't report it
+    FfcState ffcState;
+    bool ffcDesired;
+    bool agcEnabled;
+    int gainMode;              // camera-specific enum, -1 if unknown
+};
+
+Q_DECLARE_METATYPE(FrameTelemetry)
+
+#endif // FRAMETELEMETRY_H
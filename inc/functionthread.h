@@ -0,0 +1,26 @@
+#ifndef FUNCTIONTHREAD_H
+#define FUNCTIONTHREAD_H
+
+#include <QThread>
+
+#include <functional>
+
+/* A thread that runs one function, for the Qt versions (before 5.10) that
+ * don't have QThread::create. */
+class FunctionThread : public QThread
+{
+public:
+    explicit FunctionThread(std::function<void()> fn, QObject *parent = 0)
+        : QThread(parent)
+        , m_fn(fn)
+    {
+    }
+
+protected:
+    virtual void run() { m_fn(); }
+
+private:
+    std::function<void()> m_fn;
+};
+
+#endif // FUNCTIONTHREAD_H
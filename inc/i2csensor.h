@@ -0,0 +1,97 @@
+#ifndef I2CSENSOR_H
+#define I2CSENSOR_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QList>
+#include <QVariantMap>
+
+#include "LEPTON_ErrorCodes.h"
+
+/* The accessory I2C bus of a board. A transaction writes writeLength bytes
+ * to the device, then reads readLength bytes back; -1 skips either half.
+ * The return value is about reaching the board, *i2cResult about the
+ * device answering. */
+class I2CBus
+{
+public:
+    virtual ~I2CBus() { }
+
+    // longest read in one transaction
+    static const int MaxRead = 512;
+
+    virtual bool i2cAvailable() const = 0;
+    virtual LEP_RESULT i2cWriteRead(uint8_t address, const void *writeData, int writeLength,
+                                    void *readData, int readLength, LEP_RESULT *i2cResult) = 0;
+};
+
+/* Driver for one sensor at one address. probe, reads, decode and the state
+ * hooks are called on the control executor only; the properties are for the
+ * GUI thread, and the executor side updates them through publishValues and
+ * publishAvailable. */
+class I2CSensor : public QObject
+{
+    Q_OBJECT
+
+public:
+    I2CSensor(const QString &driver, uint8_t address, int pollInterval, QObject *parent = 0);
+
+    struct Read {
+        uint8_t reg;
+        int length;
+    };
+
+    Q_PROPERTY(QString driver READ getDriver CONSTANT)
+    QString getDriver() const { return m_driver; }
+
+    Q_PROPERTY(int address READ getAddress CONSTANT)
+    int getAddress() const { return m_address; }
+
+    Q_PROPERTY(bool available READ isAvailable NOTIFY availableChanged)
+    bool isAvailable() const { return m_available; }
+
+    Q_PROPERTY(int pollInterval READ getPollInterval WRITE setPollInterval NOTIFY pollIntervalChanged)
+    int getPollInterval() const { return m_pollInterval; }
+    void setPollInterval(int ms);
+
+    // latest reading per channel, temperatures in Kelvin
+    Q_PROPERTY(QVariantMap values READ getValues NOTIFY valuesChanged)
+    QVariantMap getValues() const { return m_values; }
+
+    // whether the device is there and is what this driver expects
+    virtual bool probe(I2CBus *bus) = 0;
+
+    // registers to read on the next poll, and what they say
+    virtual QList<Read> reads() = 0;
+    virtual bool decode(const QList<Read> &reads, const QList<QByteArray> &data, QVariantMap *values) = 0;
+
+    // a read starting at one register may continue into the next ones, each
+    // registerWidth bytes long; lets the poller merge adjacent reads
+    virtual bool autoIncrement() const { return false; }
+    virtual int registerWidth() const { return 1; }
+
+    // what probe learned, for the capability profile
+    virtual QVariant saveState() const { return QVariant(); }
+    virtual void restoreState(const QVariant &) { }
+
+    // counts a poll; false once the sensor fails too often to keep polling
+    bool noteResult(bool ok);
+
+    void publishAvailable(bool available);
+    void publishValues(const QVariantMap &values);
+
+signals:
+    void availableChanged();
+    void pollIntervalChanged();
+    void valuesChanged();
+
+private:
+    QString m_driver;
+    uint8_t m_address;
+    int m_pollInterval;
+    bool m_available;
+    QVariantMap m_values;
+    int m_errorScore;
+};
+
+#endif // I2CSENSOR_H
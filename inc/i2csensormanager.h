@@ -0,0 +1,75 @@
+#ifndef I2CSENSORMANAGER_H
+#define I2CSENSORMANAGER_H
+
+#include <QObject>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QTimer>
+#include <QVariantList>
+
+#include "commandexecutor.h"
+#include "i2csensor.h"
+
+/* The sensors on a board's accessory I2C bus. Every known driver gets a
+ * sensor object per candidate address; probe finds out which are there.
+ * Each available sensor is polled at its own pollInterval on the control
+ * executor, and reads of adjacent registers of one device go out as one
+ * transaction where the device allows it. */
+class I2CSensorManager : public QObject
+{
+    Q_OBJECT
+
+public:
+    I2CSensorManager(I2CBus *bus, CommandExecutor *executor, QObject *parent = 0);
+
+    // the available sensors
+    Q_PROPERTY(QList<QObject*> sensors READ getSensors NOTIFY sensorsChanged)
+    QList<QObject*> getSensors() const;
+
+    // the first available sensor with this driver, or NULL
+    I2CSensor *find(const QString &driver) const;
+
+    // from the executor; blocks while the candidates are tried
+    void probe();
+
+    // which sensors probe found, and what it learned about them
+    QVariantMap capabilities() const;
+    // checks on the executor that each sensor still answers before using it
+    void restore(const QVariantMap &capabilities);
+
+    // logs which addresses answer, for diagnostics; scanFinished follows
+    Q_INVOKABLE void scan();
+
+signals:
+    void sensorsChanged();
+    // any sensor has a new reading
+    void sensorValuesChanged();
+    void scanFinished(const QVariantList &addresses);
+
+private slots:
+    void tick();
+    void updatePolling();
+
+private:
+    void addSensor(I2CSensor *sensor);
+    LEP_RESULT ping(uint8_t address, LEP_RESULT *i2cResult);
+    bool readRegisters(I2CSensor *sensor, const QList<I2CSensor::Read> &reads, QList<QByteArray> *data);
+    void poll(const QList<I2CSensor*> &due);
+
+    I2CBus *m_bus;
+    CommandExecutor *m_executor;
+    QList<I2CSensor*> m_sensors;
+    QHash<I2CSensor*, QString> m_keys;
+
+    // what probe found or restore confirmed; both write it on the executor
+    QVariantMap m_found;
+
+    QTimer *m_pollTimer;
+    QElapsedTimer m_clock;
+    QHash<I2CSensor*, qint64> m_lastPoll;
+    QAtomicInt m_pollPending;
+};
+
+#endif // I2CSENSORMANAGER_H
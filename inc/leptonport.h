@@ -0,0 +1,103 @@
+#ifndef LEPTONPORT_H
+#define LEPTONPORT_H
+
+#include <QSize>
+#include <QString>
+#include <libuvc/libuvc.h>
+#include "LEPTON_ErrorCodes.h"
+
+#define LEP_CID_AGC_MODULE (0x0100)
+#define LEP_CID_OEM_MODULE (0x0800)
+#define LEP_CID_RAD_MODULE (0x0E00)
+#define LEP_CID_SYS_MODULE (0x0200)
+#define LEP_CID_VID_MODULE (0x0300)
+
+// the PureThermal firmware's extension units
+typedef enum {
+  VC_CONTROL_XU_LEP_AGC_ID = 3,
+  VC_CONTROL_XU_LEP_OEM_ID,
+  VC_CONTROL_XU_LEP_RAD_ID,
+  VC_CONTROL_XU_LEP_SYS_ID,
+  VC_CONTROL_XU_LEP_VID_ID,
+  VC_CONTROL_XU_I2C_ID = 0x80,
+  VC_CONTROL_XU_LEP_CUST_ID = 0xfe,
+} VC_TERMINAL_ID;
+
+// controls of the custom XU, one less than their control selector
+enum CUST_COMTROL_IDS {
+	CUST_CONTROL_COMMAND=0,
+	CUST_CONTROL_GET,
+	CUST_CONTROL_SET,
+	CUST_CONTROL_RUN,
+	CUST_CONTROL_DIRECT_WRITE,
+	CUST_CONTROL_DIRECT_READ,
+    CUST_CONTROL_I2C_WRITEREAD,
+	CUST_CONTROL_END
+};
+
+// an accessory I2C transaction on the custom XU: the request goes to
+// CUST_CONTROL_COMMAND, the response is read from CUST_CONTROL_I2C_WRITEREAD
+struct LeptonI2CRequest {
+    uint16_t address;
+    int16_t lengthWrite, lengthRead;
+    uint8_t data[510];
+} __attribute__((packed));
+
+struct LeptonI2CResponse {
+    LEP_RESULT result;
+    uint8_t data[512];
+} __attribute__((packed));
+
+/* What LeptonVariation needs from a board: what the device says about itself
+ * and the control transfers on its extension units. UvcLeptonPort is a
+ * PureThermal board through libuvc; SimulatedLepton stands in for one. */
+class LeptonPort
+{
+public:
+    struct Description {
+        quint16 vendorId;
+        quint16 productId;
+        QString manufacturer;
+        QString product;
+        // the PureThermal firmware version
+        QString usbSerial;
+        QSize sensorSize;
+        // a taller Y16 frame with the telemetry rows, if the firmware has one
+        QSize telemetrySize;
+        // the custom XU can run transactions on the accessory I2C bus
+        bool genericI2C;
+    };
+
+    virtual ~LeptonPort() { }
+
+    virtual Description describe() = 0;
+
+    // GET_CUR and SET_CUR on an extension unit control; the bytes transferred
+    // or a negative uvc_error_t, like uvc_get_ctrl and uvc_set_ctrl
+    virtual int getCtrl(uint8_t unit, uint8_t control, void *data, int length) = 0;
+    virtual int setCtrl(uint8_t unit, uint8_t control, void *data, int length) = 0;
+};
+
+class UvcLeptonPort : public LeptonPort
+{
+public:
+    UvcLeptonPort(uvc_device_t *dev, uvc_device_handle_t *devh);
+
+    virtual Description describe();
+
+    virtual int getCtrl(uint8_t unit, uint8_t control, void *data, int length)
+    {
+        return uvc_get_ctrl(m_devh, unit, control, data, length, UVC_GET_CUR);
+    }
+
+    virtual int setCtrl(uint8_t unit, uint8_t control, void *data, int length)
+    {
+        return uvc_set_ctrl(m_devh, unit, control, data, length);
+    }
+
+private:
+    uvc_device_t *m_dev;
+    uvc_device_handle_t *m_devh;
+};
+
+#endif // LEPTONPORT_H
@@ -2,6 +2,9 @@
 #define LEPTONVARIATION_H
 
 #include <QObject>
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QHash>
 #include <QMutex>
 #include "LEPTON_Types.h"
 #include "LEPTON_ErrorCodes.h"
@@ -14,6 +17,9 @@
 #include <libuvc/libuvc.h>
 
 #include "abstractccinterface.h"
+#include "capabilitycache.h"
+#include "i2csensormanager.h"
+#include "leptonport.h"
 #include "leptonvariation_types.h"
 
 #include <functional>
@@ -33,13 +39,15 @@ using namespace LEP;
 #define SDK_UINT16_PROPERTY(name, sdk_name) \
     SDK_SIMPLE_PROPERTY(unsigned int, uint16_t, name, sdk_name)
 
-class LeptonVariation : public AbstractCCInterface
+class LeptonVariation : public AbstractCCInterface, public I2CBus
 {
     Q_OBJECT
 public:
     LeptonVariation(uvc_context_t *ctx,
                     uvc_device_t *dev,
                     uvc_device_handle_t *devh);
+    // takes ownership of the port
+    explicit LeptonVariation(LeptonPort *port);
 
     virtual ~LeptonVariation();
 
@@ -56,11 +64,14 @@ public:
     LEP_RESULT UVC_I2CWriteRead(uint8_t i2cAddress, const void* writeData, int writeLength, void* readData, int readLength, LEP_RESULT* i2cResult);
     LEP_RESULT UVC_I2CWrite(uint8_t i2cAddress, const void* writeData, int writeLength, LEP_RESULT* i2cResult);
     LEP_RESULT UVC_I2CRead(uint8_t i2cAddress, void* readData, int readLength, LEP_RESULT* i2cResult);
-    LEP_RESULT UVC_I2CScan(bool addressPresent[128], bool verbose = true);
 
-    LEP_RESULT ReadMLX90614AmbientTemperature(uint16_t* raw, float* kelvin, bool force = false);
-    LEP_RESULT ReadMLX90614ObjectTemperature(uint16_t* raw, float* kelvin, bool force = false);
-    LEP_RESULT ReadFromMLX90614(uint8_t command, uint16_t* out);
+    // the accessory bus behind the custom XU
+    virtual bool i2cAvailable() const { return supportsGenericI2C; }
+    virtual LEP_RESULT i2cWriteRead(uint8_t address, const void *writeData, int writeLength,
+                                    void *readData, int readLength, LEP_RESULT *i2cResult)
+    {
+        return UVC_I2CWriteRead(address, writeData, writeLength, readData, readLength, i2cResult);
+    }
 
     LEP_CAMERA_PORT_DESC_T_PTR GetPortDescription() { return &m_portDesc; }
 
@@ -86,16 +97,16 @@ public:
     SDK_UINT16_PROPERTY(agcHeqEmptyCount, AgcHeqEmptyCount)
     SDK_UINT16_PROPERTY(agcHeqNormalizationFactor, AgcHeqNormalizationFactor)
 
-    Q_PROPERTY(const QString sysFlirSerialNumber READ getSysFlirSerialNumber CONSTANT)
+    Q_PROPERTY(const QString sysFlirSerialNumber READ getSysFlirSerialNumber NOTIFY identityChanged)
     const QString getSysFlirSerialNumber();
 
     Q_PROPERTY(const QString oemFlirPartNumber READ getOemFlirPartNumber CONSTANT)
     const QString getOemFlirPartNumber();
 
-    Q_PROPERTY(const QString oemGppSoftwareVersion READ getOemGppSoftwareVersion CONSTANT)
+    Q_PROPERTY(const QString oemGppSoftwareVersion READ getOemGppSoftwareVersion NOTIFY identityChanged)
     const QString getOemGppSoftwareVersion();
 
-    Q_PROPERTY(const QString oemDspSoftwareVersion READ getOemDspSoftwareVersion CONSTANT)
+    Q_PROPERTY(const QString oemDspSoftwareVersion READ getOemDspSoftwareVersion NOTIFY identityChanged)
     const QString getOemDspSoftwareVersion();
 
     SDK_ENUM_PROPERTY(PCOLOR_LUT_E, vidPcolorLut, VidPcolorLut)
@@ -113,15 +124,20 @@ public:
     }
     void setRadSpotmeterRoi(const QRect& roi);
 
+    // the first MLX90614 on the accessory bus; see i2cSensors for all
     Q_PROPERTY(float irThermometerInKelvin READ getIrThermometerInKelvin NOTIFY irThermometerInKelvinChanged)
-    float getIrThermometerInKelvin() { return objectTemperatureMLX90614; }
+    float getIrThermometerInKelvin();
 
     Q_PROPERTY(float irThermometerAmbientInKelvin READ getIrThermometerAmbientInKelvin NOTIFY irThermometerAmbientInKelvinChanged)
-    float getIrThermometerAmbientInKelvin() { return ambientTemperatureMLX90614; }
+    float getIrThermometerAmbientInKelvin();
 
     Q_PROPERTY(bool irThermometerAvailable READ getIrThermometerAvailable NOTIFY irThermometerAvailableChanged)
-    bool getIrThermometerAvailable() { return hasMLX90614; }
+    bool getIrThermometerAvailable() { return m_i2cSensors->find("MLX90614") != NULL; }
+
+    Q_PROPERTY(I2CSensorManager* i2cSensors READ getI2CSensors CONSTANT)
+    I2CSensorManager *getI2CSensors() const { return m_i2cSensors; }
 
+    SDK_ENUM_PROPERTY(RAD_ENABLE_E, radTLinearEnableState, RadTLinearEnableState)
     SDK_ENUM_PROPERTY(RAD_TLINEAR_RESOLUTION_E, radTLinearResolution, RadTLinearResolution)
 
     SDK_ENUM_PROPERTY(SYS_GAIN_MODE_E, sysGainMode, SysGainMode)
@@ -132,18 +148,34 @@ public:
     const QString getPtFirmwareVersion() const;
 
     Q_PROPERTY(bool supportsHwPseudoColor READ getSupportsHwPseudoColor CONSTANT)
-    bool getSupportsHwPseudoColor() const;
+    bool getSupportsHwPseudoColor() const { return m_supportsHwPseudoColor; }
 
     Q_PROPERTY(bool supportsRadiometry READ getSupportsRadiometry CONSTANT)
-    bool getSupportsRadiometry();
+    bool getSupportsRadiometry() const { return m_supportsRadiometry; }
 
     Q_PROPERTY(bool supportsRuntimeAgcChange READ getSupportsRuntimeAgcChange CONSTANT)
-    bool getSupportsRuntimeAgcChange() const;
+    bool getSupportsRuntimeAgcChange() const { return m_supportsRuntimeAgcChange; }
 
     virtual const QVideoSurfaceFormat getDefaultFormat();
+    virtual const QVideoSurfaceFormat getCameraColorFormat();
+    virtual bool uploadPalette(const QByteArray &rgb);
+    virtual bool getSceneStats(SceneStats *out);
+
+    // drop cached attributes, read them all back and notify bindings
+    Q_INVOKABLE void refreshAttributes();
+
+    virtual bool getSupportsTelemetry() const { return m_telemetrySize.isValid(); }
+    virtual bool getTelemetryEnabled() const { return m_telemetryEnabled; }
+    virtual void setTelemetryEnabled(bool enabled);
+    virtual int getTelemetryRows() const;
+    virtual bool getTelemetryAtTop() const { return false; }
+    virtual bool parseTelemetry(const uint8_t *data, int width, int rows, int step, FrameTelemetry *out);
 
 signals:
 
+    // the rest of the identity is read after streaming has started
+    void identityChanged();
+
     void agcEnableChanged(AGC_ENABLE_E val);
     void agcPolicyChanged(AGC_POLICY_E val);
     void agcHeqScaleFactorChanged(AGC_HEQ_SCALE_FACTOR_E val);
@@ -168,6 +200,7 @@ signals:
     void vidPolarityChanged(POLARITY_E val);
     void vidSbNucEnableStateChanged(VID_SBNUC_ENABLE_E val);
 
+    void radTLinearEnableStateChanged(RAD_ENABLE_E val);
     void radTLinearResolutionChanged(RAD_TLINEAR_RESOLUTION_E val);
     void radSpotmeterInKelvinX100Changed();
     void radSpotmeterRoiChanged();
@@ -178,16 +211,31 @@ signals:
     void sysGainModeChanged(SYS_GAIN_MODE_E val);
 
 public slots:
-    virtual void performFfc();
     void updateSpotmeter();
 
+protected:
+    virtual bool startFfc();
+    virtual bool queryFfcInProgress();
+
+    virtual bool isConfigAttribute(const QString &name) const;
+    virtual int attributePhase(const QString &name) const;
+    virtual void invalidateForVerify() { invalidateAttributes(); }
+
 private:
 
     LEP_RESULT UVC_CustomRead(void* attributePtr, int length);
 
     LEP_RESULT UVC_CustomWrite(const void* attributePtr, int length);
 
-    LEP_RESULT EnumerateMLX90614();
+    void discover(bool warm);
+    bool loadCapabilities();
+    void saveCapabilities();
+    void updateSupports();
+
+    void prefetchAttributes();
+    // emits the notify signal of every settable property, from the cache
+    void notifyAttributes();
+    void invalidateAttributes(int module = -1);
 
     template <class T, class W>
     function<W(void)> bind_get(function<LEP_RESULT(LEP_CAMERA_PORT_DESC_T_PTR, T*)> F)
@@ -210,34 +258,69 @@ private:
         return (W)var;
     }
 
+    // queued on the executor; the change is announced once the camera has
+    // it, so bindings that re-read the property get the new value. Writes
+    // through the same SDK setter are coalesced, latest value wins. On the
+    // executor itself (a config batch) the write happens right away.
     template <class T, class W>
     void pset(function<LEP_RESULT(LEP_CAMERA_PORT_DESC_T_PTR, T)> F, function<void(W)> E, W var)
     {
-        F(&m_portDesc, (T)var);
-        emit E(var);
+        typedef LEP_RESULT (*Setter)(LEP_CAMERA_PORT_DESC_T_PTR, T);
+        const Setter *setter = F.template target<Setter>();
+
+        auto write = [this, F, E, var]() {
+            F(&m_portDesc, (T)var);
+            emit E(var);
+        };
+
+        if (executor()->isExecutorThread())
+            write();
+        else if (setter)
+            executor()->postCoalesced(reinterpret_cast<quintptr>(*setter), write);
+        else
+            executor()->post(write);
     }
 
     uvc_context_t *ctx;
     uvc_device_t *dev;
     uvc_device_handle_t *devh;
+    LeptonPort *m_port;
+    LeptonPort::Description m_description;
     LEP_CAMERA_PORT_DESC_T m_portDesc;
-    uvc_device_descriptor_t *desc;
     QSize m_sensorSize;
+    QSize m_telemetrySize;
+    bool m_telemetryEnabled;
     QRecursiveMutex m_mutex;
     LEP_RAD_ROI_T m_spotmeterRoi;
+    QAtomicInt m_spotmeterKelvinX100;
+    QAtomicInt m_periodicPending;
 
     QTimer *m_periodicTimer;
 
+    /* Attributes behind the settable properties, as last read from or written
+     * to the camera, keyed by command ID without the type bits. Only IDs in
+     * here are cached, so measurements and status are always read live. */
+    struct CachedAttribute {
+        QByteArray data;
+        bool valid;
+    };
+    QHash<int, CachedAttribute> m_attributeCache;
+    bool m_prefetching;
+
     uint64_t serialNumber;
     LEP_OEM_SW_VERSION_T swVers;
     LEP_OEM_PART_NUMBER_T partNumber;
 
     bool supportsGenericI2C;
-    bool hasMLX90614;
-    int errorsForMLX90614;
-    float ambientTemperatureMLX90614, objectTemperatureMLX90614;
+    I2CSensorManager *m_i2cSensors;
+
+    CapabilityCache *m_capabilities;
+    bool m_supportsHwPseudoColor;
+    bool m_supportsRadiometry;
+    bool m_supportsRuntimeAgcChange;
 
     int leptonCommandIdToUnitId(LEP_COMMAND_ID commandID);
+    static QString commandName(quint32 id);
 };
 
 Q_DECLARE_METATYPE(PCOLOR_LUT_E)
@@ -246,6 +329,7 @@ Q_DECLARE_METATYPE(VID_SBNUC_ENABLE_E)
 Q_DECLARE_METATYPE(AGC_ENABLE_E)
 Q_DECLARE_METATYPE(AGC_POLICY_E)
 Q_DECLARE_METATYPE(AGC_HEQ_SCALE_FACTOR_E)
+Q_DECLARE_METATYPE(RAD_ENABLE_E)
 Q_DECLARE_METATYPE(RAD_TLINEAR_RESOLUTION_E)
 Q_DECLARE_METATYPE(SYS_GAIN_MODE_E)
 
@@ -62,6 +62,11 @@ namespace LEP {
         LEP_AGC_SCALE_TO_14_BITS, \
     )
 
+    QML_ENUM(RAD_ENABLE_E, char, \
+        LEP_RAD_DISABLE, \
+        LEP_RAD_ENABLE, \
+    )
+
     QML_ENUM(RAD_TLINEAR_RESOLUTION_E, char, \
         LEP_RAD_RESOLUTION_0_1, \
         LEP_RAD_RESOLUTION_0_01, \
@@ -0,0 +1,37 @@
+#ifndef MLX90614_H
+#define MLX90614_H
+
+#include "i2csensor.h"
+
+/* Melexis MLX90614 IR thermometer, SMBus read word with PEC. Channels are
+ * "object" and "ambient" (the sensor itself), in Kelvin; the ambient
+ * temperature changes slowly and is read on every fifth poll only. */
+class Mlx90614 : public I2CSensor
+{
+    Q_OBJECT
+
+public:
+    explicit Mlx90614(uint8_t address, QObject *parent = 0);
+
+    virtual bool probe(I2CBus *bus);
+    virtual QList<Read> reads();
+    virtual bool decode(const QList<Read> &reads, const QList<QByteArray> &data, QVariantMap *values);
+
+    virtual QVariant saveState() const { return m_checkPec; }
+    virtual void restoreState(const QVariant &state) { m_checkPec = state.toBool(); }
+
+    // over the whole transaction, both address bytes included
+    static uint8_t smbusPec(const uint8_t *data, int length);
+
+private:
+    bool readWord(I2CBus *bus, uint8_t command, uint16_t *out, bool *pecOk);
+    bool probeWord(I2CBus *bus, uint8_t command, uint16_t *out, bool *pecOk);
+    bool wordFromReply(uint8_t command, const QByteArray &reply, uint16_t *out, bool *pecOk) const;
+
+    // some clones compute the PEC differently; for those it isn't checked
+    bool m_checkPec;
+    int m_polls;
+    float m_ambientKelvin;
+};
+
+#endif // MLX90614_H
@@ -0,0 +1,98 @@
+#ifndef MOTIONDETECTOR_H
+#define MOTIONDETECTOR_H
+
+#include <QObject>
+#include <QMutex>
+#include <QRect>
+#include <QVector>
+#include <libuvc/libuvc.h>
+
+/* Change detection on the raw Y16 frame: the sum of absolute differences
+ * against a slowly adapting background is taken per block, and blocks over
+ * the threshold are marked changed. Most scenes are static, so the rest of
+ * the pipeline can skip frames (or, through the block mask, regions) that
+ * did not change. */
+class MotionDetector : public QObject
+{
+    Q_OBJECT
+
+public:
+    MotionDetector();
+
+    static const int BlockSize = 16;
+
+    // returns true if any block changed, or if detection is off
+    bool update(const uvc_frame_t *frame);
+
+    Q_PROPERTY(bool enabled MEMBER m_enabled NOTIFY enabledChanged)
+    bool isEnabled() const { return m_enabled; }
+
+    // hold the last displayed frame instead of processing unchanged ones
+    Q_PROPERTY(bool skipUnchanged READ skipUnchanged WRITE setSkipUnchanged NOTIFY skipUnchangedChanged)
+    bool skipUnchanged() const { return m_enabled && m_skipUnchanged; }
+    void setSkipUnchanged(bool skip);
+
+    // mean absolute difference per pixel, in counts, for a block to count as changed
+    Q_PROPERTY(int threshold MEMBER m_threshold NOTIFY thresholdChanged)
+
+    // background time constant as a power of two, in frames
+    Q_PROPERTY(int backgroundShift READ getBackgroundShift WRITE setBackgroundShift NOTIFY backgroundShiftChanged)
+    int getBackgroundShift() const { return m_backgroundShift; }
+    void setBackgroundShift(int shift);
+
+    // report a change at least this often, so AGC and overlays keep up with drift
+    Q_PROPERTY(int maxHoldFrames MEMBER m_maxHoldFrames NOTIFY maxHoldFramesChanged)
+
+    Q_PROPERTY(int changedBlocks READ getChangedBlocks NOTIFY motionChanged)
+    int getChangedBlocks() const { return m_changedBlocks; }
+
+    Q_PROPERTY(int totalBlocks READ getTotalBlocks NOTIFY motionChanged)
+    int getTotalBlocks() const { return m_blocksX * m_blocksY; }
+
+    // bounding box of the changed blocks, in sensor pixels
+    Q_PROPERTY(QRect changedRegion READ getChangedRegion NOTIFY motionChanged)
+    QRect getChangedRegion();
+
+    Q_PROPERTY(int staticFrames READ getStaticFrames NOTIFY motionChanged)
+    int getStaticFrames() const { return m_staticFrames; }
+
+    int blocksX() const { return m_blocksX; }
+    int blocksY() const { return m_blocksY; }
+    bool blockChanged(int bx, int by) const { return m_changedMask[by * m_blocksX + bx] != 0; }
+
+    Q_INVOKABLE void reset();
+
+signals:
+    void enabledChanged(bool enabled);
+    void skipUnchangedChanged(bool skip);
+    void thresholdChanged(int threshold);
+    void backgroundShiftChanged(int shift);
+    void maxHoldFramesChanged(int frames);
+    void motionChanged();
+
+private:
+    void accumulateRow(const uint16_t *in, int32_t *bg, uint32_t *sads);
+
+    QMutex m_mutex;
+    bool m_enabled;
+    bool m_skipUnchanged;
+    int m_threshold;
+    int m_backgroundShift;
+    int m_maxHoldFrames;
+
+    int m_width, m_height;
+    int m_blocksX, m_blocksY;
+    bool m_resetPending;
+
+    // background in counts with 8 fractional bits, so slow updates don't stall
+    QVector<int32_t> m_background;
+    QVector<uint32_t> m_blockSads;
+    QVector<uint8_t> m_changedMask;
+
+    int m_changedBlocks;
+    QRect m_changedRegion;
+    int m_staticFrames;
+    int m_framesSinceChange;
+};
+
+#endif // MOTIONDETECTOR_H
@@ -0,0 +1,29 @@
+#ifndef PIPELINEBENCHMARK_H
+#define PIPELINEBENCHMARK_H
+
+#include <QStringList>
+
+#include "virtualuvcdevice.h"
+
+/* Streams from a VirtualUvcDevice through UvcAcquisition for a while and
+ * prints what arrives on the GUI thread, where UvcVideoProducer would hand
+ * it to the surface: throughput, latency from capture, and where frames
+ * went missing. No QML; the same seed gives the same stream. */
+class PipelineBenchmark
+{
+public:
+    PipelineBenchmark(int seconds, const VirtualUvcDevice::Config &config);
+
+    // processing to turn on besides AGC: dde, motion, focus, stats
+    void setStages(const QStringList &stages) { m_stages = stages; }
+
+    // 0 when any frame arrived
+    int run();
+
+private:
+    int m_seconds;
+    VirtualUvcDevice::Config m_config;
+    QStringList m_stages;
+};
+
+#endif // PIPELINEBENCHMARK_H
@@ -0,0 +1,92 @@
+#ifndef REMAPENGINE_H
+#define REMAPENGINE_H
+
+#include <QObject>
+#include <QMutex>
+#include <QRectF>
+#include <QSize>
+#include <QVector>
+#include <libuvc/libuvc.h>
+
+/* Geometric correction driven by a precomputed lookup map: lens undistortion
+ * (radial k1/k2), crop, rotation in 90 degree steps and flips are folded into
+ * one fixed-point source coordinate per output pixel. The map is rebuilt only
+ * when the configuration or the input size changes; applying it is a bilinear
+ * gather with 8-bit weights.
+ *
+ * Setters are called from QML, the apply functions from the UVC callback. */
+class RemapEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    RemapEngine();
+
+    Q_PROPERTY(bool enabled READ isEnabled WRITE setEnabled NOTIFY geometryChanged)
+    bool isEnabled() const;
+    void setEnabled(bool enabled);
+
+    // clockwise, one of 0, 90, 180, 270
+    Q_PROPERTY(int rotation READ getRotation WRITE setRotation NOTIFY geometryChanged)
+    int getRotation() const { return m_rotation; }
+    void setRotation(int rotation);
+
+    Q_PROPERTY(bool flipHorizontal READ getFlipHorizontal WRITE setFlipHorizontal NOTIFY geometryChanged)
+    bool getFlipHorizontal() const { return m_flipH; }
+    void setFlipHorizontal(bool flip);
+
+    Q_PROPERTY(bool flipVertical READ getFlipVertical WRITE setFlipVertical NOTIFY geometryChanged)
+    bool getFlipVertical() const { return m_flipV; }
+    void setFlipVertical(bool flip);
+
+    // radial distortion, r normalized to the half diagonal: r_d = r (1 + k1 r^2 + k2 r^4)
+    Q_PROPERTY(float k1 READ getK1 WRITE setK1 NOTIFY geometryChanged)
+    float getK1() const { return m_k1; }
+    void setK1(float k1);
+
+    Q_PROPERTY(float k2 READ getK2 WRITE setK2 NOTIFY geometryChanged)
+    float getK2() const { return m_k2; }
+    void setK2(float k2);
+
+    // crop in normalized sensor coordinates, applied before rotation
+    Q_PROPERTY(QRectF crop READ getCrop WRITE setCrop NOTIFY geometryChanged)
+    QRectF getCrop() const { return m_crop; }
+    void setCrop(const QRectF &crop);
+
+    QSize outputSize(const QSize &inputSize);
+
+    /* Fused remap + pseudo-color of an 8-bit gained frame (as left in the Y16
+     * buffer by DataFormatter::FixedGain) into BGRA output. Returns false
+     * without writing if outputSize no longer matches the configuration. */
+    bool remapPalette(const uvc_frame_t *input, const uint8_t *palette,
+                      uint8_t *output, const QSize &outputSize, int outputStride);
+
+    bool remapRgba(const uint8_t *input, const QSize &inputSize, int inputStride,
+                   uint8_t *output, const QSize &outputSize, int outputStride);
+
+signals:
+    void geometryChanged();
+
+private:
+    template <class T> void update(T *field, const T &value);
+    void ensureMap(const QSize &inputSize, int rowPitch);
+    void buildMap();
+
+    mutable QMutex m_mutex;
+    bool m_enabled;
+    int m_rotation;
+    bool m_flipH, m_flipV;
+    float m_k1, m_k2;
+    QRectF m_crop;
+
+    bool m_dirty;
+    QSize m_inputSize, m_outputSize;
+    int m_rowPitch;
+
+    // per output pixel: index of the top-left source pixel (-1 if outside)
+    // and the horizontal/vertical bilinear weights of the right/bottom pixels
+    QVector<int32_t> m_offset;
+    QVector<uint8_t> m_fx, m_fy;
+};
+
+#endif // REMAPENGINE_H
@@ -0,0 +1,36 @@
+#ifndef ROWBANDS_H
+#define ROWBANDS_H
+
+#include <QPair>
+#include <QThread>
+#include <QVector>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <functional>
+
+/* Splits [0, rows) into horizontal bands and runs fn(rowBegin, rowEnd) on each.
+ * With threaded == false (or when the image is too small to be worth the
+ * dispatch overhead) the bands are processed inline on the caller's thread. */
+inline void forEachRowBand(int rows, bool threaded, std::function<void(int, int)> fn, int minRowsPerBand = 32)
+{
+    int bands = threaded ? QThread::idealThreadCount() : 1;
+    if (bands > rows / minRowsPerBand)
+        bands = rows / minRowsPerBand;
+
+    if (bands <= 1)
+    {
+        fn(0, rows);
+        return;
+    }
+
+    QVector<QPair<int, int> > ranges;
+    ranges.reserve(bands);
+    for (int i = 0; i < bands; i++)
+        ranges.append(qMakePair(rows * i / bands, rows * (i + 1) / bands));
+
+    QtConcurrent::blockingMap(ranges, [&fn](const QPair<int, int> &range) {
+        fn(range.first, range.second);
+    });
+}
+
+#endif // ROWBANDS_H
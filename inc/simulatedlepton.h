@@ -0,0 +1,116 @@
+#ifndef SIMULATEDLEPTON_H
+#define SIMULATEDLEPTON_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QSize>
+
+#include <random>
+
+#include "LEPTON_Types.h"
+#include "LEPTON_ErrorCodes.h"
+#include "leptonport.h"
+
+// a device on the simulated accessory I2C bus
+class SimulatedI2CDevice
+{
+public:
+    virtual ~SimulatedI2CDevice() { }
+
+    // one write-then-read transaction, either part may be empty (-1 or 0
+    // lengths); false NACKs it
+    virtual bool transfer(const uint8_t *writeData, int writeLength, uint8_t *readData, int readLength) = 0;
+};
+
+/* SMBus read word with PEC. A clone sends PECs computed differently, which
+ * the driver has to put up with. */
+class SimulatedMlx90614 : public SimulatedI2CDevice
+{
+public:
+    explicit SimulatedMlx90614(uint8_t address, bool clone = false);
+
+    void setTemperatures(float objectKelvin, float ambientKelvin);
+
+    virtual bool transfer(const uint8_t *writeData, int writeLength, uint8_t *readData, int readLength);
+
+private:
+    uint8_t m_address;
+    bool m_clone;
+    float m_objectKelvin, m_ambientKelvin;
+};
+
+/* A radiometric Lepton 3.5 on a PureThermal board, in process. Every
+ * AGC/OEM/RAD/SYS/VID control is a register: written values read back, and
+ * registers nothing was written to read as zeros of whatever size is first
+ * asked for, unless a default below says otherwise. FFC, uptime and the
+ * scene statistics behave like the camera's. The custom XU runs I2C
+ * transactions on a bus with an MLX90614 at 0x5a.
+ *
+ * Each transfer takes latencyUs plus up to jitterUs, and fails with
+ * errorRate probability or when a failure was scheduled for its command;
+ * the random draws come from the seed, so runs repeat exactly. */
+class SimulatedLepton : public LeptonPort
+{
+public:
+    explicit SimulatedLepton(quint32 seed = 1);
+    virtual ~SimulatedLepton();
+
+    virtual Description describe();
+    virtual int getCtrl(uint8_t unit, uint8_t control, void *data, int length);
+    virtual int setCtrl(uint8_t unit, uint8_t control, void *data, int length);
+
+    // 160x120 unless set; resets the registers, so set it first
+    void setSensorSize(const QSize &size);
+    // whether describe() offers a telemetry frame; only the registers behind
+    // it are simulated, so leave it off when something renders the frames
+    void setTelemetrySupported(bool supported);
+    void setLatency(int latencyUs, int jitterUs);
+    void setErrorRate(double rate);
+    // the next count transfers of this command fail; the type bits are ignored
+    void failCommand(LEP_COMMAND_ID commandID, int count);
+
+    // the register behind a command, laid out as the SDK reads it
+    void setRegister(LEP_COMMAND_ID commandID, const void *data, int length);
+    QByteArray getRegister(LEP_COMMAND_ID commandID);
+
+    // takes ownership
+    void addI2CDevice(uint8_t address, SimulatedI2CDevice *device);
+
+    quint64 transfers() const { return m_transfers; }
+    quint64 injectedErrors() const { return m_injectedErrors; }
+
+private:
+    static quint32 registerKey(uint8_t unit, uint8_t control) { return (unit << 8) | control; }
+    static quint32 commandKey(LEP_COMMAND_ID commandID);
+
+    void resetRegisters();
+    void run(quint32 key);
+    // getCtrl and setCtrl with m_mutex held
+    int getLocked(uint8_t unit, uint8_t control, void *data, int length, int *us);
+    int setLocked(uint8_t unit, uint8_t control, const void *data, int length, int *us);
+    bool transferFails(quint32 key, int *us);
+    void refreshDynamic(quint32 key);
+    int customGet(uint8_t control, void *data, int length);
+    int customSet(uint8_t control, const void *data, int length);
+
+    QMutex m_mutex;
+    std::mt19937 m_random;
+    QElapsedTimer m_clock;
+    QSize m_sensorSize;
+    bool m_telemetry;
+
+    QHash<quint32, QByteArray> m_registers;
+    qint64 m_ffcUntil;
+
+    int m_latencyUs, m_jitterUs;
+    double m_errorRate;
+    QHash<quint32, int> m_scheduledFailures;
+    quint64 m_transfers, m_injectedErrors;
+
+    QHash<uint8_t, SimulatedI2CDevice*> m_i2cDevices;
+    QByteArray m_i2cRequest;
+};
+
+#endif // SIMULATEDLEPTON_H
@@ -0,0 +1,67 @@
+#ifndef SYNTHETICSCENE_H
+#define SYNTHETICSCENE_H
+
+#include <QSize>
+#include <QVector>
+#include <stdint.h>
+
+/* Raw 14-bit frames that look enough like a Lepton's for AGC, detail
+ * enhancement, motion detection and the statistics to do real work: a
+ * background with vertical and horizontal gradients that wanders slowly,
+ * hot blobs moving across it, temporal noise, per-pixel and per-column
+ * fixed-pattern offsets that drift until the next FFC, the flat shutter
+ * image during FFC, and dead, hot and stuck pixels.
+ *
+ * A frame is a function of the seed and its index only, so any frame can
+ * be rendered again, in any order, and skipped indices behave like frames
+ * the camera sent that never arrived. */
+class SyntheticScene
+{
+public:
+    SyntheticScene(const QSize &size, quint32 seed);
+
+    QSize size() const { return m_size; }
+
+    // moving hot blobs, 3 by default
+    void setBlobCount(int count);
+    // frames between FFCs, 0 for none; the shutter shows for ffcFrames frames
+    void setFfcInterval(int frames, int ffcFrames = 2);
+    // temporal noise standard deviation, in counts
+    void setNoise(float sigma) { m_noiseSigma = sigma; }
+
+    bool isFfcFrame(quint32 index) const;
+
+    // stride in pixels
+    void render(quint32 index, uint16_t *data, int stride) const;
+
+private:
+    struct Blob {
+        float x, y;
+        float vx, vy;
+        float radius;
+        float amplitude;
+    };
+
+    struct BadPixel {
+        int offset;
+        uint16_t value;
+    };
+
+    int framesSinceFfc(quint32 index) const;
+    void renderScene(quint32 index, uint32_t state, int noiseScale, uint16_t *data, int stride) const;
+
+    QSize m_size;
+    quint32 m_seed;
+
+    // background plus what FFC leaves of the fixed pattern
+    QVector<uint16_t> m_static;
+    // fixed-pattern offset built up over a whole FFC interval
+    QVector<int16_t> m_drift;
+    QVector<BadPixel> m_badPixels;
+    QVector<Blob> m_blobs;
+
+    int m_ffcInterval, m_ffcFrames;
+    float m_noiseSigma;
+};
+
+#endif // SYNTHETICSCENE_H
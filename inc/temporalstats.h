@@ -0,0 +1,93 @@
+#ifndef TEMPORALSTATS_H
+#define TEMPORALSTATS_H
+
+#include <QObject>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <QVector>
+#include <libuvc/libuvc.h>
+
+/* Per-pixel running mean/variance (Welford) over raw Y16 frames, used to
+ * measure temporal noise (NETD), row/column noise and drift of a camera.
+ *
+ * State is kept as separate float planes (mean, M2) so the update loop
+ * streams through memory linearly and vectorizes. update() is called from
+ * the UVC callback thread; everything else may be called from QML. */
+class TemporalStats : public QObject
+{
+    Q_OBJECT
+
+public:
+    TemporalStats();
+
+    void update(const uvc_frame_t *frame);
+
+    Q_INVOKABLE void start(int frames = 0, const QString &exportPath = QString());
+    Q_INVOKABLE void stop();
+    Q_INVOKABLE void reset();
+    Q_INVOKABLE bool exportMaps(const QString &path);
+
+    Q_PROPERTY(bool running READ isRunning NOTIFY runningChanged)
+    bool isRunning() const { return m_running; }
+
+    Q_PROPERTY(bool multithreaded MEMBER m_multithreaded NOTIFY multithreadedChanged)
+
+    // scale of one Y16 count, e.g. 0.01 for TLinear high resolution; 0 when
+    // the counts aren't radiometric (the default), which leaves the kelvin
+    // values at 0
+    Q_PROPERTY(float kelvinPerCount MEMBER m_kelvinPerCount NOTIFY kelvinPerCountChanged)
+
+    Q_PROPERTY(int frameCount READ getFrameCount NOTIFY statsChanged)
+    int getFrameCount() const { return m_count; }
+
+    // mean per-pixel temporal standard deviation, in counts
+    Q_PROPERTY(float temporalNoise READ getTemporalNoise NOTIFY statsChanged)
+    float getTemporalNoise() const { return m_temporalNoise; }
+
+    // the values below are in kelvin (drift in kelvin per minute)
+    Q_PROPERTY(float netd READ getNetd NOTIFY statsChanged)
+    float getNetd() const { return m_temporalNoise * m_kelvinPerCount; }
+
+    Q_PROPERTY(float rowNoise READ getRowNoise NOTIFY statsChanged)
+    float getRowNoise() const { return m_rowNoise; }
+
+    Q_PROPERTY(float columnNoise READ getColumnNoise NOTIFY statsChanged)
+    float getColumnNoise() const { return m_columnNoise; }
+
+    Q_PROPERTY(float driftRate READ getDriftRate NOTIFY statsChanged)
+    float getDriftRate() const { return m_driftRate; }
+
+signals:
+    void runningChanged(bool running);
+    void multithreadedChanged(bool multithreaded);
+    void kelvinPerCountChanged(float kelvinPerCount);
+    void statsChanged();
+    void finished(const QString &exportPath);
+
+private:
+    void resize(int width, int height);
+    void accumulateRows(const uvc_frame_t *frame, int rowBegin, int rowEnd);
+    void accumulateProfiles(const uvc_frame_t *frame);
+    void summarize();
+
+    QMutex m_mutex;
+    bool m_running;
+    bool m_multithreaded;
+    float m_kelvinPerCount;
+    int m_targetFrames;
+    QString m_exportPath;
+
+    int m_width, m_height;
+    int m_count;
+    QVector<float> m_mean, m_m2;
+    QVector<float> m_rowMean, m_rowM2;
+    QVector<float> m_colMean, m_colM2;
+    QVector<double> m_rowSum, m_colSum;
+
+    QElapsedTimer m_clock;
+    double m_sumT, m_sumTT, m_sumY, m_sumTY;
+
+    float m_temporalNoise, m_rowNoise, m_columnNoise, m_driftRate;
+};
+
+#endif // TEMPORALSTATS_H
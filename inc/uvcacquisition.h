@@ -1,8 +1,13 @@
 #ifndef UVCACQUISITION_H
 #define UVCACQUISITION_H
 
+#include <QAtomicInt>
+#include <QElapsedTimer>
 #include <QList>
 #include <QObject>
+#include <QMutex>
+#include <QTimer>
+#include <QVector>
 #include <QVideoFrame>
 #include <QVideoSurfaceFormat>
 
@@ -10,7 +15,15 @@
 #include <unistd.h>
 
 #include "abstractccinterface.h"
+#include "frametelemetry.h"
 #include "dataformatter.h"
+#include "temporalstats.h"
+#include "focusmetric.h"
+#include "remapengine.h"
+#include "motiondetector.h"
+#include "duplicatedetector.h"
+#include "camerastats.h"
+#include "virtualuvcdevice.h"
 
 class UvcAcquisition : public QObject
 {
@@ -26,6 +39,56 @@ public:
     UvcAcquisition(QList<UsbId> ids);
     virtual ~UvcAcquisition();
 
+    // acquisitions created after this stream from a VirtualUvcDevice with
+    // a SimulatedLepton for controls, instead of looking for a camera
+    static void useVirtualDevice(const VirtualUvcDevice::Config &config);
+
+    // NULL unless streaming from a virtual device
+    VirtualUvcDevice* virtualDevice() const { return m_virtual; }
+
+    // what to do with frames captured while the shutter is closed for FFC
+    enum FfcGating {
+        FfcPassThrough,
+        FfcSkip,
+        FfcHold,
+    };
+    Q_ENUMS(FfcGating)
+    Q_PROPERTY(FfcGating ffcGating READ getFfcGating WRITE setFfcGating NOTIFY ffcGatingChanged)
+    FfcGating getFfcGating() const { return m_ffcGating; }
+    void setFfcGating(FfcGating gating);
+
+    /* Where a Y16 stream gets its pseudo-color: on the host, or on the
+     * camera, streaming RGB with the DataFormatter palette uploaded as its
+     * user LUT. Auto colorizes on the camera while the host's cost is over
+     * colorizeBudgetMs and nothing needs the raw counts. Only applies to
+     * cameras that stream Y16 by default. */
+    enum Colorization {
+        ColorizeAuto,
+        ColorizeOnHost,
+        ColorizeOnCamera,
+    };
+    Q_ENUMS(Colorization)
+    Q_PROPERTY(Colorization colorization READ getColorization WRITE setColorization NOTIFY colorizationChanged)
+    Colorization getColorization() const { return m_colorization; }
+    void setColorization(Colorization colorization);
+
+    Q_PROPERTY(bool cameraColorizing READ getCameraColorizing NOTIFY colorizationChanged)
+    bool getCameraColorizing() const { return m_cameraColorizing; }
+
+    // something outside the pipeline, e.g. a radiometric display, uses the
+    // raw counts through the DataFormatter
+    Q_PROPERTY(bool rawFramesWanted READ getRawFramesWanted WRITE setRawFramesWanted NOTIFY colorizationChanged)
+    bool getRawFramesWanted() const { return m_rawFramesWanted; }
+    void setRawFramesWanted(bool wanted);
+
+    // smoothed host time for AGC and pseudo-color per frame, last measured
+    Q_PROPERTY(float hostColorizeMs READ getHostColorizeMs NOTIFY colorizeCostChanged)
+    float getHostColorizeMs() const { return m_hostColorizeUs.load() / 1000.0f; }
+
+    Q_PROPERTY(float colorizeBudgetMs READ getColorizeBudgetMs WRITE setColorizeBudgetMs NOTIFY colorizationChanged)
+    float getColorizeBudgetMs() const { return m_colorizeBudgetMs; }
+    void setColorizeBudgetMs(float ms);
+
     Q_PROPERTY(const QVideoSurfaceFormat& videoFormat READ videoFormat WRITE setVideoFormat NOTIFY formatChanged)
     const QVideoSurfaceFormat& videoFormat() const { return m_format; }
 
@@ -34,6 +97,36 @@ public:
     Q_PROPERTY(DataFormatter* dataFormatter READ getDataFormatter() NOTIFY dataFormatterChanged)
     DataFormatter* getDataFormatter() { return &m_df; }
 
+    Q_PROPERTY(TemporalStats* temporalStats READ getTemporalStats CONSTANT)
+    TemporalStats* getTemporalStats() { return &m_stats; }
+
+    Q_PROPERTY(FocusMetric* focusMetric READ getFocusMetric CONSTANT)
+    FocusMetric* getFocusMetric() { return &m_focus; }
+
+    Q_PROPERTY(MotionDetector* motion READ getMotion CONSTANT)
+    MotionDetector* getMotion() { return &m_motion; }
+
+    Q_PROPERTY(DuplicateDetector* duplicates READ getDuplicates CONSTANT)
+    DuplicateDetector* getDuplicates() { return &m_duplicates; }
+
+    Q_PROPERTY(RemapEngine* remap READ getRemap CONSTANT)
+    RemapEngine* getRemap() { return &m_remap; }
+
+    Q_PROPERTY(CameraStats* cameraStats READ getCameraStats CONSTANT)
+    CameraStats* getCameraStats() { return &m_cameraStats; }
+
+    // latest in-band telemetry, if the camera has it enabled
+    FrameTelemetry getTelemetry();
+
+    Q_PROPERTY(bool telemetryValid READ getTelemetryValid NOTIFY telemetryUpdated)
+    bool getTelemetryValid() { return getTelemetry().valid; }
+
+    Q_PROPERTY(unsigned int telemetryFrameCounter READ getTelemetryFrameCounter NOTIFY telemetryUpdated)
+    unsigned int getTelemetryFrameCounter() { return getTelemetry().frameCounter; }
+
+    Q_PROPERTY(float fpaTemperature READ getFpaTemperature NOTIFY telemetryUpdated)
+    float getFpaTemperature() { return getTelemetry().fpaTempKelvin; }
+
     Q_PROPERTY(const QSize& videoSize READ getVideoSize NOTIFY videoSizeChanged)
     const QSize getVideoSize() { return m_format.frameSize(); }
 
@@ -43,6 +136,10 @@ signals:
     void cciChanged(AbstractCCInterface *format);
     void dataFormatterChanged(AbstractCCInterface *format);
     void videoSizeChanged(const QSize &size);
+    void telemetryUpdated();
+    void ffcGatingChanged(FfcGating gating);
+    void colorizationChanged();
+    void colorizeCostChanged();
 
 public slots:
     void setVideoFormat(const QVideoSurfaceFormat &format);
@@ -55,16 +152,64 @@ protected:
     uvc_device_t *dev;
     uvc_device_handle_t *devh;
     uvc_stream_ctrl_t ctrl;
+    // written on the GUI thread, also while streaming when the remap changes;
+    // the callback takes a copy under m_formatMutex
     QVideoSurfaceFormat m_format;
+    QMutex m_formatMutex;
     QVideoSurfaceFormat m_uvc_format;
     AbstractCCInterface *m_cci;
     DataFormatter m_df;
+    TemporalStats m_stats;
+    FocusMetric m_focus;
+    RemapEngine m_remap;
+    MotionDetector m_motion;
+    DuplicateDetector m_duplicates;
+    CameraStats m_cameraStats;
+
+private slots:
+    void updateOutputFormat();
+    void onTelemetryChanged();
+    void updateFfcMonitoring();
+    void updateColorization();
+    void uploadPalette();
 
 private:
     static void cb(uvc_frame_t *frame, void *ptr);
+    uvc_error_t startStreaming();
+    void stopStreaming();
     void emitFrameReady(const QVideoFrame &frame);
     void init();
     QList<UsbId> _ids;
+    QVector<uint8_t> m_rgbaScratch;
+
+    static VirtualUvcDevice::Config *s_virtualConfig;
+    VirtualUvcDevice *m_virtual;
+
+    // telemetry rows in each frame from the camera; only changed while stopped
+    int m_telemetryRows;
+    bool m_telemetryAtTop;
+    QMutex m_telemetryMutex;
+    FrameTelemetry m_telemetry;
+
+    FfcGating m_ffcGating;
+    // last converted frame, re-sent while FFC frames are held back
+    QVideoFrame m_lastFrame;
+
+    // time to first frame, logged by the first callback
+    QElapsedTimer m_startupTimer;
+    QAtomicInt m_awaitingFirstFrame;
+
+    bool needsRawFrames();
+    QByteArray paletteRgb();
+    Colorization m_colorization;
+    bool m_cameraColorizing;
+    bool m_rawFramesWanted;
+    // bumped on every switch, so a late palette upload can't undo a newer one
+    quint32 m_colorizeSwitches;
+    float m_colorizeBudgetMs;
+    // written by the frame callback
+    QAtomicInt m_hostColorizeUs;
+    QTimer *m_colorizeTimer;
 };
 
 #endif // UVCACQUISITION_H
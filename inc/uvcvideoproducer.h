@@ -24,6 +24,7 @@ signals:
 
 public slots:
     void onNewVideoContentReceived(const QVideoFrame &frame);
+    void onFormatChanged(const QVideoSurfaceFormat &format);
 
 private:
     QAbstractVideoSurface *m_surface;
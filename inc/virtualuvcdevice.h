@@ -0,0 +1,82 @@
+#ifndef VIRTUALUVCDEVICE_H
+#define VIRTUALUVCDEVICE_H
+
+#include <QAtomicInt>
+#include <QSize>
+#include <QThread>
+#include <QVector>
+#include <QVideoFrame>
+
+#include <libuvc/libuvc.h>
+#include <random>
+
+#include "syntheticscene.h"
+
+/* Stands in for a camera's video stream where UvcAcquisition would call
+ * libuvc: frames are synthesized on a thread of its own and handed to the
+ * frame callback like libuvc's stream thread does. Streams Y16, RGB24 or
+ * I420 at whatever size it's asked for, showing a SyntheticScene; the
+ * 8-bit formats get its counts through a fixed linear map.
+ *
+ * Frames can arrive up to jitterUs late, be dropped with dropRate
+ * probability, or stall the stream for stallMs with stallRate probability;
+ * frames due during a stall are lost, like on a camera whose USB stopped
+ * being serviced. The random draws come from the seed. */
+class VirtualUvcDevice
+{
+public:
+    struct Config {
+        Config();
+        QSize size;
+        // what UvcAcquisition asks for at startup: Y16, RGB24 or YUV420P
+        QVideoFrame::PixelFormat format;
+        float fps;
+        int jitterUs;
+        double dropRate;
+        double stallRate;
+        int stallMs;
+        int sceneBlobs;
+        // frames between FFCs in the scene, 0 for none
+        int ffcInterval;
+        quint32 seed;
+    };
+
+    explicit VirtualUvcDevice(const Config &config);
+    ~VirtualUvcDevice();
+
+    // NULL until a stream was negotiated
+    const SyntheticScene* scene() const { return m_scene; }
+
+    const Config& config() const { return m_config; }
+
+    // the libuvc calls UvcAcquisition makes, for the virtual stream
+    uvc_error_t getStreamCtrl(uvc_stream_ctrl_t *ctrl, uvc_frame_format format, int width, int height);
+    uvc_error_t startStreaming(uvc_stream_ctrl_t *ctrl, uvc_frame_callback_t *cb, void *user);
+    void stopStreaming();
+
+    quint64 generated() const { return m_generated.load(); }
+    quint64 delivered() const { return m_delivered.load(); }
+    quint64 dropped() const { return m_dropped.load(); }
+    quint64 stalled() const { return m_stalled.load(); }
+
+private:
+    void run();
+    void fill(uvc_frame_t *frame, quint32 sequence);
+
+    Config m_config;
+    std::mt19937 m_random;
+
+    uvc_frame_format m_format;
+    QSize m_frameSize;
+    SyntheticScene *m_scene;
+    QVector<uint16_t> m_counts;
+    uvc_frame_callback_t *m_cb;
+    void *m_user;
+    QThread *m_thread;
+    QAtomicInt m_running;
+    QVector<uint8_t> m_buffer;
+
+    QAtomicInteger<quint64> m_generated, m_delivered, m_dropped, m_stalled;
+};
+
+#endif // VIRTUALUVCDEVICE_H
@@ -4,4 +4,86 @@ import GetThermal 1.0
 
 ViewerForm {
 
+    property bool configRunning: false
+
+    function runConfigOptions() {
+        if (!acq.cci || configRunning || (applyConfigPath === "" && exportConfigPath === "")) {
+            return
+        }
+        configRunning = true
+        if (applyConfigPath !== "") {
+            // applied on the control thread; configApplied finishes up
+            if (!acq.cci.applyConfigFile(applyConfigPath)) {
+                Qt.exit(1)
+            }
+            return
+        }
+        finishConfigOptions(true)
+    }
+
+    function finishConfigOptions(ok) {
+        if (ok && exportConfigPath !== "") {
+            ok = acq.cci.exportConfigFile(exportConfigPath)
+        }
+        Qt.exit(ok ? 0 : 1)
+    }
+
+    Component.onCompleted: {
+        if (statsFrames > 0) {
+            acq.temporalStats.start(statsFrames, statsOutput)
+        }
+        runConfigOptions()
+    }
+
+    Connections {
+        target: acq
+        onCciChanged: runConfigOptions()
+    }
+
+    Connections {
+        target: acq.cci
+        onConfigApplied: {
+            if (configRunning) {
+                finishConfigOptions(ok)
+            }
+        }
+    }
+
+    // no camera turned up to configure
+    Timer {
+        interval: 10000
+        running: applyConfigPath !== "" || exportConfigPath !== ""
+        onTriggered: {
+            if (!configRunning) {
+                console.error("No camera to configure")
+                Qt.exit(1)
+            }
+        }
+    }
+
+    // the range readout works on the raw counts; the spot temperature comes
+    // from the camera and doesn't need them
+    Binding {
+        target: acq
+        property: "rawFramesWanted"
+        value: acq.cci !== null && acq.cci.supportsRadiometry && rangeShown
+    }
+
+    Connections {
+        target: acq.temporalStats
+        onFinished: {
+            if (statsFrames > 0) {
+                Qt.quit()
+            }
+        }
+    }
+
+    Connections {
+        target: Qt.application
+        onAboutToQuit: {
+            if (commandStatsOutput !== "" && acq.cci) {
+                acq.cci.commandStats.exportCsv(commandStatsOutput)
+            }
+        }
+    }
 }
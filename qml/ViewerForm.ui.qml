@@ -13,6 +13,7 @@ Item {
     property alias acq: acq
     property alias player: player
     property alias videoOutput: videoOutput
+    property alias rangeShown: switchRange.checked
     width: 640
 
     UvcAcquisition {
@@ -87,12 +88,21 @@ Item {
                 visible: acq.cci.irThermometerAvailable
             }
 
+            Switch {
+                id: switchRange
+                anchors.top: acq.cci.irThermometerAvailable ? irThermometerInfo.bottom : spotInfo.bottom
+                anchors.left: parent.left
+                text: qsTr("Range")
+                checked: false
+            }
+
             RangeDisplay {
                 id: rangeDisplay
-                anchors.top: acq.cci.irThermometerAvailable ? irThermometerInfo.bottom : spotInfo.bottom
+                anchors.top: switchRange.bottom
                 anchors.left: parent.left
                 anchors.right: parent.right
                 anchors.bottom: parent.bottom
+                visible: switchRange.checked
                 acq: acq
             }
         }
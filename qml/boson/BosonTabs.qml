@@ -2,6 +2,7 @@ import QtQuick 2.0
 import QtQuick.Controls 2.0
 import GetThermal 1.0
 import "qrc:/boson"
+import "qrc:/controls"
 
 Page {
     id: root
@@ -23,6 +24,10 @@ Page {
         TabButton {
             text: qsTr("Info")
         }
+
+        TabButton {
+            text: qsTr("QA")
+        }
     }
 
     SwipeView {
@@ -47,6 +52,14 @@ Page {
             anchors.top: parent.top
             acq: root.acq
         }
+
+        StatsControls {
+            id: statsControls1
+            anchors.bottom: parent.bottom
+            anchors.left: infoControls1.right
+            anchors.top: parent.top
+            acq: root.acq
+        }
     }
 
 }
@@ -43,7 +43,25 @@ Item {
             Label {
                 text: qsTr("Software: ") + acq.cci.softwareRev
             }
+
+            Label {
+                text: qsTr("FPA: ") + acq.cci.cameraInternalTempC.toFixed(1) + " °C"
+            }
+
+            Switch {
+                id: switchTelemetry
+                text: qsTr("Telemetry")
+                visible: acq.cci.supportsTelemetry
+                checked: acq.cci.telemetryEnabled
+            }
         }
     }
 
+    Binding {
+        target: acq.cci
+        property: "telemetryEnabled"
+        value: switchTelemetry.checked
+        when: acq.cci.supportsTelemetry
+    }
+
 }
@@ -1,6 +1,7 @@
 import QtQuick 2.0
 import QtQuick.Controls 2.0
 import GetThermal 1.0
+import "qrc:/controls"
 
 Item {
     id: root
@@ -22,7 +23,8 @@ Item {
         ComboBox {
             id: comboColorLutId
             width: parent.width
-            visible: acq.cci.supportsHwPseudoColor
+            // the camera only colorizes its 8-bit stream, not the Y16 one carrying telemetry
+            visible: acq.cci.supportsHwPseudoColor && !acq.cci.telemetryEnabled
 
             model: ListModel {
                 ListElement { text: "White Hot"; data: FLR_COLORLUT_ID_E.FLR_COLORLUT_WHITEHOT }
@@ -44,7 +46,7 @@ Item {
         ComboBox {
             id: comboSwPcolorLut
             width: parent.width
-            visible: !acq.cci.supportsHwPseudoColor
+            visible: !acq.cci.supportsHwPseudoColor || acq.cci.telemetryEnabled
 
             model: ListModel {
                 ListElement { text: "Iron Black"; data: DataFormatter.IronBlack }
@@ -56,6 +58,13 @@ Item {
             currentIndex: acq.dataFormatter.pseudocolorPalette
         }
 
+        // host-side, so only while the host maps the Y16 stream
+        DetailControls {
+            width: parent.width
+            visible: comboSwPcolorLut.visible
+            acq: root.acq
+        }
+
         Button {
             id: buttonFfc
             text: qsTr("Perform FFC")
@@ -0,0 +1,48 @@
+import QtQuick 2.0
+import QtQuick.Controls 2.0
+import GetThermal 1.0
+
+Column {
+    id: root
+    spacing: 5
+
+    property UvcAcquisition acq: null
+    property DataFormatter formatter: acq ? acq.dataFormatter : null
+
+    Switch {
+        id: switchDde
+        text: qsTr("Detail enhancement")
+        width: parent.width
+        checked: formatter.detailEnhancement
+    }
+
+    ValueSlider {
+        width: parent.width
+        visible: switchDde.checked
+        description: qsTr("Detail gain")
+        minimumValue: 1
+        maximumValue: 8
+        stepSize: 0.5
+        model: formatter
+        binding: "detailGain"
+    }
+
+    // the base layer's box filter reaches this far; detail finer than it is
+    // what gets amplified
+    ValueSlider {
+        width: parent.width
+        visible: switchDde.checked
+        description: qsTr("Detail radius")
+        minimumValue: 1
+        maximumValue: 7
+        stepSize: 1
+        model: formatter
+        binding: "detailRadius"
+    }
+
+    Binding {
+        target: formatter
+        property: "detailEnhancement"
+        value: switchDde.checked
+    }
+}
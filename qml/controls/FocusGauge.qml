@@ -0,0 +1,76 @@
+import QtQuick 2.0
+import QtQuick.Controls 2.0
+import GetThermal 1.0
+
+GroupBox {
+    id: root
+    title: qsTr("Focus")
+
+    property UvcAcquisition acq: null
+    property FocusMetric focus: acq ? acq.focusMetric : null
+
+    Column {
+        spacing: 5
+        width: parent.width
+
+        Switch {
+            id: switchFocus
+            text: qsTr("Focus assist")
+            checked: focus.enabled
+        }
+
+        ComboBox {
+            id: comboFocusMethod
+            width: parent.width
+            visible: switchFocus.checked
+
+            model: ListModel {
+                ListElement { text: "Laplacian"; data: FocusMetric.LaplacianVariance }
+                ListElement { text: "Tenengrad"; data: FocusMetric.Tenengrad }
+            }
+            textRole: qsTr("text")
+
+            currentIndex: focus.method
+        }
+
+        Switch {
+            id: switchSpotRoi
+            text: qsTr("Spot ROI only")
+            visible: switchFocus.checked && acq.cci.supportsRadiometry
+        }
+
+        // relative to the best score seen since the last reset
+        ProgressBar {
+            id: barFocus
+            width: parent.width
+            visible: switchFocus.checked
+            from: 0
+            to: 1
+            value: focus.peakScore > 0 ? focus.score / focus.peakScore : 0
+        }
+
+        Button {
+            text: qsTr("Reset Peak")
+            visible: switchFocus.checked
+            onClicked: focus.resetPeak()
+        }
+    }
+
+    Binding {
+        target: focus
+        property: "enabled"
+        value: switchFocus.checked
+    }
+
+    Binding {
+        target: focus
+        property: "method"
+        value: comboFocusMethod.model.get(comboFocusMethod.currentIndex).data
+    }
+
+    Binding {
+        target: focus
+        property: "roi"
+        value: switchSpotRoi.checked ? acq.cci.radSpotmeterRoi : Qt.rect(0, 0, 0, 0)
+    }
+}
@@ -0,0 +1,61 @@
+import QtQuick 2.0
+import QtQuick.Controls 2.0
+import GetThermal 1.0
+
+GroupBox {
+    id: root
+    title: qsTr("Motion")
+
+    property UvcAcquisition acq: null
+    property MotionDetector motion: acq ? acq.motion : null
+
+    Column {
+        spacing: 5
+        width: parent.width
+
+        Switch {
+            id: switchMotion
+            text: qsTr("Detect changes")
+            checked: motion.enabled
+        }
+
+        Switch {
+            id: switchSkip
+            text: qsTr("Skip static frames")
+            visible: switchMotion.checked
+            checked: motion.skipUnchanged
+        }
+
+        ValueSlider {
+            width: parent.width
+            visible: switchMotion.checked
+            description: qsTr("Threshold (counts)")
+            minimumValue: 1
+            maximumValue: 200
+            model: motion
+            binding: "threshold"
+        }
+
+        Label {
+            visible: switchMotion.checked
+            text: qsTr("Changed blocks: ") + motion.changedBlocks + " / " + motion.totalBlocks
+        }
+
+        Label {
+            visible: switchMotion.checked
+            text: qsTr("Static frames: ") + motion.staticFrames
+        }
+    }
+
+    Binding {
+        target: motion
+        property: "enabled"
+        value: switchMotion.checked
+    }
+
+    Binding {
+        target: motion
+        property: "skipUnchanged"
+        value: switchSkip.checked
+    }
+}
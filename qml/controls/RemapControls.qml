@@ -0,0 +1,87 @@
+import QtQuick 2.0
+import QtQuick.Controls 2.0
+import GetThermal 1.0
+
+GroupBox {
+    id: root
+    title: qsTr("Orientation")
+
+    property UvcAcquisition acq: null
+    property RemapEngine remap: acq ? acq.remap : null
+
+    Column {
+        spacing: 5
+        width: parent.width
+
+        Switch {
+            id: switchRemap
+            text: qsTr("Correct image")
+            checked: remap.enabled
+        }
+
+        ComboBox {
+            id: comboRotation
+            width: parent.width
+            visible: switchRemap.checked
+
+            model: ListModel {
+                ListElement { text: "No rotation"; data: 0 }
+                ListElement { text: "90° CW"; data: 90 }
+                ListElement { text: "180°"; data: 180 }
+                ListElement { text: "90° CCW"; data: 270 }
+            }
+            textRole: qsTr("text")
+
+            currentIndex: remap.rotation / 90
+        }
+
+        Switch {
+            id: switchFlipH
+            text: qsTr("Mirror")
+            visible: switchRemap.checked
+            checked: remap.flipHorizontal
+        }
+
+        Switch {
+            id: switchFlipV
+            text: qsTr("Flip")
+            visible: switchRemap.checked
+            checked: remap.flipVertical
+        }
+
+        ValueSlider {
+            width: parent.width
+            visible: switchRemap.checked
+            description: qsTr("Lens k1")
+            minimumValue: -0.5
+            maximumValue: 0.5
+            stepSize: 0.01
+            model: remap
+            binding: "k1"
+        }
+    }
+
+    Binding {
+        target: remap
+        property: "enabled"
+        value: switchRemap.checked
+    }
+
+    Binding {
+        target: remap
+        property: "rotation"
+        value: comboRotation.model.get(comboRotation.currentIndex).data
+    }
+
+    Binding {
+        target: remap
+        property: "flipHorizontal"
+        value: switchFlipH.checked
+    }
+
+    Binding {
+        target: remap
+        property: "flipVertical"
+        value: switchFlipV.checked
+    }
+}
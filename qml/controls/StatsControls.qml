@@ -0,0 +1,272 @@
+import QtQuick 2.0
+import QtQuick.Controls 2.0
+import GetThermal 1.0
+
+Item {
+    id: root
+    width: 200
+    property UvcAcquisition acq: null
+    property TemporalStats stats: acq ? acq.temporalStats : null
+    property bool calibrated: stats.kelvinPerCount > 0
+    anchors.margins: 5
+
+    Flow {
+        id: flow1
+        spacing: 5
+        anchors.fill: parent
+        anchors.margins: 5
+
+        GroupBox {
+            id: groupStats
+            width: parent.width
+            title: qsTr("Noise && Drift")
+
+            Column {
+                spacing: 5
+                width: parent.width
+
+                Label {
+                    text: qsTr("Frames: ") + stats.frameCount
+                }
+
+                Label {
+                    text: calibrated ? qsTr("NETD: ") + (stats.netd * 1000).toFixed(1) + " mK"
+                                     : qsTr("Noise: ") + stats.temporalNoise.toFixed(2) + qsTr(" counts")
+                }
+
+                Label {
+                    visible: calibrated
+                    text: qsTr("Row noise: ") + (stats.rowNoise * 1000).toFixed(1) + " mK"
+                }
+
+                Label {
+                    visible: calibrated
+                    text: qsTr("Column noise: ") + (stats.columnNoise * 1000).toFixed(1) + " mK"
+                }
+
+                Label {
+                    visible: calibrated
+                    text: qsTr("Drift: ") + stats.driftRate.toFixed(3) + " K/min"
+                }
+
+                Button {
+                    id: buttonStats
+                    text: stats.running ? qsTr("Stop") : qsTr("Start")
+                    onClicked: {
+                        if (stats.running) {
+                            stats.stop()
+                        } else {
+                            stats.start()
+                        }
+                    }
+                }
+            }
+        }
+
+        FocusGauge {
+            width: parent.width
+            acq: root.acq
+        }
+
+        MotionControls {
+            width: parent.width
+            acq: root.acq
+        }
+
+        GroupBox {
+            id: groupDuplicates
+            width: parent.width
+            title: qsTr("Frame Rate")
+
+            Column {
+                spacing: 5
+                width: parent.width
+
+                Label {
+                    text: qsTr("Unique: ") + acq.duplicates.uniqueRate.toFixed(1) + " fps"
+                }
+
+                Label {
+                    text: qsTr("Repeated: ") + acq.duplicates.duplicateRate.toFixed(1) + " fps"
+                }
+
+                Switch {
+                    id: switchSkipDuplicates
+                    text: qsTr("Drop repeats")
+                    checked: acq.duplicates.skipDuplicates
+                }
+
+                Label {
+                    text: qsTr("During FFC:")
+                }
+
+                ComboBox {
+                    id: comboFfcGating
+                    width: parent.width
+
+                    model: ListModel {
+                        ListElement { text: "Hold last frame"; data: UvcAcquisition.FfcHold }
+                        ListElement { text: "Skip frames"; data: UvcAcquisition.FfcSkip }
+                        ListElement { text: "Show frames"; data: UvcAcquisition.FfcPassThrough }
+                    }
+                    textRole: qsTr("text")
+
+                    currentIndex: acq.ffcGating == UvcAcquisition.FfcHold ? 0
+                                : acq.ffcGating == UvcAcquisition.FfcSkip ? 1 : 2
+                }
+            }
+        }
+
+        GroupBox {
+            id: groupCameraStats
+            width: parent.width
+            title: qsTr("Camera Statistics")
+            visible: acq.cci !== null
+
+            Column {
+                spacing: 5
+                width: parent.width
+
+                Switch {
+                    id: switchCameraStats
+                    text: qsTr("Range from camera")
+                    checked: acq.cameraStats.enabled
+                }
+
+                ValueSlider {
+                    description: qsTr("Interval (ms)")
+                    width: parent.width
+                    minimumValue: 50
+                    maximumValue: 1000
+                    stepSize: 50
+                    model: acq.cameraStats
+                    binding: "interval"
+                }
+
+                Label {
+                    visible: acq.cameraStats.enabled
+                    text: acq.cameraStats.trusted
+                          ? qsTr("Camera: ") + acq.cameraStats.cameraRate.toFixed(1)
+                            + qsTr(" fps, host: ") + acq.cameraStats.hostRate.toFixed(1) + " fps"
+                          : qsTr("Doesn't match the frames, host only")
+                }
+            }
+        }
+
+        GroupBox {
+            id: groupControl
+            width: parent.width
+            title: qsTr("Control Channel")
+            visible: acq.cci !== null
+
+            property CommandExecutor executor: acq.cci ? acq.cci.executor : null
+            property CommandStats stats: acq.cci ? acq.cci.commandStats : null
+
+            Column {
+                spacing: 5
+                width: parent.width
+
+                Label {
+                    text: qsTr("Queued: ") + (groupControl.executor ? groupControl.executor.queueDepth : 0)
+                }
+
+                Label {
+                    text: groupControl.executor
+                          ? qsTr("Latency: ") + groupControl.executor.averageLatencyMs.toFixed(1)
+                            + " ms (max " + groupControl.executor.maxLatencyMs.toFixed(1) + " ms)"
+                          : ""
+                }
+
+                Label {
+                    text: qsTr("Completed: ") + (groupControl.executor ? groupControl.executor.completed : 0)
+                          + qsTr(", coalesced: ") + (groupControl.executor ? groupControl.executor.coalesced : 0)
+                }
+
+                Label {
+                    text: groupControl.executor
+                          ? qsTr("Frame jitter: ") + groupControl.executor.frameJitterMs.toFixed(1)
+                            + " / " + groupControl.executor.frameIntervalMs.toFixed(1) + " ms"
+                            + (groupControl.executor.deferring ? qsTr(" (deferring)") : "")
+                          : ""
+                }
+
+                Label {
+                    text: groupControl.executor
+                          ? qsTr("Deferred: ") + groupControl.executor.deferredByJitter + qsTr(" jitter, ")
+                            + groupControl.executor.deferredByBudget + qsTr(" budget")
+                          : ""
+                }
+
+                ValueSlider {
+                    description: qsTr("Poll budget (cmd/s)")
+                    width: parent.width
+                    minimumValue: 0
+                    maximumValue: 200
+                    stepSize: 5
+                    model: groupControl.executor
+                    binding: "maxCommandRate"
+                }
+
+                ValueSlider {
+                    description: qsTr("Min write interval (ms)")
+                    width: parent.width
+                    minimumValue: 0
+                    maximumValue: 500
+                    stepSize: 10
+                    model: groupControl.executor
+                    binding: "minWriteInterval"
+                }
+
+                Label {
+                    text: qsTr("Busiest commands:")
+                    visible: groupControl.stats !== null
+                }
+
+                Repeater {
+                    id: busiestCommands
+                    model: groupControl.stats ? groupControl.stats.snapshot(5) : []
+
+                    Label {
+                        font.pointSize: 8
+                        text: modelData.name + ": " + modelData.calls
+                              + (modelData.cacheHits > 0 ? " (+" + modelData.cacheHits + " cached)" : "")
+                              + ", " + modelData.meanMs.toFixed(2) + " ms"
+                              + (modelData.errors > 0 ? ", " + modelData.errors + qsTr(" errors") : "")
+                    }
+                }
+
+                Connections {
+                    target: groupControl.stats
+                    onUpdated: busiestCommands.model = groupControl.stats.snapshot(5)
+                }
+
+                Button {
+                    text: qsTr("Reset")
+                    enabled: groupControl.executor !== null
+                    onClicked: {
+                        groupControl.executor.resetMetrics()
+                        groupControl.stats.reset()
+                    }
+                }
+            }
+        }
+    }
+
+    Binding {
+        target: acq
+        property: "ffcGating"
+        value: comboFfcGating.model.get(comboFfcGating.currentIndex).data
+    }
+
+    Binding {
+        target: acq.duplicates
+        property: "skipDuplicates"
+        value: switchSkipDuplicates.checked
+    }
+
+    Binding {
+        target: acq.cameraStats
+        property: "enabled"
+        value: switchCameraStats.checked
+    }
+}
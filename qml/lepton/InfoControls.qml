@@ -52,10 +52,34 @@ Item {
                 width: 180
                 wrapMode: Label.Wrap
             }
+
+            Switch {
+                id: switchTelemetry
+                text: qsTr("Telemetry")
+                visible: acq.cci.supportsTelemetry
+                checked: acq.cci.telemetryEnabled
+            }
+
+            Label {
+                id: labelFpaTemp
+                visible: acq.telemetryValid
+                text: qsTr("FPA: ") + (acq.fpaTemperature - 273.15).toFixed(2) + " °C"
+            }
+
+            Label {
+                id: labelFrameCounter
+                visible: acq.telemetryValid
+                text: qsTr("Frame: ") + acq.telemetryFrameCounter
+            }
         }
 
 
     }
 
-
+    Binding {
+        target: acq.cci
+        property: "telemetryEnabled"
+        value: switchTelemetry.checked
+        when: acq.cci.supportsTelemetry
+    }
 }
@@ -2,6 +2,7 @@ import QtQuick 2.0
 import QtQuick.Controls 2.0
 import GetThermal 1.0
 import "qrc:/lepton"
+import "qrc:/controls"
 
 Page {
     id: root
@@ -24,6 +25,9 @@ Page {
         TabButton {
             text: qsTr("Info")
         }
+        TabButton {
+            text: qsTr("QA")
+        }
     }
 
     SwipeView {
@@ -58,6 +62,24 @@ Page {
             anchors.top: parent.top
             acq: root.acq
         }
+
+        StatsControls {
+            id: statsControls1
+            anchors.bottom: parent.bottom
+            anchors.left: leptonControls1.right
+            anchors.top: parent.top
+            acq: root.acq
+        }
+    }
+
+    // counts are only kelvin while the camera streams TLinear Y16; otherwise
+    // the noise stays in counts
+    Binding {
+        target: acq.temporalStats
+        property: "kelvinPerCount"
+        value: !acq.cci.supportsRadiometry || acq.cameraColorizing
+               || acq.cci.radTLinearEnableState != LEP_RAD_ENABLE_E.LEP_RAD_ENABLE ? 0
+             : acq.cci.radTLinearResolution == LEP_RAD_TLINEAR_RESOLUTION_E.LEP_RAD_RESOLUTION_0_1 ? 0.1 : 0.01
     }
 
 }
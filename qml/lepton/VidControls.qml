@@ -1,6 +1,7 @@
 import QtQuick 2.0
 import QtQuick.Controls 2.0
 import GetThermal 1.0
+import "qrc:/controls"
 
 Item {
     id: root
@@ -56,6 +57,39 @@ Item {
             currentIndex: acq.dataFormatter.pseudocolorPalette
         }
 
+        ComboBox {
+            id: comboColorization
+            width: parent.width
+            visible: comboSwPcolorLut.visible && acq.cci.supportsHwPseudoColor
+
+            model: ListModel {
+                ListElement { text: "Colorize: Auto"; data: UvcAcquisition.ColorizeAuto }
+                ListElement { text: "Colorize on host"; data: UvcAcquisition.ColorizeOnHost }
+                ListElement { text: "Colorize on camera"; data: UvcAcquisition.ColorizeOnCamera }
+            }
+            textRole: qsTr("text")
+
+            currentIndex: acq.colorization
+        }
+
+        Label {
+            width: parent.width
+            visible: comboColorization.visible
+            text: acq.cameraColorizing ? qsTr("Colorizing on camera")
+                                       : qsTr("Host cost: %1 ms/frame").arg(acq.hostColorizeMs.toFixed(2))
+        }
+
+        DetailControls {
+            width: parent.width
+            visible: comboSwPcolorLut.visible
+            acq: root.acq
+        }
+
+        RemapControls {
+            width: parent.width
+            acq: root.acq
+        }
+
         Label {
             id: labelRadGain
             width: parent.width
@@ -131,6 +165,12 @@ Item {
         value: comboSwPcolorLut.model.get(comboSwPcolorLut.currentIndex).data
     }
 
+    Binding {
+        target: acq
+        property: "colorization"
+        value: comboColorization.model.get(comboColorization.currentIndex).data
+    }
+
     Binding {
         target: acq.cci
         property: "vidSbNucEnableState"
@@ -149,29 +189,19 @@ Item {
         value: comboSysGainMode.model.get(comboSysGainMode.currentIndex).data
     }
 
-    function delay(delayTime, cb) {
-        function Timer() {
-            return Qt.createQmlObject("import QtQuick 2.0; Timer {}", root);
-        }
-        var timer = new Timer();
-        timer.interval = delayTime;
-        timer.repeat = false;
-        timer.triggered.connect(cb);
-        timer.start();
-    }
-
+    // frames captured during the FFC are held back by the acquisition
     Connections {
         target: buttonFfc
         onClicked: {
             busyFfc.visible = true;
-            acq.pauseStream();
-            delay(150, function(){
-                acq.cci.performFfc();
-                delay(1500, function() {
-                    acq.resumeStream();
-                    busyFfc.visible = false;
-                });
-            });
+            acq.cci.performFfc();
+        }
+    }
+
+    Connections {
+        target: acq.cci
+        onFfcFinished: {
+            busyFfc.visible = false;
         }
     }
 }
@@ -84,6 +84,7 @@ LinuxBuild {
 
         # QT_INSTALL_LIBS
         QT_LIB_LIST = \
+            libQt5Concurrent.so.5 \
             libQt5Core.so.5 \
             libQt5DBus.so.5 \
             libQt5Gui.so.5 \
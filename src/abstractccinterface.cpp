@@ -1,13 +1,440 @@
 #include "abstractccinterface.h"
 
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMetaEnum>
+#include <QMetaProperty>
+#include <QRect>
+#include <QThread>
+#include <QtConcurrent>
+#include <algorithm>
+
+#define FFC_POLL_INTERVAL_MS 500
+#define FFC_WAIT_POLL_MS 50
+// time for the camera to report the FFC it was told to start
+#define FFC_START_GRACE_MS 500
+#define FFC_TIMEOUT_MS 5000
+
+#define CONFIG_FORMAT "getthermal-camera-config"
+#define CONFIG_VERSION 1
+
 AbstractCCInterface::AbstractCCInterface(QObject *parent)
     : QObject(parent)
+    , m_attributesBuilt(false)
+    , m_ffcInProgress(0)
+    , m_ffcWorkerBusy(0)
+    , m_ffcFromStream(0)
+    , m_stopping(0)
+    , m_ffcPollTimer(new QTimer(this))
+    , m_executor(new CommandExecutor("cci", this))
+    , m_commandStats(new CommandStats(this))
 {
-
+    connect(m_ffcPollTimer, &QTimer::timeout, this, &AbstractCCInterface::pollFfcState);
 }
 
 AbstractCCInterface::AbstractCCInterface(const AbstractCCInterface &intf)
     : QObject(intf.parent())
+    , m_attributesBuilt(false)
+    , m_ffcInProgress(0)
+    , m_ffcWorkerBusy(0)
+    , m_ffcFromStream(0)
+    , m_stopping(0)
+    , m_ffcPollTimer(new QTimer(this))
+    , m_executor(new CommandExecutor("cci", this))
+    , m_commandStats(new CommandStats(this))
+{
+    connect(m_ffcPollTimer, &QTimer::timeout, this, &AbstractCCInterface::pollFfcState);
+}
+
+void AbstractCCInterface::updateFfcState(bool inProgress)
+{
+    if (m_ffcInProgress.fetchAndStoreOrdered(inProgress) != (int)inProgress)
+        emit ffcStateChanged(inProgress);
+}
+
+void AbstractCCInterface::setFfcStateFromStream(bool fromStream)
+{
+    m_ffcFromStream.storeRelease(fromStream);
+}
+
+void AbstractCCInterface::setFfcMonitoring(bool enabled)
+{
+    if (enabled && !m_ffcPollTimer->isActive())
+        m_ffcPollTimer->start(FFC_POLL_INTERVAL_MS);
+    else if (!enabled)
+        m_ffcPollTimer->stop();
+}
+
+void AbstractCCInterface::pollFfcState()
+{
+    // performFfc is already watching, or the previous poll is still out
+    if (!m_ffcWorkerBusy.testAndSetOrdered(0, 1))
+        return;
+
+    m_executor->post([this]() {
+        updateFfcState(queryFfcInProgress());
+        m_ffcWorkerBusy.storeRelease(0);
+    }, CommandExecutor::Poll);
+}
+
+void AbstractCCInterface::performFfc()
 {
+    // one at a time; the ffcFinished of the running one answers this too
+    if (m_ffcWorker.isRunning())
+        return;
+
+    m_ffcWorker = QtConcurrent::run([this]() {
+        // queue behind a poll that is still out
+        while (!m_ffcWorkerBusy.testAndSetOrdered(0, 1))
+        {
+            if (m_stopping.loadAcquire())
+                return;
+            QThread::msleep(FFC_WAIT_POLL_MS);
+        }
+        runFfc();
+    });
+}
+
+void AbstractCCInterface::shutdownWorkers()
+{
+    m_stopping.storeRelease(1);
+    m_ffcPollTimer->stop();
+    // a worker that hasn't started yet still runs, sees m_stopping and returns
+    m_ffcWorker.waitForFinished();
+    while (m_ffcWorkerBusy.loadAcquire())
+        QThread::msleep(FFC_WAIT_POLL_MS);
+    m_executor->shutdown();
+}
+
+void AbstractCCInterface::runFfc()
+{
+    // the worker only waits; the camera is talked to on the executor
+    bool ok = m_executor->call<bool>([this]() { return startFfc(); });
+
+    if (ok)
+    {
+        // the camera takes a moment to report the FFC it was asked for, then
+        // reports it until the shutter opens again
+        QElapsedTimer timer;
+        timer.start();
+        bool seen = false;
+        while (timer.elapsed() < FFC_TIMEOUT_MS && !m_stopping.loadAcquire())
+        {
+            bool busy;
+            if (m_ffcFromStream.loadAcquire())
+            {
+                busy = getFfcInProgress();
+            }
+            else
+            {
+                busy = m_executor->call<bool>([this]() { return queryFfcInProgress(); });
+                updateFfcState(busy);
+            }
+
+            if (busy)
+                seen = true;
+            else if (seen || timer.elapsed() > FFC_START_GRACE_MS)
+                break;
+
+            QThread::msleep(FFC_WAIT_POLL_MS);
+        }
+
+        if (getFfcInProgress())
+        {
+            printf("FFC did not complete within %d ms\n", FFC_TIMEOUT_MS);
+            ok = false;
+        }
+    }
+
+    m_ffcWorkerBusy.storeRelease(0);
+    emit ffcFinished(ok);
+}
+
+const QList<AbstractCCInterface::Attribute> &AbstractCCInterface::attributes()
+{
+    if (m_attributesBuilt)
+        return m_attributes;
+
+    // everything settable the subclass declares; the base class' own
+    // properties are stream settings, not camera configuration
+    const QMetaObject *meta = metaObject();
+    for (int i = staticMetaObject.propertyCount(); i < meta->propertyCount(); i++)
+    {
+        QMetaProperty prop = meta->property(i);
+        if (!prop.isWritable() || !prop.isStored() || !isConfigAttribute(prop.name()))
+            continue;
+
+        Attribute attribute;
+        attribute.name = prop.name();
+        attribute.type = prop.userType();
+        if (attribute.type == QMetaType::UnknownType)
+            continue;
+        attribute.typeName = prop.typeName();
+        attribute.isEnum = (QMetaType::typeFlags(attribute.type) & QMetaType::IsEnumeration) != 0;
+        attribute.property = i;
+        attribute.phase = attributePhase(attribute.name);
+
+        // the SDK enums live in Q_GADGET wrappers, as E
+        const QMetaObject *enumMeta = QMetaType::metaObjectForType(attribute.type);
+        if (attribute.isEnum && enumMeta != NULL)
+        {
+            int index = enumMeta->indexOfEnumerator("E");
+            if (index >= 0)
+            {
+                QMetaEnum e = enumMeta->enumerator(index);
+                for (int k = 0; k < e.keyCount(); k++)
+                {
+                    if (e.value(k) == attribute.keys.size())
+                        attribute.keys.append(e.key(k));
+                }
+            }
+        }
+
+        m_attributes.append(attribute);
+    }
+
+    std::stable_sort(m_attributes.begin(), m_attributes.end(), [](const Attribute &a, const Attribute &b) {
+        return a.phase < b.phase;
+    });
+    m_attributesBuilt = true;
+    return m_attributes;
+}
+
+QVariantList AbstractCCInterface::attributeList()
+{
+    QVariantList list;
+    for (const Attribute &attribute : attributes())
+    {
+        QVariantMap entry;
+        entry["name"] = attribute.name;
+        entry["type"] = attribute.typeName;
+        entry["keys"] = attribute.keys;
+        list.append(entry);
+    }
+    return list;
+}
+
+// enums are stored by key where the key is known, otherwise by value
+QJsonValue AbstractCCInterface::encodeAttribute(const Attribute &attribute, const QVariant &value) const
+{
+    if (attribute.isEnum)
+    {
+        qint64 raw;
+        switch (QMetaType::sizeOf(attribute.type))
+        {
+        case 1: raw = *static_cast<const qint8*>(value.constData()); break;
+        case 2: raw = *static_cast<const qint16*>(value.constData()); break;
+        default: raw = *static_cast<const qint32*>(value.constData()); break;
+        }
+        if (raw >= 0 && raw < attribute.keys.size())
+            return attribute.keys.at(raw);
+        return (double)raw;
+    }
+
+    if (attribute.type == QMetaType::QRect)
+    {
+        QRect rect = value.toRect();
+        return QJsonArray({ rect.x(), rect.y(), rect.width(), rect.height() });
+    }
+
+    return QJsonValue::fromVariant(value);
+}
+
+bool AbstractCCInterface::decodeAttribute(const Attribute &attribute, const QJsonValue &json, QVariant *value) const
+{
+    if (attribute.isEnum)
+    {
+        qint64 raw;
+        if (json.isString())
+        {
+            raw = attribute.keys.indexOf(json.toString());
+            if (raw < 0)
+                return false;
+        }
+        else if (json.isDouble())
+        {
+            raw = (qint64)json.toDouble();
+        }
+        else
+        {
+            return false;
+        }
+
+        qint8 raw8 = raw;
+        qint16 raw16 = raw;
+        qint32 raw32 = raw;
+        switch (QMetaType::sizeOf(attribute.type))
+        {
+        case 1: *value = QVariant(attribute.type, &raw8); break;
+        case 2: *value = QVariant(attribute.type, &raw16); break;
+        default: *value = QVariant(attribute.type, &raw32); break;
+        }
+        return true;
+    }
+
+    if (attribute.type == QMetaType::QRect)
+    {
+        QJsonArray array = json.toArray();
+        if (array.size() != 4)
+            return false;
+        *value = QRect(array[0].toInt(), array[1].toInt(), array[2].toInt(), array[3].toInt());
+        return true;
+    }
+
+    *value = json.toVariant();
+    return value->convert(attribute.type);
+}
+
+QVariantMap AbstractCCInterface::exportConfig()
+{
+    const QList<Attribute> &registry = attributes();
+
+    QVariantMap values = m_executor->call<QVariantMap>([this, &registry]() {
+        QVariantMap values;
+        for (const Attribute &attribute : registry)
+        {
+            QVariant value = metaObject()->property(attribute.property).read(this);
+            QVariantMap entry;
+            entry["type"] = attribute.typeName;
+            entry["value"] = encodeAttribute(attribute, value).toVariant();
+            values[attribute.name] = entry;
+        }
+        return values;
+    });
+
+    QVariantMap config;
+    config["format"] = CONFIG_FORMAT;
+    config["version"] = CONFIG_VERSION;
+    config["device"] = metaObject()->className();
+    config["attributes"] = values;
+    return config;
+}
+
+bool AbstractCCInterface::applyConfig(const QVariantMap &config)
+{
+    if (config.value("format").toString() != CONFIG_FORMAT || config.value("version").toInt() != CONFIG_VERSION)
+    {
+        printf("Unsupported configuration format\n");
+        return false;
+    }
+    if (config.value("device").toString() != metaObject()->className())
+    {
+        printf("Configuration is for %s, not %s\n",
+               qPrintable(config.value("device").toString()), metaObject()->className());
+        return false;
+    }
+
+    // decode everything before the first write, so a bad file changes nothing
+    const QVariantMap values = config.value("attributes").toMap();
+    QList<QPair<Attribute, QVariant>> writes;
+    for (const Attribute &attribute : attributes())
+    {
+        if (!values.contains(attribute.name))
+            continue;
+
+        QVariantMap entry = values.value(attribute.name).toMap();
+        QVariant value;
+        if (entry.value("type").toString() != attribute.typeName
+                || !decodeAttribute(attribute, QJsonValue::fromVariant(entry.value("value")), &value))
+        {
+            printf("Bad value for %s in configuration\n", qPrintable(attribute.name));
+            return false;
+        }
+        writes.append(qMakePair(attribute, value));
+    }
+
+    for (const QString &name : values.keys())
+    {
+        bool known = false;
+        for (const Attribute &attribute : attributes())
+            known = known || attribute.name == name;
+        if (!known)
+            printf("Ignoring unknown attribute %s\n", qPrintable(name));
+    }
+
+    // one job on the executor: nothing else gets between the writes and
+    // the read back
+    bool ok = m_executor->call<bool>([this, &writes]() {
+        QElapsedTimer timer;
+        timer.start();
+        const QMetaObject *meta = metaObject();
+
+        int failed = 0;
+        for (const auto &write : writes)
+        {
+            if (!meta->property(write.first.property).write(this, write.second))
+            {
+                printf("Cannot write %s\n", qPrintable(write.first.name));
+                failed++;
+            }
+        }
+
+        invalidateForVerify();
+
+        for (const auto &write : writes)
+        {
+            QVariant actual = meta->property(write.first.property).read(this);
+            QJsonValue expected = encodeAttribute(write.first, write.second);
+            QJsonValue readBack = encodeAttribute(write.first, actual);
+            if (readBack != expected)
+            {
+                printf("%s reads back as %s, expected %s\n", qPrintable(write.first.name),
+                       qPrintable(readBack.toVariant().toString()), qPrintable(expected.toVariant().toString()));
+                failed++;
+            }
+        }
+
+        printf("Applied %d attributes in %lld ms, %d failed\n", writes.size(), timer.elapsed(), failed);
+        return failed == 0;
+    });
+
+    emit configApplied(ok);
+    return ok;
+}
+
+bool AbstractCCInterface::exportConfigFile(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+    {
+        printf("Cannot write configuration to %s\n", qPrintable(path));
+        return false;
+    }
+
+    const QByteArray json = QJsonDocument(QJsonObject::fromVariantMap(exportConfig())).toJson();
+    if (file.write(json) != json.size() || !file.flush())
+    {
+        printf("Cannot write configuration to %s: %s\n", qPrintable(path), qPrintable(file.errorString()));
+        return false;
+    }
+    printf("Configuration written to %s\n", qPrintable(path));
+    return true;
+}
+
+bool AbstractCCInterface::applyConfigFile(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        printf("Cannot read configuration from %s\n", qPrintable(path));
+        return false;
+    }
+
+    QJsonParseError error;
+    QJsonDocument doc = QJsonDocument::fromJson(file.readAll(), &error);
+    if (!doc.isObject())
+    {
+        printf("Cannot parse %s: %s\n", qPrintable(path), qPrintable(error.errorString()));
+        return false;
+    }
 
+    // the writes and read back go on the executor; the caller (usually the
+    // GUI) hears how it went from configApplied
+    const QVariantMap config = doc.object().toVariantMap();
+    attributes(); // built here rather than raced from the executor
+    m_executor->post([this, config]() { applyConfig(config); });
+    return true;
 }
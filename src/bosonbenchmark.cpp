@@ -0,0 +1,68 @@
+#include "bosonbenchmark.h"
+#include "bosonvariation.h"
+
+#include <QElapsedTimer>
+#include <stdio.h>
+
+extern "C" {
+#include "boson_sdk/UART_Connector.h"
+}
+
+#define FLIR_VID 0x09cb
+
+BosonBenchmark::BosonBenchmark(int commands)
+    : m_commands(qMax(1, commands))
+{
+}
+
+int BosonBenchmark::run()
+{
+    uvc_context_t *ctx;
+    uvc_device_t *dev;
+    uvc_device_handle_t *devh;
+    uvc_error_t res;
+
+    // libuvc owns the libusb context, so it handles the transport's events
+    res = uvc_init(&ctx, NULL);
+    if (res < 0) {
+        uvc_perror(res, "uvc_init");
+        return 1;
+    }
+    res = uvc_find_device(ctx, &dev, FLIR_VID, 0, NULL);
+    if (res < 0) {
+        uvc_perror(res, "uvc_find_device");
+        uvc_exit(ctx);
+        return 1;
+    }
+    res = uvc_open(dev, &devh);
+    if (res < 0) {
+        uvc_perror(res, "uvc_open");
+        uvc_unref_device(dev);
+        uvc_exit(ctx);
+        return 1;
+    }
+
+    BosonVariation *boson = new BosonVariation(ctx, dev, devh);
+    // whatever the constructor queued goes first
+    boson->executor()->call<bool>([]() { return true; }, CommandExecutor::Cosmetic);
+
+    printf("Boson benchmark: %d commands\n", m_commands);
+    TRANSPORT_STATS before, after;
+    GetTransportStats(&before);
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < m_commands; i++)
+        boson->getCameraSerialNumber();
+    qint64 ns = timer.nsecsElapsed();
+    GetTransportStats(&after);
+    int answered = (int)(after.commands - before.commands);
+    printf("%d of %d answered in %.1f ms, %.3f ms per command\n",
+           answered, m_commands, ns / 1e6, ns / 1e6 / m_commands);
+
+    // prints the transport's counters
+    delete boson;
+    uvc_close(devh);
+    uvc_unref_device(dev);
+    uvc_exit(ctx);
+    return answered == m_commands ? 0 : 1;
+}
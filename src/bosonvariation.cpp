@@ -1,7 +1,15 @@
 #include "bosonvariation.h"
 
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <limits.h>
+
+// the FPA temperature is polled this often while no telemetry carries it
+#define FPA_TEMP_POLL_MS 1000
+
 extern "C" {
 #include "boson_sdk/Client_API.h"
+#include "boson_sdk/Client_Dispatcher.h"
 #include "boson_sdk/EnumTypes.h"
 #include "boson_sdk/UART_Connector.h"
 int boson_example();
@@ -16,6 +24,26 @@ void registerBosonVariationQmlTypes()
     QML_REGISTER_ENUM(COLORLUT_ID_E)
 }
 
+// the SDK dispatches one command at a time, so one clock serves all
+static QElapsedTimer dispatchClock;
+
+static uint64_t dispatchBegin(void *, FLR_FUNCTION)
+{
+    return dispatchClock.nsecsElapsed();
+}
+
+static void dispatchEnd(void *context, FLR_FUNCTION fnID, FLR_RESULT result, uint64_t token)
+{
+    static_cast<CommandStats*>(context)->recordCall(fnID, result == R_SUCCESS,
+                                                    dispatchClock.nsecsElapsed() - token);
+}
+
+static QString commandName(quint32 id)
+{
+    // FLR_FUNCTION codes are module << 16 | function
+    return QString("module %1 fn 0x%2").arg(id >> 16).arg(id & 0xffff, 4, 16, QChar('0'));
+}
+
 BosonVariation::BosonVariation(uvc_context_t *ctx,
                                uvc_device_t *dev,
                                uvc_device_handle_t *devh)
@@ -23,12 +51,23 @@ BosonVariation::BosonVariation(uvc_context_t *ctx,
   , dev(dev)
   , devh(devh)
   , usb_devh(uvc_get_libusb_handle(devh))
+  , m_sensorSize(640, 512)
+  , m_telemetryEnabled(false)
+  , m_fpaTempCx10(INT_MIN)
+  , m_fpaTempPending(0)
+  , m_fpaTempTimer(new QTimer(this))
 {
     printf("Initializing Boson with UVC backend...\n");
 
     uvc_get_device_descriptor(dev, &desc);
     printf("Using %s %s with firmware %s\n", desc->manufacturer, desc->product, desc->serialNumber);
 
+    if (!dispatchClock.isValid())
+        dispatchClock.start();
+    commandStats()->setNamer(&commandName);
+    CLIENT_DISPATCH_OBSERVER observer = { dispatchBegin, dispatchEnd, commandStats() };
+    CLIENT_setDispatchObserver(&observer);
+
     FLR_RESULT result;
 
     result = Initialize(usb_devh);
@@ -38,13 +77,50 @@ BosonVariation::BosonVariation(uvc_context_t *ctx,
         printf("Failed to initialize CCI interface\n");
     }
 
+    // telemetry comes as an extra line on a taller Y16 frame
+    for (const uvc_format_desc_t *fmt = uvc_get_format_descs(devh); fmt != NULL; fmt = fmt->next)
+    {
+        if (memcmp(fmt->fourccFormat, "Y16 ", 4) != 0)
+            continue;
+        for (const uvc_frame_desc_t *frame = fmt->frame_descs; frame != NULL; frame = frame->next)
+        {
+            if (frame->wWidth == m_sensorSize.width() && frame->wHeight > m_sensorSize.height())
+                m_telemetrySize = QSize(frame->wWidth, frame->wHeight);
+        }
+    }
+
+    connect(m_fpaTempTimer, &QTimer::timeout, this, &BosonVariation::pollFpaTemp);
+    m_fpaTempTimer->start(FPA_TEMP_POLL_MS);
+
+    /* In-band telemetry replaces polling the FPA temperature, but it needs
+     * the Y16 stream colorized on the host instead of the camera's YUV with
+     * its own AGC. It stays off until someone asks for it (the Telemetry
+     * switch); until then the FPA temperature is polled. */
+    printf("Telemetry frame %s, off until enabled\n", m_telemetrySize.isValid() ? "available" : "not available");
+
     this->setObjectName("BosonVariation");
 }
 
 BosonVariation::~BosonVariation()
 {
+    shutdownWorkers();
+
+    TRANSPORT_STATS stats;
+    GetTransportStats(&stats);
+    if (stats.commands > 0)
+    {
+        printf("Boson %s transport: %llu commands, %llu timeouts, %.3f ms round trip, "
+               "%.1f us CPU per command (%.1f us in callbacks), %u ring overruns\n",
+               stats.async ? "async" : "sync",
+               (unsigned long long)stats.commands, (unsigned long long)stats.timeouts,
+               stats.roundTripNs / 1e6 / stats.commands,
+               (stats.callerCpuNs + stats.callbackCpuNs) / 1e3 / stats.commands,
+               stats.callbackCpuNs / 1e3 / stats.commands, stats.overruns);
+    }
+
     printf("\n\nClosing...\n");
     Close();
+    CLIENT_setDispatchObserver(NULL);
 
     uvc_free_device_descriptor(desc);
 }
@@ -56,6 +132,7 @@ const AbstractCCInterface& BosonVariation::operator =(const AbstractCCInterface&
 
 const QString BosonVariation::getCameraPartNumber()
 {
+    QMutexLocker lock(&m_mutex);
     FLR_BOSON_PARTNUMBER_T pn;
     bosonGetCameraPN(&pn);
     return QString::fromLatin1((char*)pn.value, sizeof(pn.value));
@@ -63,6 +140,7 @@ const QString BosonVariation::getCameraPartNumber()
 
 const QString BosonVariation::getCameraSerialNumber()
 {
+    QMutexLocker lock(&m_mutex);
     uint32_t sn;
     bosonGetCameraSN(&sn);
     return QString::asprintf("%d", sn);
@@ -70,6 +148,7 @@ const QString BosonVariation::getCameraSerialNumber()
 
 const QString BosonVariation::getSensorPartNumber()
 {
+    QMutexLocker lock(&m_mutex);
 
     FLR_BOSON_SENSOR_PARTNUMBER_T pn;
     bosonGetSensorPN(&pn);
@@ -78,6 +157,7 @@ const QString BosonVariation::getSensorPartNumber()
 
 const QString BosonVariation::getSensorSerialNumber()
 {
+    QMutexLocker lock(&m_mutex);
     uint32_t sn;
     bosonGetSensorSN(&sn);
     return QString::asprintf("%d", sn);
@@ -85,6 +165,7 @@ const QString BosonVariation::getSensorSerialNumber()
 
 const QString BosonVariation::getSoftwareRev()
 {
+    QMutexLocker lock(&m_mutex);
     uint32_t maj, min, rev;
     bosonGetSoftwareRev(&maj, &min, &rev);
     return QString::asprintf("%d.%d.%d", maj, min, rev);
@@ -103,18 +184,150 @@ bool BosonVariation::getSupportsRadiometry()
 
 const QVideoSurfaceFormat BosonVariation::getDefaultFormat()
 {
-    return QVideoSurfaceFormat(QSize(640,512), QVideoFrame::Format_YUV420P);
+    // the telemetry line is only carried by the 16-bit stream
+    if (m_telemetryEnabled)
+        return QVideoSurfaceFormat(m_telemetrySize, QVideoFrame::Format_Y16);
+
+    return QVideoSurfaceFormat(m_sensorSize, QVideoFrame::Format_YUV420P);
 }
 
+// from telemetry or the last poll; 0 until either has a value
 float BosonVariation::getCameraInternalTempC()
 {
-    int16_t temp_c_x10;
-    bosonlookupFPATempDegCx10(&temp_c_x10);
+    int temp_c_x10 = m_fpaTempCx10.load();
+    if (temp_c_x10 == INT_MIN)
+        return 0.0f;
     return (float)temp_c_x10 / 10.0f;
 }
 
-void BosonVariation::performFfc()
+void BosonVariation::pollFpaTemp()
 {
+    // skip a tick rather than queue up behind slow commands
+    if (m_telemetryEnabled || !m_fpaTempPending.testAndSetOrdered(0, 1))
+        return;
+
+    executor()->post([this]() {
+        int16_t polled_c_x10;
+        FLR_RESULT result;
+        {
+            QMutexLocker lock(&m_mutex);
+            result = bosonlookupFPATempDegCx10(&polled_c_x10);
+        }
+        if (result == R_SUCCESS && m_fpaTempCx10.fetchAndStoreRelaxed(polled_c_x10) != polled_c_x10)
+            emit cameraInternalTempChanged(polled_c_x10 / 10.0f);
+        m_fpaTempPending.storeRelease(0);
+    }, CommandExecutor::Cosmetic);
+}
+
+void BosonVariation::setTelemetryEnabled(bool enabled)
+{
+    if (enabled == m_telemetryEnabled)
+        return;
+
+    if (enabled && !m_telemetrySize.isValid())
+    {
+        printf("Telemetry isn't supported by this camera\n");
+        return;
+    }
+
+    // the camera is told on the executor; the state and the stream follow on
+    // the GUI thread once it has it
+    executor()->post([this, enabled]() {
+        FLR_RESULT result;
+        {
+            QMutexLocker lock(&m_mutex);
+            result = telemetrySetLocation(FLR_TELEMETRY_LOC_BOTTOM);
+            if (result == R_SUCCESS)
+                result = telemetrySetState(enabled ? FLR_ENABLE : FLR_DISABLE);
+        }
+        if (result != R_SUCCESS)
+        {
+            printf("telemetrySetState: 0x%08X\n", result);
+            return;
+        }
+
+        QMetaObject::invokeMethod(this, [this, enabled]() {
+            if (m_telemetryEnabled == enabled)
+                return;
+            m_telemetryEnabled = enabled;
+            emit telemetryChanged(enabled);
+        }, Qt::QueuedConnection);
+    });
+}
+
+int BosonVariation::getTelemetryRows() const
+{
+    if (!m_telemetryEnabled)
+        return 0;
+    return m_telemetrySize.height() - m_sensorSize.height();
+}
+
+/* Telemetry line byte offsets, from the "Telemetry" section of the FLIR
+ * Boson Software Interface Description Document (IDD), which lays the line
+ * out as fields at fixed byte offsets. Multi-byte fields are big-endian like
+ * the rest of the CCI protocol. */
+#define TLM_REVISION        0   // telemetry revision, 0 when the line isn't telemetry
+#define TLM_FRAME_COUNTER   42  // 32-bit frame counter
+#define TLM_UPTIME_MS       46  // 32-bit camera uptime, ms
+#define TLM_FFC_STATUS      54  // FFC state, as bosonGetFfcStatus reports it
+#define TLM_GAIN_MODE       56  // high/low gain, as bosonGetGainMode reports it
+#define TLM_FPA_TEMP_CX10   94  // signed FPA temperature, tenths of a degree C
+#define TLM_MIN_BYTES       96
+
+static inline uint16_t telemetryU16(const uint8_t *bytes, int offset)
+{
+    return ((uint16_t)bytes[offset] << 8) | bytes[offset + 1];
+}
+
+static inline uint32_t telemetryU32(const uint8_t *bytes, int offset)
+{
+    return ((uint32_t)telemetryU16(bytes, offset) << 16) | telemetryU16(bytes, offset + 2);
+}
+
+bool BosonVariation::parseTelemetry(const uint8_t *data, int width, int rows, int step, FrameTelemetry *out)
+{
+    Q_UNUSED(step);
+
+    if (rows < 1 || width * 2 < TLM_MIN_BYTES || telemetryU16(data, TLM_REVISION) == 0)
+        return false;
+
+    static const FrameTelemetry::FfcState ffcStates[] = {
+        FrameTelemetry::FfcNeverCommanded,
+        FrameTelemetry::FfcImminent,
+        FrameTelemetry::FfcInProgress,
+        FrameTelemetry::FfcComplete,
+    };
+    uint16_t ffcStatus = telemetryU16(data, TLM_FFC_STATUS);
+    int16_t fpaTempCx10 = (int16_t)telemetryU16(data, TLM_FPA_TEMP_CX10);
+
+    out->valid = true;
+    out->frameCounter = telemetryU32(data, TLM_FRAME_COUNTER);
+    out->uptimeMs = telemetryU32(data, TLM_UPTIME_MS);
+    out->fpaTempKelvin = fpaTempCx10 / 10.0f + 273.15f;
+    out->ffcState = ffcStatus < FLR_BOSON_FFCSTATUS_END ? ffcStates[ffcStatus] : FrameTelemetry::FfcUnknown;
+    out->ffcDesired = ffcStatus == FLR_BOSON_FFC_IMMINENT;
+    out->agcEnabled = false;
+    out->gainMode = telemetryU16(data, TLM_GAIN_MODE);
+
+    if (m_fpaTempCx10.fetchAndStoreRelaxed(fpaTempCx10) != fpaTempCx10)
+        emit cameraInternalTempChanged(fpaTempCx10 / 10.0f);
+
+    return true;
+}
+
+bool BosonVariation::startFfc()
+{
+    QMutexLocker lock(&m_mutex);
     FLR_RESULT result = bosonRunFFC();
     printf("RunFFC:  0x%08X \n", result);
+    return result == R_SUCCESS;
+}
+
+bool BosonVariation::queryFfcInProgress()
+{
+    QMutexLocker lock(&m_mutex);
+    int16_t inProgress = 0;
+    if (bosonGetFFCInProgress(&inProgress) != R_SUCCESS)
+        return false;
+    return inProgress != 0;
 }
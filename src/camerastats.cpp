@@ -0,0 +1,198 @@
+#include "camerastats.h"
+
+#include <stdio.h>
+
+#define DEFAULT_INTERVAL_MS 250
+#define MIN_INTERVAL_MS 50
+// statistics older than this many intervals are stale
+#define MAX_AGE_INTERVALS 2
+// how often the host pass runs anyway to check the camera's numbers
+#define VERIFY_INTERVAL_MS 5000
+// allowed disagreement: a fraction of the host range, but at least a few counts
+#define VERIFY_TOLERANCE_DIVISOR 8
+#define VERIFY_MIN_TOLERANCE 32
+#define MISMATCH_LIMIT 3
+#define PUBLISH_INTERVAL_MS 1000
+
+CameraStats::CameraStats()
+    : m_cci(NULL)
+    , m_enabled(0)
+    , m_interval(DEFAULT_INTERVAL_MS)
+    , m_timer(new QTimer(this))
+    , m_fetchPending(0)
+    , m_trusted(1)
+    , m_fetchedAt(-1)
+    , m_maxAge(DEFAULT_INTERVAL_MS * MAX_AGE_INTERVALS)
+    , m_lastVerify(-VERIFY_INTERVAL_MS)
+    , m_mismatches(0)
+    , m_cameraRate(0.0f)
+    , m_hostRate(0.0f)
+    , m_windowCamera(0)
+    , m_windowHost(0)
+{
+    m_clock.start();
+    connect(m_timer, &QTimer::timeout, this, &CameraStats::fetch);
+}
+
+void CameraStats::setCci(AbstractCCInterface *cci)
+{
+    m_cci = cci;
+    {
+        QMutexLocker lock(&m_mutex);
+        m_fetchedAt = -1;
+    }
+    m_trusted.storeRelease(1);
+
+    if (m_cci != NULL && isEnabled())
+        m_timer->start(m_interval);
+    else
+        m_timer->stop();
+}
+
+void CameraStats::setEnabled(bool enabled)
+{
+    if (isEnabled() == enabled)
+        return;
+    m_enabled.storeRelease(enabled);
+
+    // a fresh chance for the camera's numbers, checked first thing
+    {
+        QMutexLocker lock(&m_mutex);
+        m_fetchedAt = -1;
+        m_lastVerify = -VERIFY_INTERVAL_MS;
+        m_mismatches = 0;
+    }
+    m_trusted.storeRelease(1);
+
+    if (m_cci != NULL && enabled)
+        m_timer->start(m_interval);
+    else
+        m_timer->stop();
+    emit enabledChanged(enabled);
+}
+
+void CameraStats::setInterval(int ms)
+{
+    ms = qMax(MIN_INTERVAL_MS, ms);
+    if (m_interval == ms)
+        return;
+    m_interval = ms;
+    m_maxAge.storeRelease(ms * MAX_AGE_INTERVALS);
+    if (m_timer->isActive())
+        m_timer->start(m_interval);
+    emit intervalChanged(ms);
+}
+
+void CameraStats::fetch()
+{
+    // skip a tick rather than queue up behind other control traffic
+    if (m_cci == NULL || !isTrusted() || m_fetchPending.loadAcquire())
+        return;
+
+    m_fetchPending.storeRelease(1);
+    AbstractCCInterface *cci = m_cci;
+    cci->executor()->post([this, cci]() {
+        AbstractCCInterface::SceneStats stats;
+        if (cci->getSceneStats(&stats))
+        {
+            QMutexLocker lock(&m_mutex);
+            m_stats = stats;
+            m_fetchedAt = m_clock.elapsed();
+        }
+        m_fetchPending.storeRelease(0);
+    }, CommandExecutor::Poll);
+}
+
+bool CameraStats::fresh(const QSize &frameSize, qint64 now) const
+{
+    return m_fetchedAt >= 0
+            && now - m_fetchedAt <= m_maxAge.loadAcquire()
+            && m_stats.roi == QRect(QPoint(0, 0), frameSize)
+            && m_stats.minVal <= m_stats.maxVal;
+}
+
+float CameraStats::getCameraRate() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_cameraRate;
+}
+
+float CameraStats::getHostRate() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_hostRate;
+}
+
+bool CameraStats::lookup(const QSize &frameSize, uint16_t *minVal, uint16_t *maxVal)
+{
+    if (!isEnabled() || !isTrusted())
+        return false;
+
+    qint64 now = m_clock.elapsed();
+    QMutexLocker lock(&m_mutex);
+    if (now - m_lastVerify >= VERIFY_INTERVAL_MS || !fresh(frameSize, now))
+        return false;
+    *minVal = m_stats.minVal;
+    *maxVal = m_stats.maxVal;
+    lock.unlock();
+
+    count(true);
+    return true;
+}
+
+void CameraStats::noteHostRange(const QSize &frameSize, uint16_t minVal, uint16_t maxVal)
+{
+    count(false);
+    if (!isEnabled() || !isTrusted())
+        return;
+
+    qint64 now = m_clock.elapsed();
+    QMutexLocker lock(&m_mutex);
+    if (now - m_lastVerify < VERIFY_INTERVAL_MS || !fresh(frameSize, now))
+        return;
+    AbstractCCInterface::SceneStats stats = m_stats;
+    m_lastVerify = now;
+
+    // the scene moves between fetch and frame, so only gross differences count
+    int tolerance = qMax(VERIFY_MIN_TOLERANCE, (maxVal - minVal) / VERIFY_TOLERANCE_DIVISOR);
+    if (qAbs(stats.minVal - minVal) <= tolerance && qAbs(stats.maxVal - maxVal) <= tolerance)
+    {
+        m_mismatches = 0;
+        return;
+    }
+
+    if (++m_mismatches < MISMATCH_LIMIT)
+        return;
+    lock.unlock();
+    printf("Camera scene statistics (%u..%u) don't match the frames (%u..%u), using the host's\n",
+           stats.minVal, stats.maxVal, minVal, maxVal);
+    m_trusted.storeRelease(0);
+    emit countersChanged();
+}
+
+void CameraStats::count(bool camera)
+{
+    if (camera)
+        m_windowCamera++;
+    else
+        m_windowHost++;
+
+    if (!m_window.isValid())
+    {
+        m_window.start();
+        return;
+    }
+
+    qint64 elapsed = m_window.elapsed();
+    if (elapsed < PUBLISH_INTERVAL_MS)
+        return;
+
+    {
+        QMutexLocker lock(&m_mutex);
+        m_cameraRate = m_windowCamera * 1000.0f / elapsed;
+        m_hostRate = m_windowHost * 1000.0f / elapsed;
+    }
+    m_windowCamera = m_windowHost = 0;
+    m_window.restart();
+    emit countersChanged();
+}
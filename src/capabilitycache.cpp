@@ -0,0 +1,54 @@
+#include "capabilitycache.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QSettings>
+#include <QStandardPaths>
+#include <stdio.h>
+
+// bump when the meaning of stored values changes; older profiles are ignored
+#define FORMAT_VERSION 1
+
+CapabilityCache::CapabilityCache(quint16 vendorId, quint16 productId, const QString &deviceId)
+{
+    QString id = deviceId;
+    id.replace(QRegExp("[^A-Za-z0-9._-]"), "_");
+    m_group = QString::asprintf("%04x_%04x_", vendorId, productId) + id;
+
+    QSettings settings(path(), QSettings::IniFormat);
+    settings.beginGroup(m_group);
+    if (settings.value("formatVersion").toInt() != FORMAT_VERSION)
+        return;
+
+    for (const QString &key : settings.childKeys())
+    {
+        if (key != "formatVersion")
+            m_values[key] = settings.value(key);
+    }
+}
+
+QString CapabilityCache::path()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppConfigLocation) + "/capabilities.ini";
+}
+
+bool CapabilityCache::save()
+{
+    QDir().mkpath(QFileInfo(path()).absolutePath());
+
+    QSettings settings(path(), QSettings::IniFormat);
+    settings.remove(m_group);
+    settings.beginGroup(m_group);
+    settings.setValue("formatVersion", FORMAT_VERSION);
+    for (auto it = m_values.constBegin(); it != m_values.constEnd(); ++it)
+        settings.setValue(it.key(), it.value());
+    settings.endGroup();
+    settings.sync();
+
+    if (settings.status() != QSettings::NoError)
+    {
+        printf("Cannot write capability cache %s\n", qPrintable(path()));
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,358 @@
+#include "commandexecutor.h"
+#include "functionthread.h"
+
+#include <QMutexLocker>
+#include <math.h>
+
+// weight of the newest sample in the running latency average
+#define LATENCY_SMOOTHING 0.1f
+
+// default spacing of coalesced writes to one attribute, ~20 per second
+#define DEFAULT_MIN_WRITE_INTERVAL_MS 50
+
+// polls and refreshes; a Lepton control transfer takes a few ms
+#define DEFAULT_MAX_COMMAND_RATE 40
+// burst the budget allows after a quiet period, in seconds of rate
+#define BUDGET_BURST_S 0.25f
+
+// defer when the mean deviation exceeds this fraction of the frame interval
+#define DEFAULT_JITTER_TOLERANCE 0.2f
+// weight of the newest frame interval in the jitter estimate
+#define JITTER_SMOOTHING 0.05f
+// the stream counts as stopped after this long without a frame
+#define STREAM_IDLE_MS 1000
+// polls are held back by jitter at most this long
+#define MAX_POLL_DEFER_MS 2000
+// cosmetic refreshes can wait longer, but not forever on a jittery stream
+#define MAX_COSMETIC_DEFER_MS 10000
+// how often held commands re-check the jitter estimate
+#define JITTER_RECHECK_MS 50
+// how often frame arrivals refresh the published metrics
+#define FRAME_METRICS_MS 500
+
+CommandExecutor::CommandExecutor(const QString &name, QObject *parent)
+    : QObject(parent)
+    , m_stopping(false)
+    , m_minWriteInterval(DEFAULT_MIN_WRITE_INTERVAL_MS)
+    , m_maxCommandRate(DEFAULT_MAX_COMMAND_RATE)
+    , m_tokens(DEFAULT_MAX_COMMAND_RATE * BUDGET_BURST_S)
+    , m_lastRefill(0)
+    , m_jitterTolerance(DEFAULT_JITTER_TOLERANCE)
+    , m_lastFrame(-1)
+    , m_frameIntervalMs(0.0f)
+    , m_frameJitterMs(0.0f)
+    , m_deferring(false)
+    , m_deferredByJitter(0)
+    , m_deferredByBudget(0)
+    , m_lastLatencyMs(0.0f)
+    , m_averageLatencyMs(0.0f)
+    , m_maxLatencyMs(0.0f)
+    , m_completed(0)
+    , m_coalesced(0)
+{
+    m_clock.start();
+    m_thread = new FunctionThread([this]() { run(); });
+    m_thread->setObjectName(name);
+    m_thread->start();
+}
+
+CommandExecutor::~CommandExecutor()
+{
+    shutdown();
+    delete m_thread;
+}
+
+void CommandExecutor::enqueue(const Command &entry)
+{
+    m_queue.append(entry);
+    m_wake.wakeOne();
+}
+
+bool CommandExecutor::post(std::function<void()> command, Priority priority)
+{
+    QMutexLocker lock(&m_mutex);
+    if (m_stopping)
+        return false;
+
+    Command entry;
+    entry.fn = command;
+    entry.key = 0;
+    entry.keyed = false;
+    entry.priority = priority;
+    entry.heldByJitter = entry.heldByBudget = false;
+    entry.queued.start();
+    enqueue(entry);
+    lock.unlock();
+
+    emit metricsChanged();
+    return true;
+}
+
+void CommandExecutor::postCoalesced(quintptr key, std::function<void()> command)
+{
+    QMutexLocker lock(&m_mutex);
+    if (m_stopping)
+        return;
+
+    if (m_latest.contains(key))
+    {
+        // the queued entry keeps its place and picks up the newest write
+        m_latest[key] = command;
+        m_coalesced++;
+    }
+    else
+    {
+        m_latest.insert(key, command);
+
+        Command entry;
+        entry.key = key;
+        entry.keyed = true;
+        entry.priority = UserWrite;
+        entry.heldByJitter = entry.heldByBudget = false;
+        entry.queued.start();
+        enqueue(entry);
+    }
+    lock.unlock();
+
+    emit metricsChanged();
+}
+
+void CommandExecutor::setMinWriteInterval(int ms)
+{
+    ms = qMax(0, ms);
+    {
+        QMutexLocker lock(&m_mutex);
+        if (m_minWriteInterval == ms)
+            return;
+        m_minWriteInterval = ms;
+        m_wake.wakeOne();
+    }
+    emit minWriteIntervalChanged(ms);
+}
+
+void CommandExecutor::setMaxCommandRate(int rate)
+{
+    rate = qMax(0, rate);
+    {
+        QMutexLocker lock(&m_mutex);
+        if (m_maxCommandRate == rate)
+            return;
+        m_maxCommandRate = rate;
+        m_tokens = qMin(m_tokens, qMax(1.0f, rate * BUDGET_BURST_S));
+        m_wake.wakeOne();
+    }
+    emit schedulingChanged();
+}
+
+void CommandExecutor::setJitterTolerance(float tolerance)
+{
+    tolerance = qMax(0.0f, tolerance);
+    {
+        QMutexLocker lock(&m_mutex);
+        if (m_jitterTolerance == tolerance)
+            return;
+        m_jitterTolerance = tolerance;
+        m_wake.wakeOne();
+    }
+    emit schedulingChanged();
+}
+
+void CommandExecutor::shutdown()
+{
+    {
+        QMutexLocker lock(&m_mutex);
+        m_stopping = true;
+        m_wake.wakeOne();
+    }
+    if (!isExecutorThread())
+        m_thread->wait();
+}
+
+void CommandExecutor::noteFrameArrival()
+{
+    QMutexLocker lock(&m_mutex);
+    qint64 now = m_clock.elapsed();
+    qint64 previous = m_lastFrame;
+    m_lastFrame = now;
+
+    if (previous < 0 || now - previous > STREAM_IDLE_MS)
+    {
+        // (re)starting: no interval yet
+        m_frameIntervalMs = m_frameJitterMs = 0.0f;
+        return;
+    }
+
+    float interval = now - previous;
+    if (m_frameIntervalMs == 0.0f)
+    {
+        m_frameIntervalMs = interval;
+        return;
+    }
+
+    m_frameIntervalMs += JITTER_SMOOTHING * (interval - m_frameIntervalMs);
+    m_frameJitterMs += JITTER_SMOOTHING * (fabsf(interval - m_frameIntervalMs) - m_frameJitterMs);
+
+    bool report = (now / FRAME_METRICS_MS) != (previous / FRAME_METRICS_MS);
+    lock.unlock();
+
+    if (report)
+        emit metricsChanged();
+}
+
+int CommandExecutor::getQueueDepth()
+{
+    QMutexLocker lock(&m_mutex);
+    return m_queue.size();
+}
+
+void CommandExecutor::resetMetrics()
+{
+    QMutexLocker lock(&m_mutex);
+    m_lastLatencyMs = m_averageLatencyMs = m_maxLatencyMs = 0.0f;
+    m_completed = 0;
+    m_coalesced = 0;
+    m_deferredByJitter = m_deferredByBudget = 0;
+    lock.unlock();
+    emit metricsChanged();
+}
+
+bool CommandExecutor::streamJittery(qint64 now) const
+{
+    if (m_lastFrame < 0 || now - m_lastFrame > STREAM_IDLE_MS || m_frameIntervalMs == 0.0f)
+        return false;
+    return m_frameJitterMs > m_jitterTolerance * m_frameIntervalMs;
+}
+
+/* Index of the queued command to run now: the oldest one of the highest
+ * priority that isn't being held back. Keyed writes are held until their
+ * interval has passed, polls and refreshes by stream jitter and the rate
+ * budget. Otherwise -1, with *wait set to when to look again (-1 if nothing
+ * is queued). */
+int CommandExecutor::nextRunnable(qint64 now, qint64 *wait)
+{
+    *wait = -1;
+    if (m_stopping && !m_queue.isEmpty())
+        return 0;
+
+    if (m_maxCommandRate > 0)
+    {
+        float burst = qMax(1.0f, m_maxCommandRate * BUDGET_BURST_S);
+        m_tokens = qMin(burst, m_tokens + (now - m_lastRefill) * m_maxCommandRate / 1000.0f);
+    }
+    m_lastRefill = now;
+
+    const bool jittery = streamJittery(now);
+    bool deferring = false;
+    int best = -1;
+
+    for (int i = 0; i < m_queue.size(); i++)
+    {
+        Command &command = m_queue[i];
+        qint64 holdFor = 0;
+
+        if (command.keyed && m_lastRun.contains(command.key))
+        {
+            qint64 due = m_lastRun.value(command.key) + m_minWriteInterval;
+            holdFor = due - now;
+        }
+        else if (command.priority != UserWrite)
+        {
+            qint64 maxDefer = command.priority == Cosmetic ? MAX_COSMETIC_DEFER_MS : MAX_POLL_DEFER_MS;
+            if (jittery && command.queued.elapsed() < maxDefer)
+            {
+                if (!command.heldByJitter)
+                {
+                    command.heldByJitter = true;
+                    m_deferredByJitter++;
+                }
+                holdFor = JITTER_RECHECK_MS;
+                deferring = true;
+            }
+            else if (m_maxCommandRate > 0 && m_tokens < 1.0f)
+            {
+                if (!command.heldByBudget)
+                {
+                    command.heldByBudget = true;
+                    m_deferredByBudget++;
+                }
+                holdFor = (qint64)ceilf((1.0f - m_tokens) * 1000.0f / m_maxCommandRate);
+                deferring = true;
+            }
+        }
+
+        if (holdFor > 0)
+        {
+            *wait = (*wait < 0) ? holdFor : qMin(*wait, holdFor);
+            continue;
+        }
+
+        if (best < 0 || command.priority < m_queue.at(best).priority)
+            best = i;
+        if (command.priority == UserWrite)
+            break;
+    }
+
+    m_deferring = deferring;
+    return best;
+}
+
+void CommandExecutor::run()
+{
+    QMutexLocker lock(&m_mutex);
+    bool wasDeferring = false;
+    for (;;)
+    {
+        qint64 now = m_clock.elapsed();
+        qint64 wait;
+        int next = nextRunnable(now, &wait);
+
+        if (m_deferring != wasDeferring)
+        {
+            wasDeferring = m_deferring;
+            lock.unlock();
+            emit metricsChanged();
+            lock.relock();
+            continue;
+        }
+
+        if (next < 0)
+        {
+            if (m_queue.isEmpty())
+            {
+                if (m_stopping)
+                    break;
+                m_wake.wait(&m_mutex);
+            }
+            else
+            {
+                m_wake.wait(&m_mutex, (unsigned long)wait);
+            }
+            continue;
+        }
+
+        Command command = m_queue.takeAt(next);
+        if (command.keyed)
+        {
+            command.fn = m_latest.take(command.key);
+            m_lastRun[command.key] = now;
+        }
+        // user writes always go and may overdraw the budget; polls that
+        // follow pay for it
+        if (m_maxCommandRate > 0)
+            m_tokens = qMax(-qMax(1.0f, m_maxCommandRate * BUDGET_BURST_S), m_tokens - 1.0f);
+        lock.unlock();
+
+        command.fn();
+        float latency = command.queued.nsecsElapsed() / 1e6f;
+
+        lock.relock();
+        m_lastLatencyMs = latency;
+        m_averageLatencyMs = m_completed ? m_averageLatencyMs + LATENCY_SMOOTHING * (latency - m_averageLatencyMs) : latency;
+        m_maxLatencyMs = qMax(m_maxLatencyMs, latency);
+        m_completed++;
+        lock.unlock();
+
+        emit metricsChanged();
+        lock.relock();
+    }
+}
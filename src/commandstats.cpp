@@ -0,0 +1,167 @@
+#include "commandstats.h"
+
+#include <QFile>
+#include <QMutexLocker>
+#include <QTextStream>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+#define PUBLISH_INTERVAL_MS 1000
+
+// upper bound of histogram bin 0
+#define HISTOGRAM_BASE_NS 64000
+
+CommandStats::CommandStats(QObject *parent)
+    : QObject(parent)
+    , m_totalCalls(0)
+    , m_totalErrors(0)
+{
+    m_published.start();
+}
+
+CommandStats::Entry &CommandStats::entry(quint32 id)
+{
+    auto it = m_entries.find(id);
+    if (it == m_entries.end())
+    {
+        Entry fresh;
+        memset(&fresh, 0, sizeof(fresh));
+        it = m_entries.insert(id, fresh);
+    }
+    return *it;
+}
+
+void CommandStats::recordCall(quint32 id, bool ok, qint64 nsecs)
+{
+    int bin = 0;
+    for (qint64 bound = HISTOGRAM_BASE_NS; nsecs >= bound && bin < HistogramBins - 1; bound <<= 1)
+        bin++;
+
+    {
+        QMutexLocker lock(&m_mutex);
+        Entry &e = entry(id);
+        e.calls++;
+        e.totalNs += nsecs;
+        e.maxNs = qMax(e.maxNs, nsecs);
+        e.histogram[bin]++;
+        m_totalCalls++;
+        if (!ok)
+        {
+            e.errors++;
+            m_totalErrors++;
+        }
+    }
+    publish();
+}
+
+void CommandStats::recordCacheHit(quint32 id)
+{
+    {
+        QMutexLocker lock(&m_mutex);
+        entry(id).cacheHits++;
+    }
+    publish();
+}
+
+void CommandStats::publish()
+{
+    {
+        QMutexLocker lock(&m_mutex);
+        if (m_published.elapsed() < PUBLISH_INTERVAL_MS)
+            return;
+        m_published.restart();
+    }
+    emit updated();
+}
+
+void CommandStats::reset()
+{
+    {
+        QMutexLocker lock(&m_mutex);
+        m_entries.clear();
+        m_totalCalls = m_totalErrors = 0;
+    }
+    emit updated();
+}
+
+// call with m_mutex held
+QList<quint32> CommandStats::busiest()
+{
+    QList<quint32> ids = m_entries.keys();
+    std::sort(ids.begin(), ids.end(), [this](quint32 a, quint32 b) {
+        const Entry &ea = m_entries[a], &eb = m_entries[b];
+        quint64 na = ea.calls + ea.cacheHits, nb = eb.calls + eb.cacheHits;
+        return na != nb ? na > nb : a < b;
+    });
+    return ids;
+}
+
+QVariantList CommandStats::snapshot(int limit)
+{
+    QMutexLocker lock(&m_mutex);
+    QVariantList list;
+
+    for (quint32 id : busiest())
+    {
+        if (limit >= 0 && list.size() >= limit)
+            break;
+
+        const Entry &e = m_entries[id];
+        QVariantList histogram;
+        for (int i = 0; i < HistogramBins; i++)
+            histogram.append(e.histogram[i]);
+
+        QVariantMap row;
+        row["id"] = id;
+        row["name"] = m_namer ? m_namer(id) : QString("0x%1").arg(id, 8, 16, QChar('0'));
+        row["calls"] = e.calls;
+        row["errors"] = e.errors;
+        row["cacheHits"] = e.cacheHits;
+        row["meanMs"] = e.calls ? e.totalNs / 1e6 / e.calls : 0.0;
+        row["maxMs"] = e.maxNs / 1e6;
+        row["histogram"] = histogram;
+        list.append(row);
+    }
+    return list;
+}
+
+QString CommandStats::toCsv()
+{
+    QString csv;
+    QTextStream out(&csv);
+
+    out << "id,name,calls,errors,cache_hits,mean_ms,max_ms";
+    for (int i = 0; i < HistogramBins - 1; i++)
+        out << ",lt_" << (HISTOGRAM_BASE_NS << i) / 1000 << "us";
+    out << ",slower\n";
+
+    QMutexLocker lock(&m_mutex);
+    for (quint32 id : busiest())
+    {
+        const Entry &e = m_entries[id];
+        QString name = m_namer ? m_namer(id) : QString();
+        out << QString("0x%1").arg(id, 8, 16, QChar('0')) << ",\"" << name << "\","
+            << e.calls << "," << e.errors << "," << e.cacheHits << ","
+            << (e.calls ? e.totalNs / 1e6 / e.calls : 0.0) << "," << e.maxNs / 1e6;
+        for (int i = 0; i < HistogramBins; i++)
+            out << "," << e.histogram[i];
+        out << "\n";
+    }
+    out.flush();
+    return csv;
+}
+
+bool CommandStats::exportCsv(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+    {
+        printf("Cannot write command statistics to %s\n", qPrintable(path));
+        return false;
+    }
+
+    file.write(toCsv().toUtf8());
+    printf("Command statistics written to %s\n", qPrintable(path));
+    return true;
+}
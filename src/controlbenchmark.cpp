@@ -0,0 +1,121 @@
+#include "controlbenchmark.h"
+#include "leptonvariation.h"
+#include "simulatedlepton.h"
+
+#include <QElapsedTimer>
+#include <QMetaProperty>
+#include <stdio.h>
+
+// writes per simulated slider drag
+#define DRAG_WRITES 20
+
+ControlBenchmark::ControlBenchmark(int rounds, quint32 seed)
+    : m_rounds(qMax(1, rounds))
+    , m_seed(seed)
+    , m_latencyUs(0)
+    , m_jitterUs(0)
+    , m_errorRate(0.0)
+{
+}
+
+void ControlBenchmark::setLatency(int latencyUs, int jitterUs)
+{
+    m_latencyUs = latencyUs;
+    m_jitterUs = jitterUs;
+}
+
+void ControlBenchmark::setErrorRate(double rate)
+{
+    m_errorRate = rate;
+}
+
+// everything posted so far has run once this returns
+static void drain(CommandExecutor *executor)
+{
+    executor->call<bool>([]() { return true; }, CommandExecutor::Cosmetic);
+}
+
+int ControlBenchmark::run()
+{
+    printf("Control benchmark: %d rounds, seed %u, latency %d+%d us, error rate %.3f\n",
+           m_rounds, m_seed, m_latencyUs, m_jitterUs, m_errorRate);
+
+    SimulatedLepton *sim = new SimulatedLepton(m_seed);
+    sim->setLatency(m_latencyUs, m_jitterUs);
+    sim->setErrorRate(m_errorRate);
+
+    QElapsedTimer timer;
+    timer.start();
+    LeptonVariation *lepton = new LeptonVariation(sim);
+    qint64 constructed = timer.elapsed();
+    CommandExecutor *executor = lepton->executor();
+    drain(executor);
+    printf("Ready to stream after %lld ms, discovery done after %lld ms\n", constructed, timer.elapsed());
+    executor->resetMetrics();
+    lepton->commandStats()->reset();
+
+    // reads the way QML bindings do them, from this thread
+    const QMetaObject *meta = lepton->metaObject();
+    QElapsedTimer phase;
+    phase.start();
+    int reads = 0;
+    for (int round = 0; round < m_rounds; round++)
+    {
+        for (int i = meta->propertyOffset(); i < meta->propertyCount(); i++)
+        {
+            QMetaProperty prop = meta->property(i);
+            if (prop.isWritable())
+            {
+                prop.read(lepton);
+                reads++;
+            }
+        }
+    }
+    printf("%d attribute reads in %.2f ms\n", reads, phase.nsecsElapsed() / 1e6);
+
+    // slider drags: every write of a burst but the latest may be coalesced away
+    phase.restart();
+    quint64 coalescedBefore = executor->getCoalesced();
+    for (int round = 0; round < m_rounds; round++)
+    {
+        for (int i = 0; i < DRAG_WRITES; i++)
+            lepton->setProperty("agcHeqDampingFactor", (unsigned int)(round * DRAG_WRITES + i) % 256);
+        drain(executor);
+    }
+    printf("%d drags of %d writes in %.2f ms, %llu writes coalesced\n", m_rounds, DRAG_WRITES,
+           phase.nsecsElapsed() / 1e6, executor->getCoalesced() - coalescedBefore);
+
+    QVariantMap config = lepton->exportConfig();
+    phase.restart();
+    int verified = 0;
+    for (int round = 0; round < m_rounds; round++)
+    {
+        if (lepton->applyConfig(config))
+            verified++;
+    }
+    printf("%d configuration batches in %.2f ms, %d verified\n", m_rounds, phase.nsecsElapsed() / 1e6, verified);
+
+    phase.restart();
+    for (int round = 0; round < m_rounds; round++)
+    {
+        lepton->updateSpotmeter();
+        drain(executor);
+    }
+    printf("%d spotmeter polls in %.2f ms\n", m_rounds, phase.nsecsElapsed() / 1e6);
+
+    printf("Executor: %llu commands, latency %.2f ms average, %.2f ms max\n",
+           executor->getCompleted(), executor->getAverageLatencyMs(), executor->getMaxLatencyMs());
+    printf("Simulator: %llu transfers, %llu injected errors\n", sim->transfers(), sim->injectedErrors());
+    for (const QVariant &entry : lepton->commandStats()->snapshot(5))
+    {
+        QVariantMap command = entry.toMap();
+        printf("  %s: %d calls, %d cached, %d errors, %.3f ms\n", qPrintable(command["name"].toString()),
+               command["calls"].toInt(), command["cacheHits"].toInt(), command["errors"].toInt(),
+               command["meanMs"].toDouble());
+    }
+    if (!m_csvPath.isEmpty())
+        lepton->commandStats()->exportCsv(m_csvPath);
+
+    delete lepton;
+    return verified == m_rounds ? 0 : 1;
+}
@@ -9,6 +9,7 @@ const colormap_t colormap_ironblack = { {255, 255, 255, 253, 253, 253, 251, 251,
 
 DataFormatter::DataFormatter()
     : m_pseudocolor_palette(Palette::IronBlack)
+    , m_detailEnhancement(false)
 {
 }
 
@@ -25,6 +26,18 @@ const colormap_t* DataFormatter::getPalette(Palette palette)
     }
 }
 
+void DataFormatter::setDetailGain(float gain)
+{
+    m_dde.setGain(gain);
+    emit detailGainChanged(m_dde.gain());
+}
+
+void DataFormatter::setDetailRadius(int radius)
+{
+    m_dde.setRadius(radius);
+    emit detailRadiusChanged(m_dde.radius());
+}
+
 void DataFormatter::FindMinMax(const uvc_frame_t *input, QPoint &minPoint, uint16_t &minVal, QPoint &maxPoint, uint16_t &maxVal) const
 {
     uint8_t bytes_per_pixel = 0;
@@ -77,6 +90,11 @@ void DataFormatter::AutoGain(uvc_frame_t *input_output)
     uint16_t minval = 0, maxval = 0;
     QPoint minpoint, maxpoint;
     FindMinMax(input_output, minpoint, minval, maxpoint, maxval);
+
+    // the range stays that of the raw frame, enhanced detail clips at its ends
+    if (m_detailEnhancement)
+        m_dde.apply(input_output);
+
     FixedGain(input_output, minpoint, minval, maxpoint, maxval);
 
     /*
@@ -90,6 +108,14 @@ void DataFormatter::AutoGain(uvc_frame_t *input_output)
     */
 }
 
+void DataFormatter::AutoGain(uvc_frame_t *input_output, ushort minval, ushort maxval)
+{
+    if (m_detailEnhancement)
+        m_dde.apply(input_output);
+
+    FixedGain(input_output, m_minPoint, minval, m_maxPoint, maxval);
+}
+
 void DataFormatter::FixedGain(uvc_frame_t *input_output, QPoint minpoint, ushort minval, QPoint maxpoint, ushort maxval)
 {
     uint8_t bytes_per_pixel = 0;
@@ -122,7 +148,12 @@ void DataFormatter::FixedGain(uvc_frame_t *input_output, QPoint minpoint, ushort
                 val = *((uint16_t*)elem);
             }
 
-            val = (uint8_t)(((float)(val - minval) / (float)(maxval - minval)) * 255.0f);
+            if (val <= minval)
+                val = 0;
+            else if (val >= maxval)
+                val = 255;
+            else
+                val = (uint8_t)(((float)(val - minval) / (float)(maxval - minval)) * 255.0f);
 
             if (bytes_per_pixel == 1)
                 *((uint8_t*)elem) = val;
@@ -197,3 +228,19 @@ void DataFormatter::Colorize(const uvc_frame_t *input, QVideoFrame &output) cons
     }
     output.unmap();
 }
+
+bool DataFormatter::Colorize(const uvc_frame_t *input, QVideoFrame &output, RemapEngine &remap) const
+{
+    // we don't have a reason to handle frame buffers other than RGBA for now
+    Q_ASSERT(output.pixelFormat() == QVideoFrame::Format_RGB32);
+
+    if (input->frame_format != UVC_FRAME_FORMAT_Y16)
+        return false;
+
+    const uint8_t* palette = getPalette(m_pseudocolor_palette)->colormap;
+
+    output.map(QAbstractVideoBuffer::WriteOnly);
+    bool ok = remap.remapPalette(input, palette, output.bits(), output.size(), output.bytesPerLine());
+    output.unmap();
+    return ok;
+}
@@ -0,0 +1,128 @@
+#include "detailenhancer.h"
+#include "rowbands.h"
+
+#include <QtGlobal>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+DetailEnhancer::DetailEnhancer()
+    : m_radius(2)
+    , m_gain(2.5f)
+    , m_threaded(true)
+    , m_width(0)
+    , m_height(0)
+{
+}
+
+void DetailEnhancer::setRadius(int radius)
+{
+    m_radius = qBound(1, radius, MaxRadius);
+}
+
+static inline uint16_t *rowPtr(const uvc_frame_t *frame, int row)
+{
+    return (uint16_t*)((uint8_t*)frame->data + row * frame->step);
+}
+
+void DetailEnhancer::apply(uvc_frame_t *input_output)
+{
+    if (input_output->frame_format != UVC_FRAME_FORMAT_Y16)
+        return;
+
+    // the settings come from the GUI thread; both passes see the same ones
+    const int r = m_radius;
+    const float gain = m_gain;
+
+    m_width = input_output->width;
+    m_height = input_output->height;
+    if (m_width <= 2 * r || m_height <= 2 * r)
+        return;
+
+    m_rowSums.resize(m_width * m_height);
+
+    // the vertical pass of one band reads horizontal sums from its neighbours,
+    // so the first pass has to complete for the whole frame before the second
+    forEachRowBand(m_height, m_threaded, [this, input_output, r](int rowBegin, int rowEnd) {
+        horizontalPass(input_output, r, rowBegin, rowEnd);
+    });
+    forEachRowBand(m_height, m_threaded, [this, input_output, r, gain](int rowBegin, int rowEnd) {
+        verticalPass(input_output, r, gain, rowBegin, rowEnd);
+    });
+}
+
+void DetailEnhancer::horizontalPass(const uvc_frame_t *frame, int r, int rowBegin, int rowEnd)
+{
+    for (int i = rowBegin; i < rowEnd; i++)
+    {
+        const uint16_t *in = rowPtr(frame, i);
+        uint32_t *out = &m_rowSums[i * m_width];
+
+        uint32_t acc = 0;
+        for (int k = 0; k <= r; k++)
+            acc += in[k];
+
+        for (int j = 0; j < m_width; j++)
+        {
+            out[j] = acc;
+            if (j + r + 1 < m_width)
+                acc += in[j + r + 1];
+            if (j - r >= 0)
+                acc -= in[j - r];
+        }
+    }
+}
+
+void DetailEnhancer::verticalPass(uvc_frame_t *frame, int r, float gain, int rowBegin, int rowEnd)
+{
+    const int w = m_width;
+    const uint32_t *sums = m_rowSums.constData();
+
+    // pixels covered by the box in each column, which shrinks at the borders
+    QVector<float> colCount(w);
+    for (int j = 0; j < w; j++)
+        colCount[j] = qMin(j + r, w - 1) - qMax(j - r, 0) + 1;
+
+    QVector<uint32_t> colSums(w, 0);
+    uint32_t *acc = colSums.data();
+    for (int k = qMax(rowBegin - r, 0); k <= qMin(rowBegin + r, m_height - 1); k++)
+        for (int j = 0; j < w; j++)
+            acc[j] += sums[k * w + j];
+
+    for (int i = rowBegin; i < rowEnd; i++)
+    {
+        uint16_t *line = rowPtr(frame, i);
+        const float rowCount = qMin(i + r, m_height - 1) - qMax(i - r, 0) + 1;
+
+        for (int j = 0; j < w; j++)
+        {
+            float base = acc[j] / (colCount[j] * rowCount);
+            float val = base + gain * (line[j] - base);
+            line[j] = (uint16_t)qBound(0.0f, val + 0.5f, 65535.0f);
+        }
+
+        const uint32_t *add = (i + r + 1 < m_height) ? &sums[(i + r + 1) * w] : NULL;
+        const uint32_t *sub = (i - r >= 0) ? &sums[(i - r) * w] : NULL;
+        int j = 0;
+#if defined(__SSE2__)
+        if (add && sub)
+        {
+            for (; j + 4 <= w; j += 4)
+            {
+                __m128i v = _mm_loadu_si128((const __m128i*)&acc[j]);
+                v = _mm_add_epi32(v, _mm_loadu_si128((const __m128i*)&add[j]));
+                v = _mm_sub_epi32(v, _mm_loadu_si128((const __m128i*)&sub[j]));
+                _mm_storeu_si128((__m128i*)&acc[j], v);
+            }
+        }
+#endif
+        for (; j < w; j++)
+        {
+            if (add)
+                acc[j] += add[j];
+            if (sub)
+                acc[j] -= sub[j];
+        }
+    }
+}
@@ -0,0 +1,126 @@
+#include "duplicatedetector.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define PUBLISH_INTERVAL_MS 1000
+
+DuplicateDetector::DuplicateDetector()
+    : m_enabled(true)
+    , m_skipDuplicates(true)
+    , m_havePrevious(false)
+    , m_lastCounter(-1)
+    , m_lastHash(0)
+    , m_lastBytes(0)
+    , m_duplicateFrames(0)
+    , m_uniqueFrames(0)
+    , m_windowDuplicates(0)
+    , m_windowUnique(0)
+    , m_duplicateRate(0.0f)
+    , m_uniqueRate(0.0f)
+{
+}
+
+void DuplicateDetector::setSkipDuplicates(bool skip)
+{
+    if (m_skipDuplicates == skip)
+        return;
+    m_skipDuplicates = skip;
+    emit skipDuplicatesChanged(skip);
+}
+
+/* Fletcher-style checksum: a running sum of position-weighted bytes and a sum
+ * of those sums, so both content and ordering changes show up. Thermal
+ * frames always carry sensor noise, so any genuinely new frame differs in
+ * many places; this only has to be fast, not collision resistant. */
+quint64 DuplicateDetector::payloadHash(const uint8_t *data, size_t bytes)
+{
+    uint32_t s1 = 0, s2 = 0;
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i weights = _mm_setr_epi16(1, 2, 3, 4, 5, 6, 7, 8);
+    __m128i v1 = zero, v2 = zero;
+    for (; i + 16 <= bytes; i += 16)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i*)&data[i]);
+        __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(x, zero), weights);
+        __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(x, zero), weights);
+        v1 = _mm_add_epi32(v1, _mm_add_epi32(lo, _mm_slli_epi32(hi, 1)));
+        v2 = _mm_add_epi32(v2, v1);
+    }
+
+    uint32_t l1[4], l2[4];
+    _mm_storeu_si128((__m128i*)l1, v1);
+    _mm_storeu_si128((__m128i*)l2, v2);
+    for (int k = 0; k < 4; k++)
+    {
+        s1 = s1 * 31 + l1[k];
+        s2 = s2 * 31 + l2[k];
+    }
+#endif
+    for (; i < bytes; i++)
+    {
+        s1 += data[i] * (uint32_t)(i % 8 + 1);
+        s2 += s1;
+    }
+
+    return ((quint64)s2 << 32) | s1;
+}
+
+bool DuplicateDetector::check(const uvc_frame_t *frame, qint64 frameCounter)
+{
+    if (!m_enabled)
+        return false;
+
+    bool duplicate;
+    if (frameCounter >= 0)
+    {
+        duplicate = m_havePrevious && frameCounter == m_lastCounter;
+        m_lastCounter = frameCounter;
+    }
+    else
+    {
+        quint64 hash = payloadHash((const uint8_t*)frame->data, frame->data_bytes);
+        duplicate = m_havePrevious && hash == m_lastHash && frame->data_bytes == m_lastBytes;
+        m_lastHash = hash;
+        m_lastBytes = frame->data_bytes;
+    }
+    m_havePrevious = true;
+
+    count(duplicate);
+    return duplicate;
+}
+
+void DuplicateDetector::count(bool duplicate)
+{
+    if (duplicate)
+    {
+        m_duplicateFrames++;
+        m_windowDuplicates++;
+    }
+    else
+    {
+        m_uniqueFrames++;
+        m_windowUnique++;
+    }
+
+    if (!m_window.isValid())
+    {
+        m_window.start();
+        return;
+    }
+
+    qint64 elapsed = m_window.elapsed();
+    if (elapsed < PUBLISH_INTERVAL_MS)
+        return;
+
+    m_duplicateRate = m_windowDuplicates * 1000.0f / elapsed;
+    m_uniqueRate = m_windowUnique * 1000.0f / elapsed;
+    m_windowDuplicates = m_windowUnique = 0;
+    m_window.restart();
+
+    emit countersChanged();
+}
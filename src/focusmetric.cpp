@@ -0,0 +1,180 @@
+#include "focusmetric.h"
+
+#include <QMutexLocker>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+FocusMetric::FocusMetric()
+    : m_enabled(false)
+    , m_method(LaplacianVariance)
+    , m_score(0.0f)
+    , m_peakScore(0.0f)
+{
+}
+
+QRect FocusMetric::getRoi()
+{
+    QMutexLocker lock(&m_mutex);
+    return m_roi;
+}
+
+void FocusMetric::setRoi(const QRect &roi)
+{
+    {
+        QMutexLocker lock(&m_mutex);
+        if (m_roi == roi)
+            return;
+        m_roi = roi;
+    }
+    resetPeak();
+    emit roiChanged(roi);
+}
+
+float FocusMetric::getScore() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_score;
+}
+
+float FocusMetric::getPeakScore() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_peakScore;
+}
+
+void FocusMetric::resetPeak()
+{
+    float score;
+    {
+        QMutexLocker lock(&m_mutex);
+        m_peakScore = 0.0f;
+        score = m_score;
+    }
+    emit scoreChanged(score);
+}
+
+void FocusMetric::update(const uvc_frame_t *frame)
+{
+    if (!m_enabled || frame->frame_format != UVC_FRAME_FORMAT_Y16)
+        return;
+
+    // both kernels need a one pixel border
+    QRect bounds(1, 1, frame->width - 2, frame->height - 2);
+    QRect roi = getRoi();
+    roi = roi.isEmpty() ? bounds : roi.intersected(bounds);
+    if (roi.width() < 4 || roi.height() < 1)
+        return;
+
+    float score = (m_method == Tenengrad) ? tenengrad(frame, roi) : laplacianVariance(frame, roi);
+    {
+        QMutexLocker lock(&m_mutex);
+        m_score = score;
+        if (score > m_peakScore)
+            m_peakScore = score;
+    }
+
+    emit scoreChanged(score);
+}
+
+static inline const uint16_t *rowPtr(const uvc_frame_t *frame, int row)
+{
+    return (const uint16_t*)((const uint8_t*)frame->data + row * frame->step);
+}
+
+#if defined(__SSE2__)
+static inline __m128 load4(const uint16_t *p)
+{
+    __m128i raw = _mm_loadl_epi64((const __m128i*)p);
+    return _mm_cvtepi32_ps(_mm_unpacklo_epi16(raw, _mm_setzero_si128()));
+}
+
+static inline double hsum(__m128 v)
+{
+    float f[4];
+    _mm_storeu_ps(f, v);
+    return (double)f[0] + f[1] + f[2] + f[3];
+}
+#endif
+
+/* Variance of the 4-neighbour Laplacian over the ROI. */
+float FocusMetric::laplacianVariance(const uvc_frame_t *frame, const QRect &roi) const
+{
+    double sum = 0.0, sumSq = 0.0;
+
+    for (int i = roi.top(); i <= roi.bottom(); i++)
+    {
+        const uint16_t *up = rowPtr(frame, i - 1);
+        const uint16_t *mid = rowPtr(frame, i);
+        const uint16_t *down = rowPtr(frame, i + 1);
+        int j = roi.left();
+
+#if defined(__SSE2__)
+        const __m128 four = _mm_set1_ps(4.0f);
+        __m128 vsum = _mm_setzero_ps(), vsq = _mm_setzero_ps();
+        for (; j + 4 <= roi.right() + 1; j += 4)
+        {
+            __m128 lap = _mm_mul_ps(load4(&mid[j]), four);
+            lap = _mm_sub_ps(lap, load4(&up[j]));
+            lap = _mm_sub_ps(lap, load4(&down[j]));
+            lap = _mm_sub_ps(lap, load4(&mid[j - 1]));
+            lap = _mm_sub_ps(lap, load4(&mid[j + 1]));
+            vsum = _mm_add_ps(vsum, lap);
+            vsq = _mm_add_ps(vsq, _mm_mul_ps(lap, lap));
+        }
+        sum += hsum(vsum);
+        sumSq += hsum(vsq);
+#endif
+        for (; j <= roi.right(); j++)
+        {
+            float lap = 4.0f * mid[j] - up[j] - down[j] - mid[j - 1] - mid[j + 1];
+            sum += lap;
+            sumSq += lap * lap;
+        }
+    }
+
+    double n = (double)roi.width() * roi.height();
+    double mean = sum / n;
+    return (float)(sumSq / n - mean * mean);
+}
+
+/* Mean squared Sobel gradient magnitude over the ROI. */
+float FocusMetric::tenengrad(const uvc_frame_t *frame, const QRect &roi) const
+{
+    double sumSq = 0.0;
+
+    for (int i = roi.top(); i <= roi.bottom(); i++)
+    {
+        const uint16_t *up = rowPtr(frame, i - 1);
+        const uint16_t *mid = rowPtr(frame, i);
+        const uint16_t *down = rowPtr(frame, i + 1);
+        int j = roi.left();
+
+#if defined(__SSE2__)
+        const __m128 two = _mm_set1_ps(2.0f);
+        __m128 vsq = _mm_setzero_ps();
+        for (; j + 4 <= roi.right() + 1; j += 4)
+        {
+            __m128 ul = load4(&up[j - 1]), uc = load4(&up[j]), ur = load4(&up[j + 1]);
+            __m128 ml = load4(&mid[j - 1]), mr = load4(&mid[j + 1]);
+            __m128 dl = load4(&down[j - 1]), dc = load4(&down[j]), dr = load4(&down[j + 1]);
+
+            __m128 gx = _mm_sub_ps(_mm_add_ps(_mm_add_ps(ur, dr), _mm_mul_ps(mr, two)),
+                                   _mm_add_ps(_mm_add_ps(ul, dl), _mm_mul_ps(ml, two)));
+            __m128 gy = _mm_sub_ps(_mm_add_ps(_mm_add_ps(dl, dr), _mm_mul_ps(dc, two)),
+                                   _mm_add_ps(_mm_add_ps(ul, ur), _mm_mul_ps(uc, two)));
+            vsq = _mm_add_ps(vsq, _mm_add_ps(_mm_mul_ps(gx, gx), _mm_mul_ps(gy, gy)));
+        }
+        sumSq += hsum(vsq);
+#endif
+        for (; j <= roi.right(); j++)
+        {
+            float gx = (up[j + 1] + 2.0f * mid[j + 1] + down[j + 1]) - (up[j - 1] + 2.0f * mid[j - 1] + down[j - 1]);
+            float gy = (down[j - 1] + 2.0f * down[j] + down[j + 1]) - (up[j - 1] + 2.0f * up[j] + up[j + 1]);
+            sumSq += gx * gx + gy * gy;
+        }
+    }
+
+    return (float)(sumSq / ((double)roi.width() * roi.height()));
+}
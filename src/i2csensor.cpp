@@ -0,0 +1,61 @@
+#include "i2csensor.h"
+
+#include <stdio.h>
+
+// failures minus successes, floored at -ERROR_LIMIT, before giving up
+#define ERROR_LIMIT 5
+
+I2CSensor::I2CSensor(const QString &driver, uint8_t address, int pollInterval, QObject *parent)
+    : QObject(parent)
+    , m_driver(driver)
+    , m_address(address)
+    , m_pollInterval(pollInterval)
+    , m_available(false)
+    , m_errorScore(0)
+{
+}
+
+void I2CSensor::setPollInterval(int ms)
+{
+    ms = qMax(0, ms);
+    if (m_pollInterval == ms)
+        return;
+    m_pollInterval = ms;
+    emit pollIntervalChanged();
+}
+
+bool I2CSensor::noteResult(bool ok)
+{
+    if (ok)
+    {
+        m_errorScore = qMax(-ERROR_LIMIT, m_errorScore - 1);
+        return true;
+    }
+
+    if (++m_errorScore < ERROR_LIMIT)
+        return true;
+
+    printf("Giving up on %s at 0x%02x because there were too many errors.\n",
+           qPrintable(m_driver), m_address);
+    m_errorScore = 0;
+    publishAvailable(false);
+    return false;
+}
+
+void I2CSensor::publishAvailable(bool available)
+{
+    QMetaObject::invokeMethod(this, [this, available]() {
+        if (m_available == available)
+            return;
+        m_available = available;
+        emit availableChanged();
+    }, Qt::QueuedConnection);
+}
+
+void I2CSensor::publishValues(const QVariantMap &values)
+{
+    QMetaObject::invokeMethod(this, [this, values]() {
+        m_values = values;
+        emit valuesChanged();
+    }, Qt::QueuedConnection);
+}
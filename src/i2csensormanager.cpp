@@ -0,0 +1,305 @@
+#include "i2csensormanager.h"
+#include "mlx90614.h"
+
+#include <algorithm>
+#include <stdio.h>
+
+// granularity of the per-sensor poll intervals
+#define POLL_TICK_MS 100
+
+// MLX90614s are readdressed in EEPROM to put several on one bus
+#define MLX90614_FIRST_ADDRESS 0x5a
+#define MLX90614_ADDRESSES 4
+
+// reserved for 10-bit addressing; nothing should answer here
+#define UNUSED_ADDRESS 0x7c
+
+// 0x00..0x07 and 0x78..0x7f are reserved
+#define FIRST_SCAN_ADDRESS 0x08
+#define LAST_SCAN_ADDRESS 0x77
+
+I2CSensorManager::I2CSensorManager(I2CBus *bus, CommandExecutor *executor, QObject *parent)
+    : QObject(parent)
+    , m_bus(bus)
+    , m_executor(executor)
+    , m_pollTimer(new QTimer(this))
+{
+    for (int i = 0; i < MLX90614_ADDRESSES; i++)
+        addSensor(new Mlx90614(MLX90614_FIRST_ADDRESS + i, this));
+
+    m_clock.start();
+    // runs while there is something to poll
+    m_pollTimer->setInterval(POLL_TICK_MS);
+    connect(m_pollTimer, SIGNAL(timeout()), this, SLOT(tick()));
+}
+
+void I2CSensorManager::addSensor(I2CSensor *sensor)
+{
+    m_sensors.append(sensor);
+    m_keys.insert(sensor, QString("%1@0x%2").arg(sensor->getDriver()).arg(sensor->getAddress(), 2, 16, QChar('0')));
+    connect(sensor, &I2CSensor::availableChanged, this, &I2CSensorManager::sensorsChanged);
+    connect(sensor, &I2CSensor::availableChanged, this, &I2CSensorManager::updatePolling);
+    connect(sensor, &I2CSensor::valuesChanged, this, &I2CSensorManager::sensorValuesChanged);
+}
+
+QList<QObject*> I2CSensorManager::getSensors() const
+{
+    QList<QObject*> available;
+    for (I2CSensor *sensor : m_sensors)
+    {
+        if (sensor->isAvailable())
+            available.append(sensor);
+    }
+    return available;
+}
+
+void I2CSensorManager::updatePolling()
+{
+    if (getSensors().isEmpty())
+        m_pollTimer->stop();
+    else if (!m_pollTimer->isActive())
+        m_pollTimer->start();
+}
+
+I2CSensor *I2CSensorManager::find(const QString &driver) const
+{
+    for (I2CSensor *sensor : m_sensors)
+    {
+        if (sensor->isAvailable() && sensor->getDriver() == driver)
+            return sensor;
+    }
+    return NULL;
+}
+
+// a zero-length write: the device acknowledges its address or it doesn't
+LEP_RESULT I2CSensorManager::ping(uint8_t address, LEP_RESULT *i2cResult)
+{
+    uint8_t dummy;
+    return m_bus->i2cWriteRead(address, &dummy, 0, &dummy, -1, i2cResult);
+}
+
+void I2CSensorManager::probe()
+{
+    m_found.clear();
+    if (!m_bus->i2cAvailable())
+        return;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // an answer where there can't be a device means the bus is confused;
+    // play it safe and don't report sensors then
+    LEP_RESULT i2cResult;
+    if (ping(UNUSED_ADDRESS, &i2cResult) != LEP_OK)
+        return;
+    if (i2cResult == LEP_OK)
+    {
+        printf("Unexpected reply from I2C address 0x%02x, not looking for sensors\n", UNUSED_ADDRESS);
+        return;
+    }
+
+    // only the candidates' addresses are tried, each once
+    QHash<uint8_t, bool> answered;
+    for (I2CSensor *sensor : m_sensors)
+    {
+        uint8_t address = sensor->getAddress();
+        if (!answered.contains(address))
+        {
+            if (ping(address, &i2cResult) != LEP_OK)
+                return;
+            answered.insert(address, i2cResult == LEP_OK);
+        }
+
+        bool found = answered.value(address) && sensor->probe(m_bus);
+        if (found)
+            m_found.insert(m_keys.value(sensor), sensor->saveState());
+        sensor->publishAvailable(found);
+    }
+
+    printf("I2C sensors probed in %lld ms, %d found\n", timer.elapsed(), m_found.size());
+}
+
+QVariantMap I2CSensorManager::capabilities() const
+{
+    return m_found;
+}
+
+void I2CSensorManager::restore(const QVariantMap &capabilities)
+{
+    // the profile says what was there last time; whatever was unplugged
+    // since doesn't answer, and is left out
+    m_executor->post([this, capabilities]() {
+        m_found.clear();
+        if (!m_bus->i2cAvailable())
+            return;
+
+        for (I2CSensor *sensor : m_sensors)
+        {
+            QString key = m_keys.value(sensor);
+            if (!capabilities.contains(key))
+                continue;
+
+            LEP_RESULT i2cResult;
+            if (ping(sensor->getAddress(), &i2cResult) != LEP_OK || i2cResult != LEP_OK)
+            {
+                printf("%s from the capability profile doesn't answer\n", qPrintable(key));
+                continue;
+            }
+            sensor->restoreState(capabilities.value(key));
+            m_found.insert(key, capabilities.value(key));
+            sensor->publishAvailable(true);
+        }
+    });
+}
+
+void I2CSensorManager::tick()
+{
+    // skip a tick rather than queue up behind slow I2C reads
+    if (m_pollPending.loadAcquire())
+        return;
+
+    qint64 now = m_clock.elapsed();
+    QList<I2CSensor*> due;
+    for (I2CSensor *sensor : m_sensors)
+    {
+        if (!sensor->isAvailable())
+            continue;
+        if (m_lastPoll.contains(sensor) && now - m_lastPoll.value(sensor) < sensor->getPollInterval())
+            continue;
+        m_lastPoll[sensor] = now;
+        due.append(sensor);
+    }
+    if (due.isEmpty())
+        return;
+
+    m_pollPending.storeRelease(1);
+    m_executor->post([this, due]() {
+        poll(due);
+        m_pollPending.storeRelease(0);
+    }, CommandExecutor::Cosmetic);
+}
+
+void I2CSensorManager::poll(const QList<I2CSensor*> &due)
+{
+    for (I2CSensor *sensor : due)
+    {
+        QList<I2CSensor::Read> reads = sensor->reads();
+        QList<QByteArray> data;
+        QVariantMap values;
+        bool ok = readRegisters(sensor, reads, &data) && sensor->decode(reads, data, &values);
+        if (ok)
+            sensor->publishValues(values);
+        sensor->noteResult(ok);
+    }
+}
+
+/* One transaction per run of adjacent registers when the device
+ * auto-increments, otherwise one per read. data gets the bytes of each read,
+ * in the order of reads. */
+bool I2CSensorManager::readRegisters(I2CSensor *sensor, const QList<I2CSensor::Read> &reads, QList<QByteArray> *data)
+{
+    const bool merge = sensor->autoIncrement();
+    const int width = qMax(1, sensor->registerWidth());
+
+    QList<int> order;
+    for (int i = 0; i < reads.size(); i++)
+        order.append(i);
+    if (merge)
+    {
+        std::stable_sort(order.begin(), order.end(), [&reads](int a, int b) {
+            return reads[a].reg < reads[b].reg;
+        });
+    }
+
+    data->clear();
+    for (int i = 0; i < reads.size(); i++)
+        data->append(QByteArray());
+
+    for (int i = 0; i < order.size(); )
+    {
+        const I2CSensor::Read &first = reads[order[i]];
+        int length = first.length;
+        int end = i + 1;
+        while (merge && end < order.size())
+        {
+            const I2CSensor::Read &next = reads[order[end]];
+            if (length % width != 0 || next.reg != first.reg + length / width
+                    || length + next.length > I2CBus::MaxRead)
+                break;
+            length += next.length;
+            end++;
+        }
+
+        QByteArray buffer(length, 0);
+        LEP_RESULT i2cResult;
+        if (m_bus->i2cWriteRead(sensor->getAddress(), &first.reg, 1, buffer.data(), length, &i2cResult) != LEP_OK
+                || i2cResult != LEP_OK)
+            return false;
+
+        for (int offset = 0; i < end; i++)
+        {
+            int size = reads[order[i]].length;
+            (*data)[order[i]] = buffer.mid(offset, size);
+            offset += size;
+        }
+    }
+    return true;
+}
+
+void I2CSensorManager::scan()
+{
+    m_executor->post([this]() {
+        QVariantList addresses;
+        if (!m_bus->i2cAvailable())
+        {
+            printf("I2C for additional devices isn't supported by this firmware\n");
+            emit scanFinished(addresses);
+            return;
+        }
+
+        LEP_RESULT firstUnusual = LEP_OK;
+        for (int address = 0; address < 128; address++)
+        {
+            if (address % 16 == 0)
+                printf("%02x:", address);
+
+            if (address < FIRST_SCAN_ADDRESS || address > LAST_SCAN_ADDRESS)
+            {
+                printf("   ");
+            }
+            else
+            {
+                LEP_RESULT i2cResult;
+                if (ping(address, &i2cResult) != LEP_OK)
+                {
+                    printf("\nERROR in I2C scan\n");
+                    emit scanFinished(addresses);
+                    return;
+                }
+
+                if (i2cResult == LEP_OK)
+                {
+                    printf(" %02x", address);
+                    addresses.append(address);
+                }
+                else if (i2cResult == LEP_ERROR_I2C_NACK_RECEIVED)
+                {
+                    printf(" --");
+                }
+                else
+                {
+                    printf(" ??");
+                    if (firstUnusual == LEP_OK)
+                        firstUnusual = i2cResult;
+                }
+            }
+
+            if (address % 16 == 15)
+                printf("\n");
+        }
+
+        if (firstUnusual != LEP_OK)
+            printf("Result for first ?? is %d.\n", firstUnusual);
+        emit scanFinished(addresses);
+    });
+}
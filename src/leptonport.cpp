@@ -0,0 +1,56 @@
+#include "leptonport.h"
+
+#include <stdio.h>
+#include <string.h>
+
+UvcLeptonPort::UvcLeptonPort(uvc_device_t *dev, uvc_device_handle_t *devh)
+    : m_dev(dev)
+    , m_devh(devh)
+{
+}
+
+LeptonPort::Description UvcLeptonPort::describe()
+{
+    Description description;
+
+    uvc_device_descriptor_t *desc;
+    uvc_get_device_descriptor(m_dev, &desc);
+    printf("Using %s %s with firmware %s\n", desc->manufacturer, desc->product, desc->serialNumber);
+    description.vendorId = desc->idVendor;
+    description.productId = desc->idProduct;
+    description.manufacturer = QString::asprintf("%s", desc->manufacturer);
+    description.product = QString::asprintf("%s", desc->product);
+    description.usbSerial = QString::asprintf("%s", desc->serialNumber);
+    uvc_free_device_descriptor(desc);
+
+    description.genericI2C = false;
+    const uvc_extension_unit_t *units = uvc_get_extension_units(m_devh);
+    while (units)
+    {
+        printf("Found extension unit ID %d, controls: %08llx, GUID:", units->bUnitID, units->bmControls);
+        for (int i = 0; i < 16; i++)
+            printf(" %02x", units->guidExtensionCode[i]);
+        printf("\n");
+        if (units->bUnitID == VC_CONTROL_XU_LEP_CUST_ID && (units->bmControls & (1<<CUST_CONTROL_I2C_WRITEREAD)))
+            description.genericI2C = true;
+        units = units->next;
+    }
+
+    const uvc_format_desc_t *format = uvc_get_format_descs(m_devh);
+    if (format != NULL)
+        description.sensorSize = QSize(format->frame_descs[0].wWidth, format->frame_descs[0].wHeight);
+
+    // firmware that can stream telemetry offers a taller Y16 frame for it
+    for (const uvc_format_desc_t *fmt = uvc_get_format_descs(m_devh); fmt != NULL; fmt = fmt->next)
+    {
+        if (memcmp(fmt->fourccFormat, "Y16 ", 4) != 0)
+            continue;
+        for (const uvc_frame_desc_t *frame = fmt->frame_descs; frame != NULL; frame = frame->next)
+        {
+            if (frame->wWidth == description.sensorSize.width() && frame->wHeight > description.sensorSize.height())
+                description.telemetrySize = QSize(frame->wWidth, frame->wHeight);
+        }
+    }
+
+    return description;
+}
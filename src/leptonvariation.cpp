@@ -1,3 +1,5 @@
+#include <QElapsedTimer>
+#include <QMetaProperty>
 #include <QMutexLocker>
 #include <QTimer>
 #include "leptonvariation.h"
@@ -8,22 +10,6 @@
 #include "LEPTON_SYS.h"
 #include "LEPTON_VID.h"
 
-#define LEP_CID_AGC_MODULE (0x0100)
-#define LEP_CID_OEM_MODULE (0x0800)
-#define LEP_CID_RAD_MODULE (0x0E00)
-#define LEP_CID_SYS_MODULE (0x0200)
-#define LEP_CID_VID_MODULE (0x0300)
-
-typedef enum {
-  VC_CONTROL_XU_LEP_AGC_ID = 3,
-  VC_CONTROL_XU_LEP_OEM_ID,
-  VC_CONTROL_XU_LEP_RAD_ID,
-  VC_CONTROL_XU_LEP_SYS_ID,
-  VC_CONTROL_XU_LEP_VID_ID,
-  VC_CONTROL_XU_I2C_ID = 0x80,
-  VC_CONTROL_XU_LEP_CUST_ID = 0xfe,
-} VC_TERMINAL_ID;
-
 #define QML_REGISTER_ENUM(name) \
     qmlRegisterUncreatableType<LEP::QE_##name>("GetThermal", 1,0, "LEP_" #name, "You can't create enumeration " #name); \
     qRegisterMetaType<LEP::QE_##name::E>("LEP_" #name);
@@ -36,6 +22,7 @@ void registerLeptonVariationQmlTypes()
     QML_REGISTER_ENUM(AGC_ENABLE_E)
     QML_REGISTER_ENUM(AGC_POLICY_E)
     QML_REGISTER_ENUM(AGC_HEQ_SCALE_FACTOR_E)
+    QML_REGISTER_ENUM(RAD_ENABLE_E)
     QML_REGISTER_ENUM(RAD_TLINEAR_RESOLUTION_E)
     QML_REGISTER_ENUM(SYS_GAIN_MODE_E)
 }
@@ -43,15 +30,29 @@ void registerLeptonVariationQmlTypes()
 LeptonVariation::LeptonVariation(uvc_context_t *ctx,
                                  uvc_device_t *dev,
                                  uvc_device_handle_t *devh)
-    : ctx(ctx)
-    , dev(dev)
-    , devh(devh)
+    : LeptonVariation(new UvcLeptonPort(dev, devh))
+{
+    this->ctx = ctx;
+    this->dev = dev;
+    this->devh = devh;
+}
+
+LeptonVariation::LeptonVariation(LeptonPort *port)
+    : ctx(NULL)
+    , dev(NULL)
+    , devh(NULL)
+    , m_port(port)
     , m_mutex()
+    , m_spotmeterKelvinX100(0)
+    , m_periodicPending(0)
+    , m_prefetching(false)
 {
     printf("Initializing lepton SDK with UVC backend...\n");
 
-    uvc_get_device_descriptor(dev, &desc);
-    printf("Using %s %s with firmware %s\n", desc->manufacturer, desc->product, desc->serialNumber);
+    QElapsedTimer timer;
+    timer.start();
+
+    commandStats()->setNamer(&LeptonVariation::commandName);
 
     m_portDesc.portID = 0;
     m_portDesc.portType = LEP_CCI_UVC;
@@ -62,34 +63,54 @@ LeptonVariation::LeptonVariation(uvc_context_t *ctx,
                  &m_portDesc);
     printf("OK\n");
 
-    supportsGenericI2C = false;
-    const uvc_extension_unit_t *units = uvc_get_extension_units(devh);
-    while (units)
-    {
-        printf("Found extension unit ID %d, controls: %08llx, GUID:", units->bUnitID, units->bmControls);
-        for (int i = 0; i < 16; i++)
-            printf(" %02x", units->guidExtensionCode[i]);
-        printf("\n");
-        if (units->bUnitID == 0xfe && (units->bmControls & (1<<6)))
-            supportsGenericI2C = true;
-        units = units->next;
-    }
+    m_description = m_port->describe();
+    supportsGenericI2C = m_description.genericI2C;
+    m_sensorSize = m_description.sensorSize;
+    m_telemetrySize = m_description.telemetrySize;
 
-    const uvc_format_desc_t *desc = uvc_get_format_descs(devh);
-    while (desc != NULL)
+    m_telemetryEnabled = false;
+    if (m_telemetrySize.isValid())
     {
-        int width, height;
-        width = desc->frame_descs[0].wWidth;
-        height = desc->frame_descs[0].wHeight;
-        m_sensorSize = QSize(width, height);
-        break;
+        LEP_SYS_TELEMETRY_ENABLE_STATE_E telemetryState;
+        LEP_SYS_TELEMETRY_LOCATION_E telemetryLocation;
+        if (LEP_GetSysTelemetryEnableState(&m_portDesc, &telemetryState) == LEP_OK
+                && LEP_GetSysTelemetryLocation(&m_portDesc, &telemetryLocation) == LEP_OK)
+        {
+            m_telemetryEnabled = (telemetryState == LEP_TELEMETRY_ENABLED
+                                  && telemetryLocation == LEP_TELEMETRY_LOCATION_FOOTER);
+        }
+        printf("Telemetry frame %dx%d available, enabled: %d\n",
+               m_telemetrySize.width(), m_telemetrySize.height(), m_telemetryEnabled);
     }
 
-    LEP_GetOemSoftwareVersion(&m_portDesc, &swVers);
-    LEP_GetOemFlirPartNumber(&m_portDesc, &partNumber);
+    memset(&swVers, 0, sizeof(swVers));
+    memset(&m_spotmeterRoi, 0, sizeof(m_spotmeterRoi));
+
+    m_i2cSensors = new I2CSensorManager(this, executor(), this);
+    connect(m_i2cSensors, &I2CSensorManager::sensorsChanged, this, &LeptonVariation::irThermometerAvailableChanged);
+    connect(m_i2cSensors, &I2CSensorManager::sensorValuesChanged, this, &LeptonVariation::irThermometerInKelvinChanged);
+    connect(m_i2cSensors, &I2CSensorManager::sensorValuesChanged, this, &LeptonVariation::irThermometerAmbientInKelvinChanged);
+
+    // a profile from an earlier run is kept per Lepton, by its serial
+    // number, and holds as long as the board firmware (the USB serial
+    // string on PureThermal) hasn't changed
     serialNumber = pget<uint64_t, uint64_t>(LEP_GetSysFlirSerialNumber);
+    m_capabilities = new CapabilityCache(m_description.vendorId, m_description.productId,
+                                         QString::asprintf("%016llx", (unsigned long long)serialNumber));
+    bool warm = serialNumber != 0 && !m_capabilities->isEmpty()
+            && m_capabilities->value("serialNumber").toULongLong() == serialNumber
+            && m_capabilities->value("boardFirmware").toString() == m_description.usbSerial
+            && loadCapabilities();
+    if (!warm)
+    {
+        // the default format depends on the part number; the rest waits
+        // until the stream is running
+        m_capabilities->clear();
+        LEP_GetOemFlirPartNumber(&m_portDesc, &partNumber);
+    }
+    printf("Capability profile %s\n", warm ? "loaded" : "not usable, rediscovering");
 
-    LEP_GetRadSpotmeterRoi(&m_portDesc, &m_spotmeterRoi);
+    updateSupports();
 
     this->setObjectName("LeptonVariation");
 
@@ -98,13 +119,89 @@ LeptonVariation::LeptonVariation(uvc_context_t *ctx,
     m_periodicTimer->start(1000);
 
     printf("I2C for additional devices supported by firmware: %d\n", supportsGenericI2C);
+    printf("Lepton ready for streaming after %lld ms\n", timer.elapsed());
+
+    discover(warm);
+}
+
+/* Identity, the spotmeter ROI, the attribute cache and the I2C sensor probe
+ * aren't needed to start streaming. They're queued on the executor as
+ * separate steps, so user writes can get in between, and each reports when
+ * it's done. With a usable capability profile, identity and the probe are
+ * already known. */
+void LeptonVariation::discover(bool warm)
+{
+    if (!warm)
+    {
+        executor()->post([this]() {
+            QElapsedTimer timer;
+            timer.start();
+            {
+                QMutexLocker lock(&m_mutex);
+                LEP_GetOemSoftwareVersion(&m_portDesc, &swVers);
+            }
+            printf("Lepton identity read in %lld ms\n", timer.elapsed());
+            emit identityChanged();
+        });
+    }
 
-    EnumerateMLX90614();
+    executor()->post([this]() {
+        LEP_RAD_ROI_T roi;
+        if (LEP_GetRadSpotmeterRoi(&m_portDesc, &roi) != LEP_OK)
+            return;
+
+        // the ROI itself is only touched on the GUI thread
+        QMetaObject::invokeMethod(this, [this, roi]() {
+            m_spotmeterRoi = roi;
+            emit radSpotmeterRoiChanged();
+        }, Qt::QueuedConnection);
+    });
+
+    executor()->post([this]() { prefetchAttributes(); });
+
+    if (!warm)
+    {
+        executor()->post([this]() {
+            m_i2cSensors->probe();
+            saveCapabilities();
+        });
+    }
+}
+
+bool LeptonVariation::loadCapabilities()
+{
+    QByteArray part = m_capabilities->value("partNumber").toByteArray();
+    QByteArray version = m_capabilities->value("softwareVersion").toByteArray();
+    if (part.size() != sizeof(partNumber.value) || version.size() != sizeof(swVers)
+            || !m_capabilities->contains("i2cSensors"))
+        return false;
+
+    memcpy(partNumber.value, part.constData(), part.size());
+    memcpy(&swVers, version.constData(), version.size());
+    m_i2cSensors->restore(m_capabilities->value("i2cSensors").toMap());
+    return true;
+}
+
+void LeptonVariation::saveCapabilities()
+{
+    // without a serial number there is nothing to tell this Lepton by
+    if (serialNumber == 0)
+        return;
+
+    QMutexLocker lock(&m_mutex);
+    m_capabilities->setValue("serialNumber", (qulonglong)serialNumber);
+    m_capabilities->setValue("boardFirmware", m_description.usbSerial);
+    m_capabilities->setValue("partNumber", QByteArray(partNumber.value, sizeof(partNumber.value)));
+    m_capabilities->setValue("softwareVersion", QByteArray((const char*)&swVers, sizeof(swVers)));
+    m_capabilities->setValue("i2cSensors", m_i2cSensors->capabilities());
+    m_capabilities->save();
 }
 
 LeptonVariation::~LeptonVariation()
 {
-    uvc_free_device_descriptor(desc);
+    shutdownWorkers();
+    delete m_capabilities;
+    delete m_port;
 }
 
 const AbstractCCInterface& LeptonVariation::operator =(const AbstractCCInterface&)
@@ -114,6 +211,7 @@ const AbstractCCInterface& LeptonVariation::operator =(const AbstractCCInterface
 
 const QString LeptonVariation::getSysFlirSerialNumber()
 {
+    QMutexLocker lock(&m_mutex);
     return QString::asprintf("%08llx", serialNumber);
 }
 
@@ -127,43 +225,42 @@ const QString LeptonVariation::getOemFlirPartNumber()
 
 const QString LeptonVariation::getOemGppSoftwareVersion()
 {
+    QMutexLocker lock(&m_mutex);
     return QString::asprintf("%d.%d.%d", swVers.gpp_major, swVers.gpp_minor, swVers.gpp_build);
 }
 
 const QString LeptonVariation::getOemDspSoftwareVersion()
 {
+    QMutexLocker lock(&m_mutex);
     return QString::asprintf("%d.%d.%d", swVers.dsp_major, swVers.dsp_minor, swVers.dsp_build);
 }
 
 const QString LeptonVariation::getPtFirmwareVersion() const
 {
-    return QString::asprintf("%s", desc->serialNumber);
+    return m_description.usbSerial;
 }
 
-bool LeptonVariation::getSupportsHwPseudoColor() const
+// the firmware string and part number don't change while the device is
+// open, so QML bindings get these without reparsing
+void LeptonVariation::updateSupports()
 {
-    return getSupportsRuntimeAgcChange() || !getPtFirmwareVersion().contains("Y16");
-}
+    const QString firmware = getPtFirmwareVersion();
+    const QString part = getOemFlirPartNumber();
 
-bool LeptonVariation::getSupportsRadiometry()
-{
-    bool runtimeAgc = getSupportsRuntimeAgcChange();
-    bool y16Firmware = getPtFirmwareVersion().contains("Y16");
-    bool radiometricLepton = getOemFlirPartNumber().contains("500-0763-01")
-            || getOemFlirPartNumber().contains("500-0771-01");
-    return (runtimeAgc || y16Firmware) && radiometricLepton;
-}
+    m_supportsRuntimeAgcChange = !firmware.startsWith("v0");
+    m_supportsHwPseudoColor = m_supportsRuntimeAgcChange || !firmware.contains("Y16");
 
-bool LeptonVariation::getSupportsRuntimeAgcChange() const
-{
-    return !getPtFirmwareVersion().startsWith("v0");
+    bool y16Firmware = firmware.contains("Y16");
+    bool radiometricLepton = part.contains("500-0763-01") || part.contains("500-0771-01");
+    m_supportsRadiometry = (m_supportsRuntimeAgcChange || y16Firmware) && radiometricLepton;
 }
 
 const QVideoSurfaceFormat LeptonVariation::getDefaultFormat()
 {
     if (!getSupportsHwPseudoColor() || getSupportsRadiometry())
     {
-        return QVideoSurfaceFormat(m_sensorSize, QVideoFrame::Format_Y16);
+        return QVideoSurfaceFormat(m_telemetryEnabled ? m_telemetrySize : m_sensorSize,
+                                   QVideoFrame::Format_Y16);
     }
     else
     {
@@ -171,30 +268,197 @@ const QVideoSurfaceFormat LeptonVariation::getDefaultFormat()
     }
 }
 
-void LeptonVariation::updateSpotmeter()
+const QVideoSurfaceFormat LeptonVariation::getCameraColorFormat()
+{
+    if (!getSupportsHwPseudoColor())
+        return QVideoSurfaceFormat();
+
+    // the firmware switches the Lepton to RGB888 along with the UVC format
+    return QVideoSurfaceFormat(m_sensorSize, QVideoFrame::Format_RGB24);
+}
+
+bool LeptonVariation::uploadPalette(const QByteArray &rgb)
 {
-    emit radSpotmeterInKelvinX100Changed();
+    if (rgb.size() != 256 * 3 || !getSupportsHwPseudoColor())
+        return false;
 
-    if (hasMLX90614)
+    LEP_VID_LUT_BUFFER_T lut;
+    const uint8_t *src = (const uint8_t*)rgb.constData();
+    for (int i = 0; i < 256; i++)
     {
-        if (ReadMLX90614AmbientTemperature(NULL, &ambientTemperatureMLX90614) == LEP_OK
-            && ReadMLX90614ObjectTemperature(NULL, &objectTemperatureMLX90614) == LEP_OK)
+        lut.bin[i].reserved = 0;
+        lut.bin[i].red = src[i * 3 + 0];
+        lut.bin[i].green = src[i * 3 + 1];
+        lut.bin[i].blue = src[i * 3 + 2];
+    }
+
+    {
+        QMutexLocker lock(&m_mutex);
+        if (LEP_SetVidUserLut(&m_portDesc, &lut) != LEP_OK
+                || LEP_SetVidPcolorLut(&m_portDesc, LEP_VID_USER_LUT) != LEP_OK)
         {
-            printf("MLX90614 reports %.2f °C (ambient) and %.2f °C (object)\n",
-                ambientTemperatureMLX90614 - 273.15, objectTemperatureMLX90614 - 273.15);
-            emit irThermometerInKelvinChanged();
-            emit irThermometerAmbientInKelvinChanged();
+            printf("Cannot upload the palette to the user LUT\n");
+            return false;
         }
     }
+    emit vidPcolorLutChanged(PCOLOR_LUT_E::LEP_VID_USER_LUT);
+    return true;
 }
 
-unsigned int LeptonVariation::getRadSpotmeterObjInKelvinX100()
+bool LeptonVariation::getSceneStats(SceneStats *out)
 {
-    LEP_RAD_SPOTMETER_OBJ_KELVIN_T spotmeterObj;
-    if (LEP_GetRadSpotmeterObjInKelvinX100(&m_portDesc, &spotmeterObj) == LEP_OK)
-        return spotmeterObj.radSpotmeterValue;
-    else
+    QMutexLocker lock(&m_mutex);
+
+    LEP_SYS_SCENE_STATISTICS_T scene;
+    LEP_SYS_VIDEO_ROI_T sceneRoi;
+    if (LEP_GetSysSceneStatistics(&m_portDesc, &scene) == LEP_OK
+            && LEP_GetSysSceneRoi(&m_portDesc, &sceneRoi) == LEP_OK)
+    {
+        out->minVal = scene.minIntensity;
+        out->maxVal = scene.maxIntensity;
+        out->meanVal = scene.meanIntensity;
+        out->roi = QRect(QPoint(sceneRoi.startCol, sceneRoi.startRow), QPoint(sceneRoi.endCol, sceneRoi.endRow));
+        return true;
+    }
+
+    // the AGC keeps the same numbers for its histogram ROI
+    LEP_AGC_HISTOGRAM_STATISTICS_T histogram;
+    LEP_AGC_ROI_T agcRoi;
+    if (LEP_GetAgcHistogramStatistics(&m_portDesc, (LEP_AGC_HISTOGRAM_STATISTICS_T_PTR*)&histogram) == LEP_OK
+            && LEP_GetAgcROI(&m_portDesc, &agcRoi) == LEP_OK)
+    {
+        out->minVal = histogram.minIntensity;
+        out->maxVal = histogram.maxIntensity;
+        out->meanVal = histogram.meanIntensity;
+        out->roi = QRect(QPoint(agcRoi.startCol, agcRoi.startRow), QPoint(agcRoi.endCol, agcRoi.endRow));
+        return true;
+    }
+
+    return false;
+}
+
+void LeptonVariation::setTelemetryEnabled(bool enabled)
+{
+    if (enabled == m_telemetryEnabled)
+        return;
+
+    if (enabled && !m_telemetrySize.isValid())
+    {
+        printf("Telemetry isn't supported by this firmware\n");
+        return;
+    }
+
+    // the camera is told on the executor; the state and the stream follow on
+    // the GUI thread once it has it
+    executor()->post([this, enabled]() {
+        // the footer keeps the image rows where they are
+        if (LEP_SetSysTelemetryLocation(&m_portDesc, LEP_TELEMETRY_LOCATION_FOOTER) != LEP_OK
+                || LEP_SetSysTelemetryEnableState(&m_portDesc, enabled ? LEP_TELEMETRY_ENABLED : LEP_TELEMETRY_DISABLED) != LEP_OK)
+        {
+            printf("LEP_SetSysTelemetryEnableState failed\n");
+            return;
+        }
+
+        QMetaObject::invokeMethod(this, [this, enabled]() {
+            if (m_telemetryEnabled == enabled)
+                return;
+            m_telemetryEnabled = enabled;
+            emit telemetryChanged(enabled);
+        }, Qt::QueuedConnection);
+    });
+}
+
+int LeptonVariation::getTelemetryRows() const
+{
+    if (!m_telemetryEnabled)
         return 0;
+    return m_telemetrySize.height() - m_sensorSize.height();
+}
+
+/* Telemetry row A word offsets, from the Lepton engineering datasheet. The
+ * rows form one contiguous block of words: on 160 pixel wide modules rows A
+ * and B share the first video row. 32-bit values are sent LSW first. */
+#define TLM_REVISION            0
+#define TLM_TIME_COUNTER        1
+#define TLM_STATUS              3
+#define TLM_FRAME_COUNTER       20
+#define TLM_FPA_TEMP_KX100      24
+#define TLM_HOUSING_TEMP_KX100  26
+#define TLM_ROW_A_WORDS         80
+
+#define TLM_STATUS_FFC_DESIRED  (1 << 3)
+#define TLM_STATUS_FFC_SHIFT    4
+#define TLM_STATUS_AGC_ENABLED  (1 << 12)
+
+static inline quint32 telemetryWord32(const uint16_t *words, int index)
+{
+    return (quint32)words[index] | ((quint32)words[index + 1] << 16);
+}
+
+bool LeptonVariation::parseTelemetry(const uint8_t *data, int width, int rows, int step, FrameTelemetry *out)
+{
+    // row A must be in one piece; true for both 80 and 160 wide frames
+    if (rows < 1 || width * rows < TLM_ROW_A_WORDS || (width < TLM_ROW_A_WORDS && step != width * 2))
+        return false;
+
+    const uint16_t *words = (const uint16_t*)data;
+    if (words[TLM_REVISION] == 0)
+        return false;
+
+    quint32 status = telemetryWord32(words, TLM_STATUS);
+    static const FrameTelemetry::FfcState ffcStates[] = {
+        FrameTelemetry::FfcNeverCommanded,
+        FrameTelemetry::FfcImminent,
+        FrameTelemetry::FfcInProgress,
+        FrameTelemetry::FfcComplete,
+    };
+
+    out->valid = true;
+    out->uptimeMs = telemetryWord32(words, TLM_TIME_COUNTER);
+    out->frameCounter = telemetryWord32(words, TLM_FRAME_COUNTER);
+    out->fpaTempKelvin = words[TLM_FPA_TEMP_KX100] / 100.0f;
+    out->housingTempKelvin = words[TLM_HOUSING_TEMP_KX100] / 100.0f;
+    out->ffcState = ffcStates[(status >> TLM_STATUS_FFC_SHIFT) & 0x3];
+    out->ffcDesired = (status & TLM_STATUS_FFC_DESIRED) != 0;
+    out->agcEnabled = (status & TLM_STATUS_AGC_ENABLED) != 0;
+    return true;
+}
+
+void LeptonVariation::updateSpotmeter()
+{
+    // skip a tick rather than queue up behind slow reads
+    if (!m_periodicPending.testAndSetOrdered(0, 1))
+        return;
+
+    executor()->post([this]() {
+        LEP_RAD_SPOTMETER_OBJ_KELVIN_T spotmeterObj;
+        if (getSupportsRadiometry()
+                && LEP_GetRadSpotmeterObjInKelvinX100(&m_portDesc, &spotmeterObj) == LEP_OK)
+        {
+            m_spotmeterKelvinX100.store(spotmeterObj.radSpotmeterValue);
+            emit radSpotmeterInKelvinX100Changed();
+        }
+
+        m_periodicPending.storeRelease(0);
+    }, CommandExecutor::Cosmetic);
+}
+
+float LeptonVariation::getIrThermometerInKelvin()
+{
+    I2CSensor *sensor = m_i2cSensors->find("MLX90614");
+    return sensor ? sensor->getValues().value("object", -300).toFloat() : -300;
+}
+
+float LeptonVariation::getIrThermometerAmbientInKelvin()
+{
+    I2CSensor *sensor = m_i2cSensors->find("MLX90614");
+    return sensor ? sensor->getValues().value("ambient", -300).toFloat() : -300;
+}
+
+unsigned int LeptonVariation::getRadSpotmeterObjInKelvinX100()
+{
+    // refreshed by updateSpotmeter on the executor
+    return (unsigned int)m_spotmeterKelvinX100.load();
 }
 
 void LeptonVariation::setRadSpotmeterRoi(const QRect& roi)
@@ -206,20 +470,123 @@ void LeptonVariation::setRadSpotmeterRoi(const QRect& roi)
         static_cast<unsigned short>(roi.x() + roi.width())
     };
 
-    if (LEP_SetRadSpotmeterRoi(&m_portDesc, newSpot) != LEP_OK) {
-        printf("LEP_SetRadSpotmeterRoi failed");
-        return;
-    }
-
+    // the UI follows the pointer right away; the camera gets the newest
+    // ROI at most once per minWriteInterval while it is being dragged
     m_spotmeterRoi = newSpot;
     emit radSpotmeterRoiChanged();
-    emit radSpotmeterInKelvinX100Changed();
+
+    executor()->postCoalesced(reinterpret_cast<quintptr>(&LEP_SetRadSpotmeterRoi), [this, newSpot]() {
+        if (LEP_SetRadSpotmeterRoi(&m_portDesc, newSpot) != LEP_OK) {
+            printf("LEP_SetRadSpotmeterRoi failed");
+
+            // put the UI back to what the camera is actually using; the ROI
+            // itself is only touched on the GUI thread
+            LEP_RAD_ROI_T current;
+            if (LEP_GetRadSpotmeterRoi(&m_portDesc, &current) == LEP_OK) {
+                QMetaObject::invokeMethod(this, [this, current]() {
+                    m_spotmeterRoi = current;
+                    emit radSpotmeterRoiChanged();
+                }, Qt::QueuedConnection);
+            }
+            return;
+        }
+
+        updateSpotmeter();
+    });
 }
 
-void LeptonVariation::performFfc()
+bool LeptonVariation::startFfc()
 {
     //LEP_RunOemFFC(&m_portDesc);
-    LEP_RunSysFFCNormalization(&m_portDesc);
+    return LEP_RunSysFFCNormalization(&m_portDesc) == LEP_OK;
+}
+
+bool LeptonVariation::queryFfcInProgress()
+{
+    LEP_SYS_STATUS_E status;
+    if (LEP_GetSysFFCStatus(&m_portDesc, &status) != LEP_OK)
+        return false;
+    return status == LEP_SYS_STATUS_BUSY;
+}
+
+// the ROI is a view setting and goes with the layout, not the camera
+bool LeptonVariation::isConfigAttribute(const QString &name) const
+{
+    return name != "radSpotmeterRoi";
+}
+
+// the gain mode selects which AGC and RAD parameter set is live, so it is
+// written before them
+int LeptonVariation::attributePhase(const QString &name) const
+{
+    return name == "sysGainMode" ? -1 : 0;
+}
+
+/* Reads every settable property once, which fills the attribute cache so that
+ * QML bindings are served from memory instead of a control transfer each. */
+void LeptonVariation::prefetchAttributes()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    // locked per attribute, so reads from the GUI can get in between
+    {
+        QMutexLocker lock(&m_mutex);
+        m_prefetching = true;
+    }
+
+    const QMetaObject *meta = metaObject();
+    for (int i = meta->propertyOffset(); i < meta->propertyCount(); i++)
+    {
+        QMetaProperty prop = meta->property(i);
+        if (prop.isWritable())
+        {
+            QMutexLocker lock(&m_mutex);
+            prop.read(this);
+        }
+    }
+
+    QMutexLocker lock(&m_mutex);
+    m_prefetching = false;
+    printf("Prefetched %d attributes in %lld ms\n", m_attributeCache.size(), timer.elapsed());
+}
+
+void LeptonVariation::invalidateAttributes(int module)
+{
+    QMutexLocker lock(&m_mutex);
+    for (auto it = m_attributeCache.begin(); it != m_attributeCache.end(); ++it)
+    {
+        if (module < 0 || (it.key() & 0x3f00) == module)
+            it->valid = false;
+    }
+}
+
+void LeptonVariation::refreshAttributes()
+{
+    // re-read on the executor; the GUI is told once the cache has the values
+    executor()->post([this]() {
+        invalidateAttributes();
+        prefetchAttributes();
+        QMetaObject::invokeMethod(this, [this]() { notifyAttributes(); }, Qt::QueuedConnection);
+    });
+}
+
+void LeptonVariation::notifyAttributes()
+{
+    const QMetaObject *meta = metaObject();
+    for (int i = meta->propertyOffset(); i < meta->propertyCount(); i++)
+    {
+        QMetaProperty prop = meta->property(i);
+        if (!prop.isWritable() || !prop.hasNotifySignal())
+            continue;
+
+        QVariant value = prop.read(this);
+        QMetaMethod notify = prop.notifySignal();
+        if (notify.parameterCount() == 1)
+            notify.invoke(this, Qt::DirectConnection, QGenericArgument(value.typeName(), value.constData()));
+        else
+            notify.invoke(this, Qt::DirectConnection);
+    }
 }
 
 int LeptonVariation::leptonCommandIdToUnitId(LEP_COMMAND_ID commandID)
@@ -272,14 +639,30 @@ LEP_RESULT LeptonVariation::UVC_GetAttribute(LEP_COMMAND_ID commandID,
     // Size in 16-bit words needs to be in bytes
     attributeWordLength *= 2;
 
+    const int key = commandID & ~0x3;
+
     QMutexLocker lock(&m_mutex);
-    result = uvc_get_ctrl(devh, unit_id, control_id, attributePtr, attributeWordLength, UVC_GET_CUR);
+    auto cached = m_attributeCache.constFind(key);
+    if (cached != m_attributeCache.constEnd() && cached->valid && cached->data.size() == attributeWordLength)
+    {
+        memcpy(attributePtr, cached->data.constData(), attributeWordLength);
+        commandStats()->recordCacheHit(commandID);
+        return LEP_OK;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    result = m_port->getCtrl(unit_id, control_id, attributePtr, attributeWordLength);
+    commandStats()->recordCall(commandID, result == attributeWordLength, timer.nsecsElapsed());
     if (result != attributeWordLength)
     {
         printf("UVC_GetAttribute failed: %d\n", result);
         return LEP_COMM_ERROR_READING_COMM;
     }
 
+    if (m_prefetching || cached != m_attributeCache.constEnd())
+        m_attributeCache[key] = { QByteArray((const char*)attributePtr, attributeWordLength), true };
+
     return LEP_OK;
 }
 
@@ -300,14 +683,30 @@ LEP_RESULT LeptonVariation::UVC_SetAttribute(LEP_COMMAND_ID commandID,
     // Size in 16-bit words needs to be in bytes
     attributeWordLength *= 2;
 
+    const int key = commandID & ~0x3;
+
     QMutexLocker lock(&m_mutex);
-    result = uvc_set_ctrl(devh, unit_id, control_id, attributePtr, attributeWordLength);
+    QElapsedTimer timer;
+    timer.start();
+    result = m_port->setCtrl(unit_id, control_id, attributePtr, attributeWordLength);
+    commandStats()->recordCall(commandID, result == attributeWordLength, timer.nsecsElapsed());
     if (result != attributeWordLength)
     {
         printf("UVC_SetAttribute failed: %d\n", result);
+        m_attributeCache.remove(key);
         return LEP_COMM_ERROR_READING_COMM;
     }
 
+    // the gain mode switches the camera to another set of AGC and
+    // radiometry parameters
+    if (key == LEP_CID_SYS_GAIN_MODE)
+    {
+        invalidateAttributes(LEP_CID_AGC_MODULE);
+        invalidateAttributes(LEP_CID_RAD_MODULE);
+    }
+
+    m_attributeCache[key] = { QByteArray((const char*)attributePtr, attributeWordLength), true };
+
     return LEP_OK;
 }
 
@@ -324,7 +723,14 @@ LEP_RESULT LeptonVariation::UVC_RunCommand(LEP_COMMAND_ID commandID)
     control_id = ((commandID & 0x00ff) >> 2) + 1;
 
     QMutexLocker lock(&m_mutex);
-    result = uvc_set_ctrl(devh, unit_id, control_id, &control_id, 1);
+    QElapsedTimer timer;
+    timer.start();
+    result = m_port->setCtrl(unit_id, control_id, &control_id, 1);
+    commandStats()->recordCall(commandID, result == 1, timer.nsecsElapsed());
+
+    // FFC, defaults restore and the like can change any attribute
+    invalidateAttributes();
+
     if (result != 1)
     {
         printf("UVC_RunCommand failed: %d\n", result);
@@ -334,16 +740,30 @@ LEP_RESULT LeptonVariation::UVC_RunCommand(LEP_COMMAND_ID commandID)
     return LEP_OK;
 }
 
-enum CUST_COMTROL_IDS {
-	CUST_CONTROL_COMMAND=0,
-	CUST_CONTROL_GET,
-	CUST_CONTROL_SET,
-	CUST_CONTROL_RUN,
-	CUST_CONTROL_DIRECT_WRITE,
-	CUST_CONTROL_DIRECT_READ,
-    CUST_CONTROL_I2C_WRITEREAD,
-	CUST_CONTROL_END
-};
+// the custom XU has no LEP_COMMAND_ID; its stats go under these
+#define CUSTOM_STATS_ID(control) (0x10000 | (control))
+
+QString LeptonVariation::commandName(quint32 id)
+{
+    if (id == CUSTOM_STATS_ID(CUST_CONTROL_COMMAND))
+        return "CUST command";
+    if (id == CUSTOM_STATS_ID(CUST_CONTROL_I2C_WRITEREAD))
+        return "CUST I2C write/read";
+
+    const char *module;
+    switch (id & 0x3f00)
+    {
+    case LEP_CID_AGC_MODULE: module = "AGC"; break;
+    case LEP_CID_OEM_MODULE: module = "OEM"; break;
+    case LEP_CID_RAD_MODULE: module = "RAD"; break;
+    case LEP_CID_SYS_MODULE: module = "SYS"; break;
+    case LEP_CID_VID_MODULE: module = "VID"; break;
+    default: module = "?"; break;
+    }
+
+    static const char *types[] = { "get", "set", "run", "?" };
+    return QString("%1 0x%2 %3").arg(module).arg(id & 0x00fc, 2, 16, QChar('0')).arg(types[id & 0x3]);
+}
 
 LEP_RESULT LeptonVariation::UVC_CustomRead(void* attributePtr, int length)
 {
@@ -353,7 +773,10 @@ LEP_RESULT LeptonVariation::UVC_CustomRead(void* attributePtr, int length)
         return LEP_ERROR;
 
     QMutexLocker lock(&m_mutex);
-    result = uvc_get_ctrl(devh, VC_CONTROL_XU_LEP_CUST_ID, CUST_CONTROL_COMMAND+1, attributePtr, length, UVC_GET_CUR);
+    QElapsedTimer timer;
+    timer.start();
+    result = m_port->getCtrl(VC_CONTROL_XU_LEP_CUST_ID, CUST_CONTROL_COMMAND+1, attributePtr, length);
+    commandStats()->recordCall(CUSTOM_STATS_ID(CUST_CONTROL_COMMAND), result == length, timer.nsecsElapsed());
     if (result != length)
     {
         printf("UVC_CustomRead failed: %d\n", result);
@@ -371,7 +794,10 @@ LEP_RESULT LeptonVariation::UVC_CustomWrite(const void* attributePtr, int length
         return LEP_ERROR;
 
     QMutexLocker lock(&m_mutex);
-    result = uvc_set_ctrl(devh, VC_CONTROL_XU_LEP_CUST_ID, CUST_CONTROL_COMMAND+1, (void*)attributePtr, length);
+    QElapsedTimer timer;
+    timer.start();
+    result = m_port->setCtrl(VC_CONTROL_XU_LEP_CUST_ID, CUST_CONTROL_COMMAND+1, (void*)attributePtr, length);
+    commandStats()->recordCall(CUSTOM_STATS_ID(CUST_CONTROL_COMMAND), result == length, timer.nsecsElapsed());
     if (result != length)
     {
         printf("UVC_CustomRead failed: %d\n", result);
@@ -389,8 +815,8 @@ LEP_RESULT LeptonVariation::UVC_I2CWriteRead(uint8_t i2cAddress,
                                              LEP_RESULT* i2cResult)
 {
     int result;
-    struct { uint16_t address; int16_t lengthWrite, lengthRead; uint8_t data[510]; } __attribute__((packed)) custom_uvc;
-    struct { LEP_RESULT result; uint8_t data[512]; } __attribute__((packed)) custom_response;
+    LeptonI2CRequest custom_uvc;
+    LeptonI2CResponse custom_response;
 
     if (writeLength > (int)sizeof(custom_uvc.data) || readLength > (int)sizeof(custom_response.data) || writeLength < -1 || readLength < -1)
         return LEP_ERROR;
@@ -415,7 +841,12 @@ LEP_RESULT LeptonVariation::UVC_I2CWriteRead(uint8_t i2cAddress,
     }
 
 
-    result = uvc_get_ctrl(devh, VC_CONTROL_XU_LEP_CUST_ID, CUST_CONTROL_I2C_WRITEREAD+1, &custom_response, sizeof(custom_response), UVC_GET_CUR);
+    QElapsedTimer timer;
+    timer.start();
+    result = m_port->getCtrl(VC_CONTROL_XU_LEP_CUST_ID, CUST_CONTROL_I2C_WRITEREAD+1, &custom_response, sizeof(custom_response));
+    commandStats()->recordCall(CUSTOM_STATS_ID(CUST_CONTROL_I2C_WRITEREAD),
+                               result == sizeof(custom_response) && custom_response.result != LEP_ERROR,
+                               timer.nsecsElapsed());
     if (result != sizeof(custom_response))
     {
         printf("UVC_I2CWriteRead failed: %d, should be %lu, %04x %02x %02x %02x %02x\n", result, sizeof(custom_response),
@@ -452,234 +883,6 @@ LEP_RESULT LeptonVariation::UVC_I2CRead(uint8_t i2cAddress,
     return UVC_I2CWriteRead(i2cAddress, "", -1, readData, readLength, i2cResult);
 }
 
-LEP_RESULT LeptonVariation::UVC_I2CScan(bool addressPresent[128], bool verbose)
-{
-    LEP_RESULT first_unusual_result = LEP_OK;
-
-    for (int i=0; i<128; i++) {
-        LEP_RESULT result, result2;
-        char buf[1];
-        // read of length 0 or 1 doesn't work well when Lepton and MLX are connected (hangs after talking to Lepton)
-        //result = UVC_I2CRead((uint8_t)i, buf, 0, &result2);
-        // use a write access with length 0, instead
-        result = UVC_I2CWrite((uint8_t)i, buf, 0, &result2);
-        if (result != LEP_OK)
-        {
-            if (verbose)
-                printf("\nERROR in UVC_I2CScan\n");
-            return result;
-        }
-
-        addressPresent[i] = (result2 == LEP_OK);
-
-        if (verbose)
-        {
-            if (i%16 == 0)
-                printf("%02x:", i);
-
-            if (result2 == LEP_OK)
-                printf(" %02x", i);
-            else if (result2 == LEP_ERROR_I2C_NACK_RECEIVED)
-                printf(" --");
-            else
-            {
-                printf(" ??");
-                if (first_unusual_result == LEP_OK)
-                    first_unusual_result = result2;
-            }
-
-            if (i%16 == 15)
-                printf("\n");
-        }
-    }
-
-    if (verbose && first_unusual_result != LEP_OK)
-        printf("Result for first ?? is %d.\n", first_unusual_result);
-
-    return LEP_OK;
-}
-
-LEP_RESULT LeptonVariation::ReadFromMLX90614(uint8_t command, uint16_t* out)
-{
-    // 0x00..0x1f is RAM, 0x20..0x3f is EEPROM. Only these parts can be accessed by this read function.
-    if (command > 0x40)
-        return LEP_ERROR;
-
-    uint8_t cmd[] = { command };
-    uint8_t reply[3];
-    LEP_RESULT i2cResult;
-    LEP_RESULT result = UVC_I2CWriteRead(0x5a, cmd, 1, reply, 3, &i2cResult);
-    if (result != LEP_OK)
-    {
-        printf("Couldn't send I2C request to PureThermal.\n");
-        return result < 0 ? result : LEP_ERROR;
-    }
-    else if (i2cResult != LEP_OK)
-    {
-        printf("I2C communication to MLX90614 didn't go as expected: %d\n", i2cResult);
-
-        if (errorsForMLX90614 < 5)
-        {
-            errorsForMLX90614++;
-            if (errorsForMLX90614 == 5)
-            {
-                printf("Giving up on MLX90614 because there were too many errors.\n");
-                hasMLX90614 = false;
-                emit irThermometerAvailableChanged();
-            }
-        }
-
-        return result < 0 ? result : LEP_ERROR_I2C_FAIL;
-    }
-    else
-    {
-        if (errorsForMLX90614 > -5)
-            errorsForMLX90614--;
-
-        //FIXME We should compare the checksum in the third byte.
-        *out = reply[0] | (reply[1] << 8);
-        return LEP_OK;
-    }
-}
-
-LEP_RESULT LeptonVariation::ReadMLX90614AmbientTemperature(uint16_t* raw, float* kelvin, bool force)
-{
-    LEP_RESULT result;
-
-    if (!hasMLX90614 && !force)
-        return LEP_FUNCTION_NOT_SUPPORTED;
-
-    uint16_t value;
-    result = ReadFromMLX90614(0x6, &value);
-    if (result < 0)
-        return result;
-
-    if (value & 0x8000)
-        // sensor tells us that the value isn't valid
-        return LEP_DATA_OUT_OF_RANGE_ERROR;
-
-    if (raw)
-        *raw = value;
-    if (kelvin)
-        *kelvin = value * 0.02;
-
-    return LEP_OK;
-}
-
-LEP_RESULT LeptonVariation::ReadMLX90614ObjectTemperature(uint16_t* raw, float* kelvin, bool force)
-{
-    LEP_RESULT result;
-
-    if (!hasMLX90614 && !force)
-        return LEP_FUNCTION_NOT_SUPPORTED;
-
-    uint16_t value;
-    result = ReadFromMLX90614(0x7, &value);
-    if (result < 0)
-        return result;
-
-    if (value & 0x8000)
-        // sensor tells us that the value isn't valid
-        return LEP_DATA_OUT_OF_RANGE_ERROR;
-
-    if (raw)
-        *raw = value;
-    if (kelvin)
-        *kelvin = value * 0.02;
-
-    return LEP_OK;
-}
-
-LEP_RESULT LeptonVariation::EnumerateMLX90614()
-{
-    LEP_RESULT result, i2cResult;
-    uint8_t buf[3];
-
-    hasMLX90614 = false;
-    errorsForMLX90614 = 0;
-    ambientTemperatureMLX90614 = -300;
-    objectTemperatureMLX90614 = -300;
-
-    if (!supportsGenericI2C)
-        return LEP_OK;
-
-    result = UVC_I2CWrite(0x5a, buf, 0, &i2cResult);
-    if (result != LEP_OK)
-    {
-        return result;
-    }
-    else if (i2cResult != LEP_OK)
-    {
-        // no reply from sensors -> probably no sensor is present
-        return LEP_OK;
-    }
-
-    result = UVC_I2CWrite(0x5a+1, buf, 0, &i2cResult);
-    if (result != LEP_OK)
-    {
-        return result;
-    }
-    else if (i2cResult == LEP_OK)
-    {
-        // unexpected reply from an address that shouldn't have any device
-        // -> Let's play it save (i.e. assume no sensors is present) to not confuse users in case of weird I2C behaviour.
-        return LEP_OK;
-    }
-
-    // Melexis hasn't documented any way of detecting an MLX90614 (or even to tell apart which type it is).
-    // Therefore, we look at some default values in EEPROM. There is no reason to change them when using
-    // the sensor in I2C mode so we assume that users. These values seem to be the same even non-original
-    // devices that differ in other regards, namely how they calculate the checksum.
-    uint16_t eeprom0, eeprom1;
-    result = ReadFromMLX90614(0x20, &eeprom0);
-    if (result != LEP_OK)
-        return result;
-    result = ReadFromMLX90614(0x21, &eeprom1);
-    if (result != LEP_OK)
-        return result;
-    if (eeprom0 != 0x9993 || eeprom1 != 0x62e3)
-    {
-        printf("We found some device at I2C address 0x5a but we got unexpected values when reading EEPROM cells 0 and 1. Therefore, we assume that it is not an MLX90614 sensor.\n");
-        return LEP_OK;
-    }
-
-    float ambientTemperature, objectTemperature;
-    result = ReadMLX90614AmbientTemperature(NULL, &ambientTemperature, true);
-    if (result != LEP_OK)
-    {
-        printf("Cannot read ambient temperature from MLX90614: %d\n", result);
-        return LEP_OK;
-    }
-
-    result = ReadMLX90614ObjectTemperature(NULL, &objectTemperature, true);
-    if (result != LEP_OK)
-    {
-        printf("Cannot read object temperature from MLX90614: %d\n", result);
-        return LEP_OK;
-    }
-
-    //NOTE Both ranges are a bit wider than what is supported according to the datasheet.
-    float ambientTemperatureCelsius = ambientTemperature - 273.15, objectTemperatureCelsius = objectTemperature - 273.15;
-    if (ambientTemperatureCelsius < -60 || ambientTemperatureCelsius > 150 || objectTemperatureCelsius < -100 || objectTemperatureCelsius > 500)
-    {
-        printf("We got unexpected temperatures from MLX90614: ambient %.2f °C, object %.2f °C\n", ambientTemperatureCelsius, objectTemperatureCelsius);
-        return LEP_OK;
-    }
-
-    printf("We found an MLX90614 connected to the PureThermal board. Current temperatures are %.2f °C (ambient, i.e. the sensor itself) and %.2f °C (object).\n",
-        ambientTemperatureCelsius, objectTemperatureCelsius);
-
-    hasMLX90614 = true;
-    ambientTemperatureMLX90614 = ambientTemperature;
-    objectTemperatureMLX90614 = objectTemperature;
-
-    emit irThermometerInKelvinChanged();
-    emit irThermometerAmbientInKelvinChanged();
-    emit irThermometerAvailableChanged();
-
-    return LEP_OK;
-}
-
 /* --------------------------------------------------------------------- */
 /* -------- static wrapper functions for use by Lepton SDK only -------- */
 /* --------------------------------------------------------------------- */
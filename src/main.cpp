@@ -1,6 +1,8 @@
 #include <QGuiApplication>
 #include <QQmlApplicationEngine>
 #include <QQmlComponent>
+#include <QQmlContext>
+#include <QCommandLineParser>
 #include <QAbstractVideoSurface>
 #include <QDebug>
 #include <libuvc/libuvc.h>
@@ -10,23 +12,183 @@
 #include "leptonvariation.h"
 #include "dataformatter.h"
 #include "rangeprovider.h"
+#include "temporalstats.h"
+#include "focusmetric.h"
+#include "remapengine.h"
+#include "motiondetector.h"
+#include "duplicatedetector.h"
+#include "frametelemetry.h"
+#include "commandexecutor.h"
+#include "commandstats.h"
+#include "i2csensormanager.h"
+#include "camerastats.h"
+#include "controlbenchmark.h"
+#include "pipelinebenchmark.h"
+#include "bosonbenchmark.h"
 
 int main(int argc, char *argv[])
 {
     QCoreApplication::setAttribute(Qt::AA_EnableHighDpiScaling);
     QGuiApplication app(argc, argv);
 
+    QCommandLineParser parser;
+    parser.addHelpOption();
+
+    // headless temporal statistics
+    QCommandLineOption statsFramesOption("stats-frames",
+            "Collect per-pixel temporal statistics over <n> frames, then export them and quit.", "n");
+    QCommandLineOption statsOutputOption("stats-output",
+            "Directory for the temporal statistics export.", "dir", "stats");
+    parser.addOption(statsFramesOption);
+    parser.addOption(statsOutputOption);
+
+    // control transfer statistics
+    QCommandLineOption commandStatsOption("command-stats",
+            "Write per-command control transfer statistics to <file> on exit.", "file");
+    parser.addOption(commandStatsOption);
+
+    // configuration files
+    QCommandLineOption exportConfigOption("export-config",
+            "Write the camera's configuration to <file>, then quit.", "file");
+    QCommandLineOption applyConfigOption("apply-config",
+            "Apply and verify the configuration in <file>, then quit.", "file");
+    parser.addOption(exportConfigOption);
+    parser.addOption(applyConfigOption);
+
+    // control path benchmark on the simulated Lepton
+    QCommandLineOption controlBenchmarkOption("control-benchmark",
+            "Run <n> rounds of the control path against a simulated Lepton, print the costs, then quit.", "n");
+    QCommandLineOption simLatencyOption("sim-latency",
+            "Simulated control transfer latency in microseconds.", "us", "1000");
+    QCommandLineOption simJitterOption("sim-jitter",
+            "Up to this much extra simulated latency per transfer, in microseconds.", "us", "500");
+    QCommandLineOption simErrorRateOption("sim-error-rate",
+            "Fraction of simulated control transfers that fail.", "fraction", "0");
+    QCommandLineOption simSeedOption("sim-seed",
+            "Seed for the simulator's latency and error draws and the virtual camera's scene.", "n", "1");
+    parser.addOption(controlBenchmarkOption);
+    parser.addOption(simLatencyOption);
+    parser.addOption(simJitterOption);
+    parser.addOption(simErrorRateOption);
+    parser.addOption(simSeedOption);
+
+    // virtual camera and its synthetic scene
+    QCommandLineOption virtualDeviceOption("virtual-device",
+            "Stream from a virtual camera with simulated controls instead of a USB device.");
+    QCommandLineOption virtualSizeOption("virtual-size",
+            "Frame size of the virtual camera.", "WxH", "160x120");
+    QCommandLineOption virtualFormatOption("virtual-format",
+            "Stream format of the virtual camera: y16, rgb24 or i420.", "format", "y16");
+    QCommandLineOption virtualFpsOption("virtual-fps",
+            "Frame rate of the virtual camera.", "fps", "8.7");
+    QCommandLineOption virtualJitterOption("virtual-jitter",
+            "Up to this much extra delay per virtual frame, in microseconds.", "us", "0");
+    QCommandLineOption virtualDropRateOption("virtual-drop-rate",
+            "Fraction of virtual frames that never arrive.", "fraction", "0");
+    QCommandLineOption virtualStallRateOption("virtual-stall-rate",
+            "Chance per virtual frame that the stream stalls.", "fraction", "0");
+    QCommandLineOption virtualStallMsOption("virtual-stall-ms",
+            "How long a virtual stream stall lasts.", "ms", "500");
+    QCommandLineOption virtualBlobsOption("virtual-blobs",
+            "Moving hot objects in the virtual camera's scene.", "n", "3");
+    QCommandLineOption virtualFfcIntervalOption("virtual-ffc-interval",
+            "Frames between FFCs in the virtual camera's scene, 0 for none.", "frames", "900");
+    parser.addOption(virtualDeviceOption);
+    parser.addOption(virtualSizeOption);
+    parser.addOption(virtualFormatOption);
+    parser.addOption(virtualFpsOption);
+    parser.addOption(virtualJitterOption);
+    parser.addOption(virtualDropRateOption);
+    parser.addOption(virtualStallRateOption);
+    parser.addOption(virtualStallMsOption);
+    parser.addOption(virtualBlobsOption);
+    parser.addOption(virtualFfcIntervalOption);
+
+    // pipeline benchmark on the virtual camera
+    QCommandLineOption pipelineBenchmarkOption("pipeline-benchmark",
+            "Stream from the virtual camera for <seconds>, print throughput, latency and drops, then quit.",
+            "seconds");
+    QCommandLineOption pipelineStagesOption("pipeline-stages",
+            "Processing to run in the pipeline benchmark besides AGC: dde, motion, focus, stats.", "list");
+    parser.addOption(pipelineBenchmarkOption);
+    parser.addOption(pipelineStagesOption);
+
+    // Boson transport benchmark
+    QCommandLineOption bosonBenchmarkOption("boson-benchmark",
+            "Time <n> command round trips on an attached Boson, print the transport's costs, then quit.", "n");
+    parser.addOption(bosonBenchmarkOption);
+
+    parser.process(app);
+
+    if (parser.isSet(controlBenchmarkOption))
+    {
+        ControlBenchmark benchmark(parser.value(controlBenchmarkOption).toInt(),
+                                   parser.value(simSeedOption).toUInt());
+        benchmark.setLatency(parser.value(simLatencyOption).toInt(), parser.value(simJitterOption).toInt());
+        benchmark.setErrorRate(parser.value(simErrorRateOption).toDouble());
+        benchmark.setCsvPath(parser.value(commandStatsOption));
+        return benchmark.run();
+    }
+    if (parser.isSet(bosonBenchmarkOption))
+    {
+        BosonBenchmark benchmark(parser.value(bosonBenchmarkOption).toInt());
+        return benchmark.run();
+    }
+
+    VirtualUvcDevice::Config virtualConfig;
+    QStringList size = parser.value(virtualSizeOption).split('x');
+    if (size.size() == 2)
+        virtualConfig.size = QSize(size[0].toInt(), size[1].toInt());
+    QString virtualFormat = parser.value(virtualFormatOption).toLower();
+    if (virtualFormat == "rgb24")
+        virtualConfig.format = QVideoFrame::Format_RGB24;
+    else if (virtualFormat == "i420")
+        virtualConfig.format = QVideoFrame::Format_YUV420P;
+    virtualConfig.fps = parser.value(virtualFpsOption).toFloat();
+    virtualConfig.jitterUs = parser.value(virtualJitterOption).toInt();
+    virtualConfig.dropRate = parser.value(virtualDropRateOption).toDouble();
+    virtualConfig.stallRate = parser.value(virtualStallRateOption).toDouble();
+    virtualConfig.stallMs = parser.value(virtualStallMsOption).toInt();
+    virtualConfig.sceneBlobs = parser.value(virtualBlobsOption).toInt();
+    virtualConfig.ffcInterval = parser.value(virtualFfcIntervalOption).toInt();
+    virtualConfig.seed = parser.value(simSeedOption).toUInt();
+
+    if (parser.isSet(pipelineBenchmarkOption))
+    {
+        PipelineBenchmark benchmark(parser.value(pipelineBenchmarkOption).toInt(), virtualConfig);
+        benchmark.setStages(parser.value(pipelineStagesOption).split(',', QString::SkipEmptyParts));
+        return benchmark.run();
+    }
+    if (parser.isSet(virtualDeviceOption))
+        UvcAcquisition::useVirtualDevice(virtualConfig);
+
     qmlRegisterType<UvcVideoProducer>("GetThermal", 1,0, "UvcVideoProducer");
     qmlRegisterType<UvcAcquisition>("GetThermal", 1,0, "UvcAcquisition");
     qmlRegisterUncreatableType<BosonVariation>("GetThermal", 1,0, "BosonVariation", "");
     qmlRegisterUncreatableType<LeptonVariation>("GetThermal", 1,0, "LeptonVariation", "");
     qmlRegisterUncreatableType<AbstractCCInterface>("GetThermal", 1,0, "AbstractCCInterface", "");
     qmlRegisterUncreatableType<DataFormatter>("GetThermal", 1,0, "DataFormatter", "");
+    qmlRegisterUncreatableType<TemporalStats>("GetThermal", 1,0, "TemporalStats", "");
+    qmlRegisterUncreatableType<FocusMetric>("GetThermal", 1,0, "FocusMetric", "");
+    qmlRegisterUncreatableType<RemapEngine>("GetThermal", 1,0, "RemapEngine", "");
+    qmlRegisterUncreatableType<MotionDetector>("GetThermal", 1,0, "MotionDetector", "");
+    qRegisterMetaType<FrameTelemetry>();
+    qmlRegisterUncreatableType<DuplicateDetector>("GetThermal", 1,0, "DuplicateDetector", "");
+    qmlRegisterUncreatableType<CommandExecutor>("GetThermal", 1,0, "CommandExecutor", "");
+    qmlRegisterUncreatableType<CommandStats>("GetThermal", 1,0, "CommandStats", "");
+    qmlRegisterUncreatableType<I2CSensor>("GetThermal", 1,0, "I2CSensor", "");
+    qmlRegisterUncreatableType<I2CSensorManager>("GetThermal", 1,0, "I2CSensorManager", "");
+    qmlRegisterUncreatableType<CameraStats>("GetThermal", 1,0, "CameraStats", "");
 
     registerLeptonVariationQmlTypes();
     registerBosonVariationQmlTypes();
 
     QQmlApplicationEngine engine;
+    engine.rootContext()->setContextProperty("statsFrames", parser.value(statsFramesOption).toInt());
+    engine.rootContext()->setContextProperty("statsOutput", parser.value(statsOutputOption));
+    engine.rootContext()->setContextProperty("commandStatsOutput", parser.value(commandStatsOption));
+    engine.rootContext()->setContextProperty("exportConfigPath", parser.value(exportConfigOption));
+    engine.rootContext()->setContextProperty("applyConfigPath", parser.value(applyConfigOption));
     engine.addImageProvider(QLatin1String("palettes"), new RangeProvider);
     engine.load(QUrl(QLatin1String("qrc:/main.qml")));
 
@@ -0,0 +1,181 @@
+#include "mlx90614.h"
+
+#include <stdio.h>
+
+#define DEFAULT_POLL_INTERVAL_MS 1000
+#define AMBIENT_POLL_DIVIDER 5
+// reads of an EEPROM cell during probe before its PEC counts as wrong
+#define PROBE_PEC_ATTEMPTS 3
+
+// 0x00..0x1f is RAM, 0x20..0x3f is EEPROM
+#define RAM_AMBIENT 0x06
+#define RAM_OBJECT 0x07
+#define EEPROM_CELL0 0x20
+#define EEPROM_CELL1 0x21
+
+// SMBus PEC: CRC-8 with polynomial x^8 + x^2 + x + 1
+uint8_t Mlx90614::smbusPec(const uint8_t *data, int length)
+{
+    uint8_t crc = 0;
+    for (int i = 0; i < length; i++)
+    {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++)
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+    }
+    return crc;
+}
+
+static bool toKelvin(uint16_t raw, float *kelvin)
+{
+    // the sensor tells us that the value isn't valid
+    if (raw & 0x8000)
+        return false;
+    *kelvin = raw * 0.02f;
+    return true;
+}
+
+Mlx90614::Mlx90614(uint8_t address, QObject *parent)
+    : I2CSensor("MLX90614", address, DEFAULT_POLL_INTERVAL_MS, parent)
+    , m_checkPec(true)
+    , m_polls(0)
+    , m_ambientKelvin(-300)
+{
+}
+
+bool Mlx90614::wordFromReply(uint8_t command, const QByteArray &reply, uint16_t *out, bool *pecOk) const
+{
+    if (reply.size() != 3)
+        return false;
+
+    // the PEC covers the whole transaction, both address bytes included
+    const uint8_t *r = (const uint8_t*)reply.constData();
+    const uint8_t address = getAddress();
+    uint8_t transaction[] = { (uint8_t)(address << 1), command, (uint8_t)((address << 1) | 1), r[0], r[1] };
+    *pecOk = smbusPec(transaction, sizeof(transaction)) == r[2];
+    *out = r[0] | (r[1] << 8);
+    return true;
+}
+
+bool Mlx90614::readWord(I2CBus *bus, uint8_t command, uint16_t *out, bool *pecOk)
+{
+    uint8_t reply[3];
+    LEP_RESULT i2cResult;
+    if (bus->i2cWriteRead(getAddress(), &command, 1, reply, sizeof(reply), &i2cResult) != LEP_OK
+            || i2cResult != LEP_OK)
+        return false;
+    return wordFromReply(command, QByteArray((const char*)reply, sizeof(reply)), out, pecOk);
+}
+
+// a genuine sensor can get a PEC wrong now and then on a noisy bus; a clone
+// gets it wrong every time
+bool Mlx90614::probeWord(I2CBus *bus, uint8_t command, uint16_t *out, bool *pecOk)
+{
+    for (int attempt = 0; attempt < PROBE_PEC_ATTEMPTS; attempt++)
+    {
+        if (!readWord(bus, command, out, pecOk))
+            return false;
+        if (*pecOk)
+            break;
+    }
+    return true;
+}
+
+bool Mlx90614::probe(I2CBus *bus)
+{
+    m_checkPec = true;
+    m_polls = 0;
+
+    // Melexis hasn't documented any way of detecting an MLX90614 (or even to tell apart which type it is).
+    // Therefore, we look at some default values in EEPROM. There is no reason to change them when using
+    // the sensor in I2C mode. These values seem to be the same even for non-original devices that differ
+    // in other regards, namely how they calculate the checksum.
+    uint16_t eeprom0, eeprom1;
+    bool pec0, pec1;
+    if (!probeWord(bus, EEPROM_CELL0, &eeprom0, &pec0) || !probeWord(bus, EEPROM_CELL1, &eeprom1, &pec1))
+        return false;
+    if (eeprom0 != 0x9993 || eeprom1 != 0x62e3)
+    {
+        printf("We found some device at I2C address 0x%02x but we got unexpected values when reading EEPROM cells 0 and 1. Therefore, we assume that it is not an MLX90614 sensor.\n",
+               getAddress());
+        return false;
+    }
+    if (!pec0 && !pec1)
+    {
+        printf("MLX90614 at 0x%02x sends PECs that don't match; assuming a clone and not checking them.\n", getAddress());
+        m_checkPec = false;
+    }
+
+    QList<Read> both = { { RAM_AMBIENT, 3 }, { RAM_OBJECT, 3 } };
+    QList<QByteArray> data;
+    for (const Read &read : both)
+    {
+        uint8_t reply[3];
+        LEP_RESULT i2cResult;
+        if (bus->i2cWriteRead(getAddress(), &read.reg, 1, reply, sizeof(reply), &i2cResult) != LEP_OK
+                || i2cResult != LEP_OK)
+        {
+            printf("Cannot read temperatures from MLX90614 at 0x%02x\n", getAddress());
+            return false;
+        }
+        data.append(QByteArray((const char*)reply, sizeof(reply)));
+    }
+
+    QVariantMap values;
+    if (!decode(both, data, &values))
+    {
+        printf("Cannot read temperatures from MLX90614 at 0x%02x\n", getAddress());
+        return false;
+    }
+
+    //NOTE Both ranges are a bit wider than what is supported according to the datasheet.
+    float ambientCelsius = values["ambient"].toFloat() - 273.15f;
+    float objectCelsius = values["object"].toFloat() - 273.15f;
+    if (ambientCelsius < -60 || ambientCelsius > 150 || objectCelsius < -100 || objectCelsius > 500)
+    {
+        printf("We got unexpected temperatures from MLX90614: ambient %.2f °C, object %.2f °C\n", ambientCelsius, objectCelsius);
+        return false;
+    }
+
+    printf("We found an MLX90614 at I2C address 0x%02x. Current temperatures are %.2f °C (ambient, i.e. the sensor itself) and %.2f °C (object).\n",
+           getAddress(), ambientCelsius, objectCelsius);
+    publishValues(values);
+    return true;
+}
+
+QList<I2CSensor::Read> Mlx90614::reads()
+{
+    QList<Read> list = { { RAM_OBJECT, 3 } };
+    if (m_polls++ % AMBIENT_POLL_DIVIDER == 0)
+        list.append({ RAM_AMBIENT, 3 });
+    return list;
+}
+
+bool Mlx90614::decode(const QList<Read> &reads, const QList<QByteArray> &data, QVariantMap *values)
+{
+    float objectKelvin = -300;
+    for (int i = 0; i < reads.size(); i++)
+    {
+        uint16_t raw;
+        bool pecOk;
+        if (!wordFromReply(reads[i].reg, data.value(i), &raw, &pecOk))
+            return false;
+        if (m_checkPec && !pecOk)
+        {
+            printf("MLX90614 at 0x%02x: PEC mismatch reading 0x%02x\n", getAddress(), reads[i].reg);
+            return false;
+        }
+
+        float kelvin;
+        if (!toKelvin(raw, &kelvin))
+            return false;
+        if (reads[i].reg == RAM_AMBIENT)
+            m_ambientKelvin = kelvin;
+        else
+            objectKelvin = kelvin;
+    }
+
+    (*values)["object"] = objectKelvin;
+    (*values)["ambient"] = m_ambientKelvin;
+    return true;
+}
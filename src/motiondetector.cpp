@@ -0,0 +1,182 @@
+#include "motiondetector.h"
+
+#include <QMutexLocker>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define BG_FRAC_BITS 8
+
+MotionDetector::MotionDetector()
+    : m_enabled(false)
+    , m_skipUnchanged(true)
+    , m_threshold(16)
+    , m_backgroundShift(5)
+    , m_maxHoldFrames(90)
+    , m_width(0)
+    , m_height(0)
+    , m_blocksX(0)
+    , m_blocksY(0)
+    , m_resetPending(true)
+    , m_changedBlocks(0)
+    , m_staticFrames(0)
+    , m_framesSinceChange(0)
+{
+}
+
+void MotionDetector::setSkipUnchanged(bool skip)
+{
+    if (m_skipUnchanged == skip)
+        return;
+    m_skipUnchanged = skip;
+    emit skipUnchangedChanged(skip);
+}
+
+void MotionDetector::setBackgroundShift(int shift)
+{
+    shift = qBound(0, shift, BG_FRAC_BITS);
+    if (m_backgroundShift == shift)
+        return;
+    m_backgroundShift = shift;
+    emit backgroundShiftChanged(shift);
+}
+
+QRect MotionDetector::getChangedRegion()
+{
+    QMutexLocker lock(&m_mutex);
+    return m_changedRegion;
+}
+
+void MotionDetector::reset()
+{
+    QMutexLocker lock(&m_mutex);
+    m_resetPending = true;
+    m_staticFrames = 0;
+}
+
+/* SAD of one row against the background, accumulated into the row's blocks,
+ * with the background pulled toward the input as we go. */
+void MotionDetector::accumulateRow(const uint16_t *in, int32_t *bg, uint32_t *sads)
+{
+    const int shift = m_backgroundShift;
+
+    for (int bx = 0; bx < m_blocksX; bx++)
+    {
+        const int begin = bx * BlockSize;
+        const int end = qMin(begin + BlockSize, m_width);
+        uint32_t sad = 0;
+        int j = begin;
+
+#if defined(__SSE2__)
+        const __m128i zero = _mm_setzero_si128();
+        __m128i acc = zero;
+        for (; j + 4 <= end; j += 4)
+        {
+            __m128i x = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)&in[j]), zero);
+            __m128i b = _mm_loadu_si128((const __m128i*)&bg[j]);
+
+            __m128i d = _mm_sub_epi32(x, _mm_srli_epi32(b, BG_FRAC_BITS));
+            __m128i sign = _mm_srai_epi32(d, 31);
+            acc = _mm_add_epi32(acc, _mm_sub_epi32(_mm_xor_si128(d, sign), sign));
+
+            __m128i step = _mm_sub_epi32(_mm_slli_epi32(x, BG_FRAC_BITS), b);
+            b = _mm_add_epi32(b, _mm_sra_epi32(step, _mm_cvtsi32_si128(shift)));
+            _mm_storeu_si128((__m128i*)&bg[j], b);
+        }
+        uint32_t lanes[4];
+        _mm_storeu_si128((__m128i*)lanes, acc);
+        sad = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+        for (; j < end; j++)
+        {
+            int32_t d = (int32_t)in[j] - (bg[j] >> BG_FRAC_BITS);
+            sad += (uint32_t)(d < 0 ? -d : d);
+            bg[j] += (((int32_t)in[j] << BG_FRAC_BITS) - bg[j]) >> shift;
+        }
+
+        sads[bx] += sad;
+    }
+}
+
+bool MotionDetector::update(const uvc_frame_t *frame)
+{
+    if (!m_enabled || frame->frame_format != UVC_FRAME_FORMAT_Y16)
+        return true;
+
+    QMutexLocker lock(&m_mutex);
+
+    const int w = frame->width, h = frame->height;
+    if (w != m_width || h != m_height || m_resetPending)
+    {
+        m_width = w;
+        m_height = h;
+        m_blocksX = (w + BlockSize - 1) / BlockSize;
+        m_blocksY = (h + BlockSize - 1) / BlockSize;
+        m_background.resize(w * h);
+        m_blockSads.resize(m_blocksX);
+        m_changedMask.fill(1, m_blocksX * m_blocksY);
+
+        for (int i = 0; i < h; i++)
+        {
+            const uint16_t *in = (const uint16_t*)((const uint8_t*)frame->data + i * frame->step);
+            for (int j = 0; j < w; j++)
+                m_background[i * w + j] = (int32_t)in[j] << BG_FRAC_BITS;
+        }
+
+        m_resetPending = false;
+        m_changedBlocks = m_blocksX * m_blocksY;
+        m_changedRegion = QRect(0, 0, w, h);
+        m_framesSinceChange = 0;
+        lock.unlock();
+        emit motionChanged();
+        return true;
+    }
+
+    int changed = 0;
+    int minX = m_blocksX, minY = m_blocksY, maxX = -1, maxY = -1;
+
+    for (int by = 0; by < m_blocksY; by++)
+    {
+        const int rowBegin = by * BlockSize;
+        const int rowEnd = qMin(rowBegin + BlockSize, h);
+
+        m_blockSads.fill(0);
+        for (int i = rowBegin; i < rowEnd; i++)
+        {
+            const uint16_t *in = (const uint16_t*)((const uint8_t*)frame->data + i * frame->step);
+            accumulateRow(in, &m_background[i * w], m_blockSads.data());
+        }
+
+        for (int bx = 0; bx < m_blocksX; bx++)
+        {
+            const int pixels = (qMin(bx * BlockSize + BlockSize, w) - bx * BlockSize) * (rowEnd - rowBegin);
+            const bool moved = m_blockSads[bx] > (uint32_t)(m_threshold * pixels);
+            m_changedMask[by * m_blocksX + bx] = moved;
+            if (moved)
+            {
+                changed++;
+                minX = qMin(minX, bx);
+                minY = qMin(minY, by);
+                maxX = qMax(maxX, bx);
+                maxY = qMax(maxY, by);
+            }
+        }
+    }
+
+    m_changedBlocks = changed;
+    m_changedRegion = changed
+            ? QRect(minX * BlockSize, minY * BlockSize,
+                    (maxX - minX + 1) * BlockSize, (maxY - minY + 1) * BlockSize).intersected(QRect(0, 0, w, h))
+            : QRect();
+
+    bool report = changed > 0 || ++m_framesSinceChange >= m_maxHoldFrames;
+    if (report)
+        m_framesSinceChange = 0;
+    else
+        m_staticFrames++;
+
+    lock.unlock();
+    emit motionChanged();
+    return report;
+}
@@ -0,0 +1,94 @@
+#include "pipelinebenchmark.h"
+#include "uvcacquisition.h"
+
+#include <QEventLoop>
+#include <QTimer>
+#include <algorithm>
+#include <stdio.h>
+#include <sys/time.h>
+
+PipelineBenchmark::PipelineBenchmark(int seconds, const VirtualUvcDevice::Config &config)
+    : m_seconds(qMax(1, seconds))
+    , m_config(config)
+{
+}
+
+static qint64 wallClockUs()
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return now.tv_sec * 1000000LL + now.tv_usec;
+}
+
+int PipelineBenchmark::run()
+{
+    UvcAcquisition::useVirtualDevice(m_config);
+    UvcAcquisition *acq = new UvcAcquisition();
+    VirtualUvcDevice *device = acq->virtualDevice();
+
+    if (m_stages.contains("dde"))
+        acq->getDataFormatter()->setProperty("detailEnhancement", true);
+    if (m_stages.contains("motion"))
+        acq->getMotion()->setProperty("enabled", true);
+    if (m_stages.contains("focus"))
+        acq->getFocusMetric()->setProperty("enabled", true);
+    if (m_stages.contains("stats"))
+        acq->getTemporalStats()->start();
+
+    QEventLoop loop;
+    QElapsedTimer clock;
+    QVector<qint64> latencies;
+    latencies.reserve((int)(m_config.fps * m_seconds) + 16);
+    quint64 received = 0, held = 0, duplicates = 0;
+    qint64 lastStart = -1;
+
+    // a queued connection, like the producer's
+    QObject::connect(acq, &UvcAcquisition::frameReady, &loop, [&](const QVideoFrame &frame) {
+        if (received == 0 && held == 0)
+            clock.start();
+        // FFC hold re-sends the last frame
+        if (frame.startTime() == lastStart)
+        {
+            held++;
+            return;
+        }
+        lastStart = frame.startTime();
+        received++;
+        if (frame.metaData("duplicate").toBool())
+            duplicates++;
+        latencies.append(wallClockUs() - frame.startTime());
+    });
+
+    QTimer::singleShot(m_seconds * 1000, &loop, &QEventLoop::quit);
+    loop.exec();
+
+    const double elapsed = clock.isValid() ? clock.nsecsElapsed() / 1e9 : 0.0;
+    const quint64 generated = device->generated(), delivered = device->delivered();
+    printf("Pipeline benchmark: %dx%d format %d at %.1f fps for %d s, stages: %s\n", m_config.size.width(),
+           m_config.size.height(), acq->videoFormat().pixelFormat(), m_config.fps, m_seconds,
+           m_stages.isEmpty() ? "agc" : qPrintable(m_stages.join(',')));
+    printf("Device: %llu generated, %llu dropped, %llu lost to stalls, %llu delivered\n",
+           generated, device->dropped(), device->stalled(), delivered);
+    printf("Pipeline: %llu frames out, %.2f fps, %llu duplicates, %llu held, %lld not out\n",
+           received, elapsed > 0 ? received / elapsed : 0.0, duplicates, held,
+           (qint64)delivered - (qint64)received);
+
+    if (!latencies.isEmpty())
+    {
+        std::sort(latencies.begin(), latencies.end());
+        qint64 total = 0;
+        for (qint64 us : latencies)
+            total += us;
+        auto percentile = [&latencies](double p) {
+            return latencies[qMin(latencies.size() - 1, (int)(latencies.size() * p))] / 1000.0;
+        };
+        printf("Latency from capture: %.2f ms average, %.2f ms p50, %.2f ms p99, %.2f ms max\n",
+               total / 1000.0 / latencies.size(), percentile(0.5), percentile(0.99),
+               latencies.last() / 1000.0);
+    }
+    printf("Host colorize %.2f ms per frame, control latency %.2f ms average\n", acq->getHostColorizeMs(),
+           acq->property("cci").value<AbstractCCInterface*>()->executor()->getAverageLatencyMs());
+
+    delete acq;
+    return received > 0 ? 0 : 1;
+}
@@ -0,0 +1,259 @@
+#include "remapengine.h"
+
+#include <QMutexLocker>
+#include <math.h>
+#include <string.h>
+
+RemapEngine::RemapEngine()
+    : m_enabled(false)
+    , m_rotation(0)
+    , m_flipH(false)
+    , m_flipV(false)
+    , m_k1(0.0f)
+    , m_k2(0.0f)
+    , m_crop(0, 0, 1, 1)
+    , m_dirty(true)
+    , m_rowPitch(0)
+{
+}
+
+// the UVC callback reads the configuration under the mutex, so changes go
+// in under it too
+template <class T>
+void RemapEngine::update(T *field, const T &value)
+{
+    {
+        QMutexLocker lock(&m_mutex);
+        *field = value;
+        m_dirty = true;
+    }
+    emit geometryChanged();
+}
+
+bool RemapEngine::isEnabled() const
+{
+    // also asked by the UVC callback
+    QMutexLocker lock(&m_mutex);
+    return m_enabled;
+}
+
+void RemapEngine::setEnabled(bool enabled)
+{
+    if (m_enabled == enabled)
+        return;
+    update(&m_enabled, enabled);
+}
+
+void RemapEngine::setRotation(int rotation)
+{
+    rotation = ((rotation % 360 + 360) % 360) / 90 * 90;
+    if (m_rotation == rotation)
+        return;
+    update(&m_rotation, rotation);
+}
+
+void RemapEngine::setFlipHorizontal(bool flip)
+{
+    if (m_flipH == flip)
+        return;
+    update(&m_flipH, flip);
+}
+
+void RemapEngine::setFlipVertical(bool flip)
+{
+    if (m_flipV == flip)
+        return;
+    update(&m_flipV, flip);
+}
+
+void RemapEngine::setK1(float k1)
+{
+    if (m_k1 == k1)
+        return;
+    update(&m_k1, k1);
+}
+
+void RemapEngine::setK2(float k2)
+{
+    if (m_k2 == k2)
+        return;
+    update(&m_k2, k2);
+}
+
+void RemapEngine::setCrop(const QRectF &crop)
+{
+    QRectF bounded = crop.intersected(QRectF(0, 0, 1, 1));
+    if (bounded.isEmpty())
+        bounded = QRectF(0, 0, 1, 1);
+    if (m_crop == bounded)
+        return;
+    update(&m_crop, bounded);
+}
+
+QSize RemapEngine::outputSize(const QSize &inputSize)
+{
+    QMutexLocker lock(&m_mutex);
+    if (!m_enabled)
+        return inputSize;
+
+    QSize cropped(qMax(2, (int)qRound(m_crop.width() * inputSize.width())),
+                  qMax(2, (int)qRound(m_crop.height() * inputSize.height())));
+    return (m_rotation % 180) ? cropped.transposed() : cropped;
+}
+
+void RemapEngine::ensureMap(const QSize &inputSize, int rowPitch)
+{
+    if (!m_dirty && inputSize == m_inputSize && rowPitch == m_rowPitch)
+        return;
+
+    m_inputSize = inputSize;
+    m_rowPitch = rowPitch;
+    buildMap();
+    m_dirty = false;
+}
+
+void RemapEngine::buildMap()
+{
+    const int inW = m_inputSize.width(), inH = m_inputSize.height();
+    const int cropX = qRound(m_crop.x() * inW), cropY = qRound(m_crop.y() * inH);
+    const int cropW = qMax(2, (int)qRound(m_crop.width() * inW));
+    const int cropH = qMax(2, (int)qRound(m_crop.height() * inH));
+    const bool transposed = (m_rotation % 180) != 0;
+
+    m_outputSize = transposed ? QSize(cropH, cropW) : QSize(cropW, cropH);
+    const int outW = m_outputSize.width(), outH = m_outputSize.height();
+
+    m_offset.resize(outW * outH);
+    m_fx.resize(outW * outH);
+    m_fy.resize(outW * outH);
+
+    // distortion is relative to the sensor center, normalized to the half diagonal
+    const float cx = (inW - 1) / 2.0f, cy = (inH - 1) / 2.0f;
+    const float norm = sqrtf(cx * cx + cy * cy);
+
+    for (int v = 0; v < outH; v++)
+    {
+        for (int u = 0; u < outW; u++)
+        {
+            int fu = m_flipH ? outW - 1 - u : u;
+            int fv = m_flipV ? outH - 1 - v : v;
+
+            // undo the rotation: (a, b) in the cropped, unrotated image
+            int a, b;
+            switch (m_rotation)
+            {
+            case 90:  a = fv;             b = cropH - 1 - fu; break;
+            case 180: a = cropW - 1 - fu; b = cropH - 1 - fv; break;
+            case 270: a = cropW - 1 - fv; b = fu;             break;
+            default:  a = fu;             b = fv;             break;
+            }
+
+            float xn = (cropX + a - cx) / norm;
+            float yn = (cropY + b - cy) / norm;
+            float r2 = xn * xn + yn * yn;
+            float scale = 1.0f + m_k1 * r2 + m_k2 * r2 * r2;
+            float x = cx + xn * scale * norm;
+            float y = cy + yn * scale * norm;
+
+            int idx = v * outW + u;
+            if (x < -0.5f || y < -0.5f || x > inW - 0.5f || y > inH - 0.5f)
+            {
+                m_offset[idx] = -1;
+                m_fx[idx] = m_fy[idx] = 0;
+                continue;
+            }
+
+            // keep the 2x2 neighbourhood inside the frame
+            x = qBound(0.0f, x, inW - 1.0f);
+            y = qBound(0.0f, y, inH - 1.0f);
+            int x0 = qMin((int)x, inW - 2);
+            int y0 = qMin((int)y, inH - 2);
+            m_offset[idx] = y0 * m_rowPitch + x0;
+            m_fx[idx] = (uint8_t)qMin(255, (int)((x - x0) * 256.0f + 0.5f));
+            m_fy[idx] = (uint8_t)qMin(255, (int)((y - y0) * 256.0f + 0.5f));
+        }
+    }
+}
+
+/* Bilinear sample with 8-bit fixed-point weights: the result is exact to
+ * within one count for 16-bit input, and the math stays in 32 bits. */
+static inline uint32_t bilerp(uint32_t p00, uint32_t p01, uint32_t p10, uint32_t p11, uint32_t fx, uint32_t fy)
+{
+    uint32_t top = p00 * (256 - fx) + p01 * fx;
+    uint32_t bottom = p10 * (256 - fx) + p11 * fx;
+    return (top * (256 - fy) + bottom * fy + 32768) >> 16;
+}
+
+bool RemapEngine::remapPalette(const uvc_frame_t *input, const uint8_t *palette,
+                               uint8_t *output, const QSize &outputSize, int outputStride)
+{
+    QMutexLocker lock(&m_mutex);
+
+    const int inStride = input->step / 2;
+    ensureMap(QSize(input->width, input->height), inStride);
+    if (outputSize != m_outputSize)
+        return false;
+
+    const int outW = m_outputSize.width(), outH = m_outputSize.height();
+    const uint16_t *src = (const uint16_t*)input->data;
+
+    for (int v = 0; v < outH; v++)
+    {
+        const int32_t *offset = &m_offset[v * outW];
+        const uint8_t *fx = &m_fx[v * outW], *fy = &m_fy[v * outW];
+        uint8_t *rgba_line = &output[v * outputStride];
+
+        for (int u = 0; u < outW; u++)
+        {
+            int32_t o = offset[u];
+            uint8_t val = 0;
+            if (o >= 0)
+            {
+                const uint16_t *p = &src[o];
+                val = (uint8_t)bilerp(p[0], p[1], p[inStride], p[inStride + 1], fx[u], fy[u]);
+            }
+            const uint8_t *rgb = &palette[val * 3];
+
+            rgba_line[u * 4 + 0] = rgb[2];
+            rgba_line[u * 4 + 1] = rgb[1];
+            rgba_line[u * 4 + 2] = rgb[0];
+            rgba_line[u * 4 + 3] = 0;
+        }
+    }
+    return true;
+}
+
+bool RemapEngine::remapRgba(const uint8_t *input, const QSize &inputSize, int inputStride,
+                            uint8_t *output, const QSize &outputSize, int outputStride)
+{
+    QMutexLocker lock(&m_mutex);
+
+    const int pitch = inputStride / 4;
+    ensureMap(inputSize, pitch);
+    if (outputSize != m_outputSize)
+        return false;
+    const uint32_t *src = (const uint32_t*)input;
+
+    const int outW = m_outputSize.width(), outH = m_outputSize.height();
+
+    for (int v = 0; v < outH; v++)
+    {
+        const int32_t *offset = &m_offset[v * outW];
+        const uint8_t *fx = &m_fx[v * outW], *fy = &m_fy[v * outW];
+        uint8_t *rgba_line = &output[v * outputStride];
+
+        for (int u = 0; u < outW; u++)
+        {
+            int32_t o = offset[u];
+            if (o < 0)
+            {
+                memset(&rgba_line[u * 4], 0, 4);
+                continue;
+            }
+            const uint8_t *p = (const uint8_t*)&src[o];
+            for (int c = 0; c < 4; c++)
+                rgba_line[u * 4 + c] = (uint8_t)bilerp(p[c], p[c + 4], p[inputStride + c], p[inputStride + c + 4], fx[u], fy[u]);
+        }
+    }
+    return true;
+}
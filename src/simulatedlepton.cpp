@@ -0,0 +1,380 @@
+#include "simulatedlepton.h"
+#include "mlx90614.h"
+#include "LEPTON_AGC.h"
+#include "LEPTON_OEM.h"
+#include "LEPTON_RAD.h"
+#include "LEPTON_SYS.h"
+#include "LEPTON_VID.h"
+
+#include <QThread>
+#include <stdio.h>
+#include <string.h>
+
+#define TELEMETRY_ROWS 2
+#define FFC_DURATION_MS 180
+#define MLX90614_ADDRESS 0x5a
+
+SimulatedMlx90614::SimulatedMlx90614(uint8_t address, bool clone)
+    : m_address(address)
+    , m_clone(clone)
+    , m_objectKelvin(296.15f)
+    , m_ambientKelvin(298.15f)
+{
+}
+
+void SimulatedMlx90614::setTemperatures(float objectKelvin, float ambientKelvin)
+{
+    m_objectKelvin = objectKelvin;
+    m_ambientKelvin = ambientKelvin;
+}
+
+bool SimulatedMlx90614::transfer(const uint8_t *writeData, int writeLength, uint8_t *readData, int readLength)
+{
+    // address only
+    if (writeLength <= 0)
+        return readLength <= 0;
+    if (writeLength != 1 || readLength != 3)
+        return false;
+
+    uint8_t command = writeData[0];
+    uint16_t word;
+    switch (command)
+    {
+    case 0x06: word = (uint16_t)(m_ambientKelvin / 0.02f + 0.5f); break;
+    case 0x07: word = (uint16_t)(m_objectKelvin / 0.02f + 0.5f); break;
+    case 0x20: word = 0x9993; break;
+    case 0x21: word = 0x62e3; break;
+    default: word = 0; break;
+    }
+
+    uint8_t transaction[] = { (uint8_t)(m_address << 1), command, (uint8_t)((m_address << 1) | 1),
+                              (uint8_t)(word & 0xff), (uint8_t)(word >> 8) };
+    readData[0] = transaction[3];
+    readData[1] = transaction[4];
+    readData[2] = Mlx90614::smbusPec(transaction, sizeof(transaction));
+    if (m_clone)
+        readData[2] ^= 0x5a;
+    return true;
+}
+
+SimulatedLepton::SimulatedLepton(quint32 seed)
+    : m_random(seed)
+    , m_sensorSize(160, 120)
+    , m_telemetry(true)
+    , m_ffcUntil(0)
+    , m_latencyUs(0)
+    , m_jitterUs(0)
+    , m_errorRate(0.0)
+    , m_transfers(0)
+    , m_injectedErrors(0)
+{
+    m_clock.start();
+    resetRegisters();
+    addI2CDevice(MLX90614_ADDRESS, new SimulatedMlx90614(MLX90614_ADDRESS));
+}
+
+SimulatedLepton::~SimulatedLepton()
+{
+    qDeleteAll(m_i2cDevices);
+}
+
+LeptonPort::Description SimulatedLepton::describe()
+{
+    Description description;
+    description.vendorId = 0x1e4e;
+    description.productId = 0x0100;
+    description.manufacturer = "GetThermal";
+    description.product = "Simulated PureThermal";
+    description.usbSerial = "v1.3.0-sim";
+    description.sensorSize = m_sensorSize;
+    if (m_telemetry)
+        description.telemetrySize = QSize(m_sensorSize.width(), m_sensorSize.height() + TELEMETRY_ROWS);
+    description.genericI2C = true;
+    printf("Using %s %s with firmware %s\n", qPrintable(description.manufacturer),
+           qPrintable(description.product), qPrintable(description.usbSerial));
+    return description;
+}
+
+quint32 SimulatedLepton::commandKey(LEP_COMMAND_ID commandID)
+{
+    int unit;
+    switch (commandID & 0x3f00)
+    {
+    case LEP_CID_AGC_MODULE: unit = VC_CONTROL_XU_LEP_AGC_ID; break;
+    case LEP_CID_OEM_MODULE: unit = VC_CONTROL_XU_LEP_OEM_ID; break;
+    case LEP_CID_RAD_MODULE: unit = VC_CONTROL_XU_LEP_RAD_ID; break;
+    case LEP_CID_SYS_MODULE: unit = VC_CONTROL_XU_LEP_SYS_ID; break;
+    case LEP_CID_VID_MODULE: unit = VC_CONTROL_XU_LEP_VID_ID; break;
+    default: unit = 0; break;
+    }
+    return registerKey(unit, ((commandID & 0x00ff) >> 2) + 1);
+}
+
+void SimulatedLepton::setRegister(LEP_COMMAND_ID commandID, const void *data, int length)
+{
+    QMutexLocker lock(&m_mutex);
+    m_registers[commandKey(commandID)] = QByteArray((const char*)data, length);
+}
+
+QByteArray SimulatedLepton::getRegister(LEP_COMMAND_ID commandID)
+{
+    QMutexLocker lock(&m_mutex);
+    return m_registers.value(commandKey(commandID));
+}
+
+// what the camera reports after power-up; only what the application looks at
+void SimulatedLepton::resetRegisters()
+{
+    m_registers.clear();
+    const uint16_t width = m_sensorSize.width(), height = m_sensorSize.height();
+    auto set = [this](LEP_COMMAND_ID commandID, const void *data, int length) {
+        m_registers[commandKey(commandID)] = QByteArray((const char*)data, length);
+    };
+
+    LEP_SYS_FLIR_SERIAL_NUMBER_T serial = 0x00000000000b2f1cULL;
+    set(LEP_CID_SYS_FLIR_SERIAL_NUMBER, &serial, sizeof(serial));
+
+    LEP_OEM_PART_NUMBER_T part;
+    memset(&part, 0, sizeof(part));
+    strncpy(part.value, "500-0771-01", sizeof(part.value) - 1);
+    set(LEP_CID_OEM_FLIR_PART_NUMBER, &part, sizeof(part));
+
+    LEP_OEM_SW_VERSION_T version = { 3, 3, 26, 3, 3, 26, 0 };
+    set(LEP_CID_OEM_SOFTWARE_VERSION, &version, sizeof(version));
+
+    LEP_SYS_FPA_TEMPERATURE_KELVIN_T fpa = 30015;
+    set(LEP_CID_SYS_FPA_TEMPERATURE_KELVIN, &fpa, sizeof(fpa));
+    LEP_SYS_AUX_TEMPERATURE_KELVIN_T aux = 29915;
+    set(LEP_CID_SYS_AUX_TEMPERATURE_KELVIN, &aux, sizeof(aux));
+
+    LEP_SYS_VIDEO_ROI_T sceneRoi = { 0, 0, (uint16_t)(width - 1), (uint16_t)(height - 1) };
+    set(LEP_CID_SYS_SCENE_ROI, &sceneRoi, sizeof(sceneRoi));
+    LEP_AGC_ROI_T agcRoi = { 0, 0, (uint16_t)(width - 1), (uint16_t)(height - 1) };
+    set(LEP_CID_AGC_ROI, &agcRoi, sizeof(agcRoi));
+
+    LEP_SYS_SCENE_STATISTICS_T scene = { 29815, 31015, 29215, (uint16_t)(width * height) };
+    set(LEP_CID_SYS_SCENE_STATISTICS, &scene, sizeof(scene));
+    LEP_AGC_HISTOGRAM_STATISTICS_T histogram = { 29215, 31015, 29815, (uint16_t)(width * height) };
+    set(LEP_CID_AGC_STATISTICS, &histogram, sizeof(histogram));
+
+    LEP_RAD_ENABLE_E enabled = LEP_RAD_ENABLE;
+    set(LEP_CID_RAD_ENABLE_STATE, &enabled, sizeof(enabled));
+    set(LEP_CID_RAD_TLINEAR_ENABLE_STATE, &enabled, sizeof(enabled));
+
+    LEP_RAD_ROI_T spotmeterRoi = { (uint16_t)(height / 2 - 1), (uint16_t)(width / 2 - 1),
+                                  (uint16_t)(height / 2), (uint16_t)(width / 2) };
+    set(LEP_CID_RAD_SPOTMETER_ROI, &spotmeterRoi, sizeof(spotmeterRoi));
+    LEP_RAD_SPOTMETER_OBJ_KELVIN_T spotmeter = { 29815, 29890, 29760, 4 };
+    set(LEP_CID_RAD_SPOTMETER_OBJ_KELVIN, &spotmeter, sizeof(spotmeter));
+}
+
+void SimulatedLepton::setSensorSize(const QSize &size)
+{
+    QMutexLocker lock(&m_mutex);
+    m_sensorSize = size;
+    resetRegisters();
+}
+
+void SimulatedLepton::setTelemetrySupported(bool supported)
+{
+    QMutexLocker lock(&m_mutex);
+    m_telemetry = supported;
+}
+
+void SimulatedLepton::setLatency(int latencyUs, int jitterUs)
+{
+    QMutexLocker lock(&m_mutex);
+    m_latencyUs = qMax(0, latencyUs);
+    m_jitterUs = qMax(0, jitterUs);
+}
+
+void SimulatedLepton::setErrorRate(double rate)
+{
+    QMutexLocker lock(&m_mutex);
+    m_errorRate = qBound(0.0, rate, 1.0);
+}
+
+void SimulatedLepton::failCommand(LEP_COMMAND_ID commandID, int count)
+{
+    QMutexLocker lock(&m_mutex);
+    m_scheduledFailures[commandKey(commandID)] = count;
+}
+
+void SimulatedLepton::addI2CDevice(uint8_t address, SimulatedI2CDevice *device)
+{
+    QMutexLocker lock(&m_mutex);
+    delete m_i2cDevices.value(address);
+    m_i2cDevices.insert(address, device);
+}
+
+// with m_mutex held; the transfer time is drawn here so runs repeat, and
+// slept by the caller once the registers are unlocked
+bool SimulatedLepton::transferFails(quint32 key, int *us)
+{
+    m_transfers++;
+
+    *us = m_latencyUs;
+    if (m_jitterUs > 0)
+        *us += std::uniform_int_distribution<int>(0, m_jitterUs)(m_random);
+
+    bool fail = false;
+    auto scheduled = m_scheduledFailures.find(key);
+    if (scheduled != m_scheduledFailures.end() && *scheduled > 0)
+    {
+        fail = true;
+        if (--*scheduled == 0)
+            m_scheduledFailures.erase(scheduled);
+    }
+    if (m_errorRate > 0 && std::uniform_real_distribution<double>(0.0, 1.0)(m_random) < m_errorRate)
+        fail = true;
+
+    if (fail)
+        m_injectedErrors++;
+    return fail;
+}
+
+// registers the camera updates by itself
+void SimulatedLepton::refreshDynamic(quint32 key)
+{
+    const qint64 now = m_clock.elapsed();
+
+    if (key == commandKey(LEP_CID_SYS_CAM_UPTIME))
+    {
+        LEP_SYS_UPTIME_NUMBER_T uptime = (LEP_SYS_UPTIME_NUMBER_T)now;
+        m_registers[key] = QByteArray((const char*)&uptime, sizeof(uptime));
+    }
+    else if (key == commandKey(LEP_CID_SYS_FFC_STATUS))
+    {
+        LEP_SYS_STATUS_E status = now < m_ffcUntil ? LEP_SYS_STATUS_BUSY : LEP_SYS_STATUS_READY;
+        m_registers[key] = QByteArray((const char*)&status, sizeof(status));
+    }
+    else if (key == commandKey(LEP_CID_SYS_SCENE_STATISTICS) && m_registers.contains(key))
+    {
+        // the scene flickers a little
+        LEP_SYS_SCENE_STATISTICS_T scene;
+        memcpy(&scene, m_registers[key].constData(), sizeof(scene));
+        int delta = std::uniform_int_distribution<int>(-4, 4)(m_random);
+        scene.meanIntensity += delta;
+        scene.maxIntensity += delta;
+        scene.minIntensity += delta;
+        m_registers[key] = QByteArray((const char*)&scene, sizeof(scene));
+    }
+}
+
+void SimulatedLepton::run(quint32 key)
+{
+    if (key == commandKey(FLR_CID_SYS_RUN_FFC) || key == commandKey(LEP_CID_RAD_RUN_FFC))
+        m_ffcUntil = m_clock.elapsed() + FFC_DURATION_MS;
+    else if (key == commandKey(LEP_CID_OEM_REBOOT))
+        resetRegisters();
+}
+
+static void sleepTransfer(int us)
+{
+    if (us > 0)
+        QThread::usleep(us);
+}
+
+int SimulatedLepton::getCtrl(uint8_t unit, uint8_t control, void *data, int length)
+{
+    int us = 0;
+    int result;
+    {
+        QMutexLocker lock(&m_mutex);
+        result = getLocked(unit, control, data, length, &us);
+    }
+    sleepTransfer(us);
+    return result;
+}
+
+int SimulatedLepton::setCtrl(uint8_t unit, uint8_t control, void *data, int length)
+{
+    int us = 0;
+    int result;
+    {
+        QMutexLocker lock(&m_mutex);
+        result = setLocked(unit, control, data, length, &us);
+    }
+    sleepTransfer(us);
+    return result;
+}
+
+int SimulatedLepton::getLocked(uint8_t unit, uint8_t control, void *data, int length, int *us)
+{
+    const quint32 key = registerKey(unit, control);
+    if (transferFails(key, us))
+        return UVC_ERROR_PIPE;
+
+    if (unit == VC_CONTROL_XU_LEP_CUST_ID)
+        return customGet(control, data, length);
+    if (unit < VC_CONTROL_XU_LEP_AGC_ID || unit > VC_CONTROL_XU_LEP_VID_ID || length <= 0)
+        return UVC_ERROR_PIPE;
+
+    refreshDynamic(key);
+    auto reg = m_registers.find(key);
+    if (reg == m_registers.end())
+        reg = m_registers.insert(key, QByteArray(length, 0));
+
+    // the firmware stalls on a size that doesn't match the attribute
+    if (reg->size() != length)
+        return UVC_ERROR_PIPE;
+    memcpy(data, reg->constData(), length);
+    return length;
+}
+
+int SimulatedLepton::setLocked(uint8_t unit, uint8_t control, const void *data, int length, int *us)
+{
+    const quint32 key = registerKey(unit, control);
+    if (transferFails(key, us))
+        return UVC_ERROR_PIPE;
+
+    if (unit == VC_CONTROL_XU_LEP_CUST_ID)
+        return customSet(control, data, length);
+    if (unit < VC_CONTROL_XU_LEP_AGC_ID || unit > VC_CONTROL_XU_LEP_VID_ID || length <= 0)
+        return UVC_ERROR_PIPE;
+
+    // a run command is a one byte set
+    if (length == 1)
+    {
+        run(key);
+        return length;
+    }
+
+    auto reg = m_registers.find(key);
+    if (reg != m_registers.end() && reg->size() != length)
+        return UVC_ERROR_PIPE;
+    m_registers[key] = QByteArray((const char*)data, length);
+    return length;
+}
+
+int SimulatedLepton::customSet(uint8_t control, const void *data, int length)
+{
+    if (control != CUST_CONTROL_COMMAND + 1 || length != (int)sizeof(LeptonI2CRequest))
+        return UVC_ERROR_PIPE;
+    m_i2cRequest = QByteArray((const char*)data, length);
+    return length;
+}
+
+// the transaction runs when its response is read
+int SimulatedLepton::customGet(uint8_t control, void *data, int length)
+{
+    if (control != CUST_CONTROL_I2C_WRITEREAD + 1 || length != (int)sizeof(LeptonI2CResponse)
+            || m_i2cRequest.size() != (int)sizeof(LeptonI2CRequest))
+        return UVC_ERROR_PIPE;
+
+    LeptonI2CRequest request;
+    memcpy(&request, m_i2cRequest.constData(), sizeof(request));
+    LeptonI2CResponse response;
+    memset(&response, 0, sizeof(response));
+
+    SimulatedI2CDevice *device = m_i2cDevices.value(request.address & 0x7f);
+    if (request.lengthWrite > (int)sizeof(request.data) || request.lengthRead > (int)sizeof(response.data))
+        response.result = LEP_ERROR;
+    else if (device == NULL || !device->transfer(request.data, request.lengthWrite, response.data, request.lengthRead))
+        response.result = LEP_ERROR_I2C_NACK_RECEIVED;
+    else
+        response.result = LEP_OK;
+
+    memcpy(data, &response, sizeof(response));
+    return length;
+}
@@ -0,0 +1,197 @@
+#include "syntheticscene.h"
+
+#include <limits.h>
+#include <math.h>
+#include <random>
+
+// counts around room temperature on a Lepton with radiometry off
+#define BACKGROUND_COUNTS 7900
+#define MAX_COUNTS 16383
+// what FFC can't take out of the fixed pattern, and what builds up until it runs
+#define RESIDUAL_FPN_SIGMA 4.0f
+#define COLUMN_FPN_SIGMA 6.0f
+#define DRIFT_FPN_SIGMA 24.0f
+#define BAD_PIXEL_RATE 0.0005
+// standard deviation of the sum of four uniform bytes
+#define BYTE_SUM_SIGMA 147.8f
+
+SyntheticScene::SyntheticScene(const QSize &size, quint32 seed)
+    : m_size(size)
+    , m_seed(seed)
+    , m_ffcInterval(900)
+    , m_ffcFrames(2)
+    , m_noiseSigma(6.0f)
+{
+    const int width = size.width(), height = size.height();
+    std::mt19937 random(seed);
+    std::normal_distribution<float> unit(0.0f, 1.0f);
+
+    QVector<float> columns(width);
+    for (int x = 0; x < width; x++)
+        columns[x] = unit(random) * COLUMN_FPN_SIGMA;
+
+    // cooler towards the top, like sky or ceiling, and a shallow left-right slope
+    m_static.resize(width * height);
+    m_drift.resize(width * height);
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            float value = BACKGROUND_COUNTS
+                    + 220.0f * y / height - 110.0f
+                    + 60.0f * x / width
+                    + columns[x] + unit(random) * RESIDUAL_FPN_SIGMA;
+            m_static[y * width + x] = (uint16_t)qBound(0.0f, value, (float)MAX_COUNTS);
+            m_drift[y * width + x] = (int16_t)(unit(random) * DRIFT_FPN_SIGMA);
+        }
+    }
+
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+    for (int i = 0; i < width * height; i++)
+    {
+        if (chance(random) >= BAD_PIXEL_RATE)
+            continue;
+        BadPixel pixel;
+        pixel.offset = i;
+        switch (random() % 3)
+        {
+        case 0: pixel.value = 0; break;
+        case 1: pixel.value = MAX_COUNTS; break;
+        default: pixel.value = (uint16_t)(BACKGROUND_COUNTS + random() % 2000 - 1000); break;
+        }
+        m_badPixels.append(pixel);
+    }
+
+    setBlobCount(3);
+}
+
+void SyntheticScene::setBlobCount(int count)
+{
+    const float width = m_size.width(), height = m_size.height();
+    std::mt19937 random(m_seed ^ 0x5bd1e995);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    m_blobs.clear();
+    for (int i = 0; i < qMax(0, count); i++)
+    {
+        Blob blob;
+        blob.x = unit(random) * width;
+        blob.y = unit(random) * height;
+        float speed = 0.2f + unit(random) * 1.3f;
+        float angle = unit(random) * 2.0f * (float)M_PI;
+        blob.vx = speed * cosf(angle);
+        blob.vy = speed * sinf(angle);
+        blob.radius = qMax(2.0f, width * (0.04f + unit(random) * 0.08f));
+        blob.amplitude = 600.0f + unit(random) * 900.0f;
+        m_blobs.append(blob);
+    }
+}
+
+void SyntheticScene::setFfcInterval(int frames, int ffcFrames)
+{
+    m_ffcInterval = qMax(0, frames);
+    m_ffcFrames = qBound(0, ffcFrames, m_ffcInterval);
+}
+
+int SyntheticScene::framesSinceFfc(quint32 index) const
+{
+    if (m_ffcInterval <= 0)
+        return (int)qMin(index, (quint32)INT_MAX);
+    return (int)(index % m_ffcInterval);
+}
+
+bool SyntheticScene::isFfcFrame(quint32 index) const
+{
+    // the camera starts out freshly corrected
+    return m_ffcInterval > 0 && index >= (quint32)m_ffcInterval && framesSinceFfc(index) < m_ffcFrames;
+}
+
+// back and forth between 0 and length
+static float bounce(float position, float length)
+{
+    float p = fmodf(position, 2.0f * length);
+    if (p < 0)
+        p += 2.0f * length;
+    return p > length ? 2.0f * length - p : p;
+}
+
+void SyntheticScene::render(quint32 index, uint16_t *data, int stride) const
+{
+    const int width = m_size.width(), height = m_size.height();
+
+    // xorshift, seeded per frame so frames don't depend on each other
+    uint32_t state = (m_seed * 0x9e3779b9u) ^ (index * 0x85ebca6bu) ^ 0xc2b2ae35u;
+    if (state == 0)
+        state = 1;
+    const int noiseScale = (int)(m_noiseSigma * 256.0f / BYTE_SUM_SIGMA);
+
+    if (isFfcFrame(index))
+    {
+        // the shutter: flat, at about the camera's own temperature
+        for (int y = 0; y < height; y++)
+        {
+            uint16_t *line = data + y * stride;
+            for (int x = 0; x < width; x++)
+            {
+                state ^= state << 13; state ^= state >> 17; state ^= state << 5;
+                int sum = (state & 0xff) + ((state >> 8) & 0xff) + ((state >> 16) & 0xff) + (state >> 24);
+                line[x] = (uint16_t)(BACKGROUND_COUNTS + 150 + (((sum - 510) * noiseScale) >> 8));
+            }
+        }
+    }
+    else
+    {
+        renderScene(index, state, noiseScale, data, stride);
+    }
+
+    // bad pixels stay bad on the shutter too
+    for (const BadPixel &pixel : m_badPixels)
+        data[(pixel.offset / width) * stride + pixel.offset % width] = pixel.value;
+}
+
+void SyntheticScene::renderScene(quint32 index, uint32_t state, int noiseScale, uint16_t *data, int stride) const
+{
+    const int width = m_size.width(), height = m_size.height();
+
+    // the fixed pattern builds up after each FFC; 1/1024ths of m_drift
+    const int driftScale = m_ffcInterval > 0 ? framesSinceFfc(index) * 1024 / m_ffcInterval : 1024;
+    // the whole scene warms and cools a little
+    const int wander = (int)(40.0f * sinf(index * 0.005f));
+
+    for (int y = 0; y < height; y++)
+    {
+        uint16_t *line = data + y * stride;
+        const uint16_t *base = m_static.constData() + y * width;
+        const int16_t *drift = m_drift.constData() + y * width;
+        for (int x = 0; x < width; x++)
+        {
+            state ^= state << 13; state ^= state >> 17; state ^= state << 5;
+            int sum = (state & 0xff) + ((state >> 8) & 0xff) + ((state >> 16) & 0xff) + (state >> 24);
+            int value = base[x] + wander + ((drift[x] * driftScale) >> 10) + (((sum - 510) * noiseScale) >> 8);
+            line[x] = (uint16_t)qBound(0, value, MAX_COUNTS);
+        }
+    }
+
+    // only the pixels a blob covers
+    for (const Blob &blob : m_blobs)
+    {
+        const float cx = bounce(blob.x + blob.vx * index, width - 1);
+        const float cy = bounce(blob.y + blob.vy * index, height - 1);
+        const float r2 = blob.radius * blob.radius;
+        const int x0 = qMax(0, (int)(cx - blob.radius)), x1 = qMin(width - 1, (int)(cx + blob.radius) + 1);
+        const int y0 = qMax(0, (int)(cy - blob.radius)), y1 = qMin(height - 1, (int)(cy + blob.radius) + 1);
+        for (int y = y0; y <= y1; y++)
+        {
+            uint16_t *line = data + y * stride;
+            const float dy2 = (y - cy) * (y - cy);
+            for (int x = x0; x <= x1; x++)
+            {
+                const float d2 = (x - cx) * (x - cx) + dy2;
+                if (d2 >= r2)
+                    continue;
+                const float falloff = 1.0f - d2 / r2;
+                line[x] = (uint16_t)qMin(MAX_COUNTS, line[x] + (int)(blob.amplitude * falloff * falloff));
+            }
+        }
+    }
+}
@@ -0,0 +1,306 @@
+#include "temporalstats.h"
+#include "rowbands.h"
+
+#include <QDir>
+#include <QFile>
+#include <QMutexLocker>
+#include <QTextStream>
+#include <math.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// recompute the scalar summaries every this many frames while running
+#define SUMMARY_INTERVAL 16
+
+TemporalStats::TemporalStats()
+    : m_running(false)
+    , m_multithreaded(true)
+    , m_kelvinPerCount(0.0f)
+    , m_targetFrames(0)
+    , m_width(0)
+    , m_height(0)
+{
+    reset();
+}
+
+/* One Welford step over n consecutive samples: mean += (x - mean) / count,
+ * M2 += (x - mean_old) * (x - mean_new). */
+static inline void welfordSpan(float *mean, float *m2, const uint16_t *x, int n, float invCount)
+{
+    int j = 0;
+#if defined(__SSE2__)
+    const __m128 vinv = _mm_set1_ps(invCount);
+    const __m128i zero = _mm_setzero_si128();
+    for (; j + 8 <= n; j += 8)
+    {
+        __m128i raw = _mm_loadu_si128((const __m128i*)&x[j]);
+        __m128 v[2] = {
+            _mm_cvtepi32_ps(_mm_unpacklo_epi16(raw, zero)),
+            _mm_cvtepi32_ps(_mm_unpackhi_epi16(raw, zero)),
+        };
+        for (int k = 0; k < 2; k++)
+        {
+            __m128 m = _mm_loadu_ps(&mean[j + k * 4]);
+            __m128 s = _mm_loadu_ps(&m2[j + k * 4]);
+            __m128 delta = _mm_sub_ps(v[k], m);
+            m = _mm_add_ps(m, _mm_mul_ps(delta, vinv));
+            s = _mm_add_ps(s, _mm_mul_ps(delta, _mm_sub_ps(v[k], m)));
+            _mm_storeu_ps(&mean[j + k * 4], m);
+            _mm_storeu_ps(&m2[j + k * 4], s);
+        }
+    }
+#endif
+    for (; j < n; j++)
+    {
+        float delta = x[j] - mean[j];
+        mean[j] += delta * invCount;
+        m2[j] += delta * (x[j] - mean[j]);
+    }
+}
+
+static inline void welfordSpan(float *mean, float *m2, const double *sum, double scale, int n, float invCount)
+{
+    for (int j = 0; j < n; j++)
+    {
+        float x = (float)(sum[j] * scale);
+        float delta = x - mean[j];
+        mean[j] += delta * invCount;
+        m2[j] += delta * (x - mean[j]);
+    }
+}
+
+static float meanStdDev(const QVector<float> &m2, int count)
+{
+    if (count < 2 || m2.isEmpty())
+        return 0.0f;
+
+    double acc = 0.0;
+    for (int i = 0; i < m2.size(); i++)
+        acc += sqrtf(m2[i] / (count - 1));
+    return (float)(acc / m2.size());
+}
+
+void TemporalStats::start(int frames, const QString &exportPath)
+{
+    {
+        QMutexLocker lock(&m_mutex);
+        m_targetFrames = frames;
+        m_exportPath = exportPath;
+        m_running = true;
+    }
+
+    reset();
+    printf("Temporal statistics started (%d frames)\n", frames);
+    emit runningChanged(true);
+}
+
+void TemporalStats::stop()
+{
+    QString path;
+    {
+        QMutexLocker lock(&m_mutex);
+        if (!m_running)
+            return;
+        m_running = false;
+        summarize();
+        path = m_exportPath;
+    }
+
+    emit runningChanged(false);
+    emit statsChanged();
+
+    if (!path.isEmpty())
+    {
+        exportMaps(path);
+        emit finished(path);
+    }
+}
+
+void TemporalStats::reset()
+{
+    QMutexLocker lock(&m_mutex);
+
+    m_count = 0;
+    m_mean.fill(0.0f);
+    m_m2.fill(0.0f);
+    m_rowMean.fill(0.0f);
+    m_rowM2.fill(0.0f);
+    m_colMean.fill(0.0f);
+    m_colM2.fill(0.0f);
+
+    m_sumT = m_sumTT = m_sumY = m_sumTY = 0.0;
+    m_temporalNoise = m_rowNoise = m_columnNoise = m_driftRate = 0.0f;
+    m_clock.start();
+}
+
+void TemporalStats::resize(int width, int height)
+{
+    m_width = width;
+    m_height = height;
+    m_count = 0;
+
+    m_mean.fill(0.0f, width * height);
+    m_m2.fill(0.0f, width * height);
+    m_rowMean.fill(0.0f, height);
+    m_rowM2.fill(0.0f, height);
+    m_colMean.fill(0.0f, width);
+    m_colM2.fill(0.0f, width);
+    m_rowSum.resize(height);
+    m_colSum.resize(width);
+}
+
+void TemporalStats::update(const uvc_frame_t *frame)
+{
+    if (frame->frame_format != UVC_FRAME_FORMAT_Y16)
+        return;
+
+    bool done = false;
+    bool summarized = false;
+    {
+        QMutexLocker lock(&m_mutex);
+
+        if (!m_running)
+            return;
+
+        if ((int)frame->width != m_width || (int)frame->height != m_height)
+            resize(frame->width, frame->height);
+
+        m_count++;
+
+        forEachRowBand(m_height, m_multithreaded, [this, frame](int rowBegin, int rowEnd) {
+            accumulateRows(frame, rowBegin, rowEnd);
+        });
+        accumulateProfiles(frame);
+
+        if (m_count % SUMMARY_INTERVAL == 0)
+        {
+            summarize();
+            summarized = true;
+        }
+
+        done = m_targetFrames > 0 && m_count >= m_targetFrames;
+    }
+
+    if (summarized)
+        emit statsChanged();
+
+    if (done)
+        QMetaObject::invokeMethod(this, "stop", Qt::QueuedConnection);
+}
+
+void TemporalStats::accumulateRows(const uvc_frame_t *frame, int rowBegin, int rowEnd)
+{
+    const float invCount = 1.0f / m_count;
+
+    for (int i = rowBegin; i < rowEnd; i++)
+    {
+        const uint16_t *line = (const uint16_t*)((const uint8_t*)frame->data + i * frame->step);
+        welfordSpan(&m_mean[i * m_width], &m_m2[i * m_width], line, m_width, invCount);
+    }
+}
+
+void TemporalStats::accumulateProfiles(const uvc_frame_t *frame)
+{
+    const float invCount = 1.0f / m_count;
+    double total = 0.0;
+
+    m_colSum.fill(0.0);
+    for (int i = 0; i < m_height; i++)
+    {
+        const uint16_t *line = (const uint16_t*)((const uint8_t*)frame->data + i * frame->step);
+        double *colSum = m_colSum.data();
+        uint32_t rowSum = 0;
+        for (int j = 0; j < m_width; j++)
+        {
+            rowSum += line[j];
+            colSum[j] += line[j];
+        }
+        m_rowSum[i] = rowSum;
+        total += rowSum;
+    }
+
+    welfordSpan(m_rowMean.data(), m_rowM2.data(), m_rowSum.constData(), 1.0 / m_width, m_height, invCount);
+    welfordSpan(m_colMean.data(), m_colM2.data(), m_colSum.constData(), 1.0 / m_height, m_width, invCount);
+
+    // least-squares fit of the frame mean over time gives the drift rate
+    double t = m_clock.elapsed() / 1000.0;
+    double y = total / (m_width * m_height);
+    m_sumT += t;
+    m_sumTT += t * t;
+    m_sumY += y;
+    m_sumTY += t * y;
+}
+
+void TemporalStats::summarize()
+{
+    m_temporalNoise = meanStdDev(m_m2, m_count);
+    m_rowNoise = meanStdDev(m_rowM2, m_count) * m_kelvinPerCount;
+    m_columnNoise = meanStdDev(m_colM2, m_count) * m_kelvinPerCount;
+
+    double denom = m_count * m_sumTT - m_sumT * m_sumT;
+    if (m_count >= 2 && denom > 0.0)
+    {
+        double countsPerSecond = (m_count * m_sumTY - m_sumT * m_sumY) / denom;
+        m_driftRate = (float)(countsPerSecond * 60.0 * m_kelvinPerCount);
+    }
+    else
+    {
+        m_driftRate = 0.0f;
+    }
+}
+
+bool TemporalStats::exportMaps(const QString &path)
+{
+    QMutexLocker lock(&m_mutex);
+
+    if (m_count < 2)
+    {
+        printf("Not enough frames for exporting temporal statistics\n");
+        return false;
+    }
+
+    summarize();
+
+    QDir dir(path);
+    if (!dir.mkpath("."))
+    {
+        printf("Cannot create directory %s\n", qPrintable(path));
+        return false;
+    }
+
+    QVector<float> stddev(m_m2.size());
+    for (int i = 0; i < m_m2.size(); i++)
+        stddev[i] = sqrtf(m_m2[i] / (m_count - 1));
+
+    // maps are raw little-endian float32, row-major, m_width x m_height
+    QFile meanFile(dir.filePath("mean.f32"));
+    QFile stddevFile(dir.filePath("stddev.f32"));
+    QFile summaryFile(dir.filePath("summary.txt"));
+    if (!meanFile.open(QIODevice::WriteOnly)
+            || !stddevFile.open(QIODevice::WriteOnly)
+            || !summaryFile.open(QIODevice::WriteOnly | QIODevice::Text))
+    {
+        printf("Cannot write temporal statistics to %s\n", qPrintable(path));
+        return false;
+    }
+
+    meanFile.write((const char*)m_mean.constData(), m_mean.size() * sizeof(float));
+    stddevFile.write((const char*)stddev.constData(), stddev.size() * sizeof(float));
+
+    QTextStream summary(&summaryFile);
+    summary << "width=" << m_width << "\n"
+            << "height=" << m_height << "\n"
+            << "frames=" << m_count << "\n"
+            << "seconds=" << m_clock.elapsed() / 1000.0 << "\n"
+            << "kelvin_per_count=" << m_kelvinPerCount << "\n"
+            << "temporal_noise_counts=" << m_temporalNoise << "\n"
+            << "netd_k=" << m_temporalNoise * m_kelvinPerCount << "\n"
+            << "row_noise_k=" << m_rowNoise << "\n"
+            << "column_noise_k=" << m_columnNoise << "\n"
+            << "drift_k_per_min=" << m_driftRate << "\n";
+
+    printf("Temporal statistics written to %s\n", qPrintable(path));
+    return true;
+}
@@ -1,11 +1,13 @@
 #include "uvcacquisition.h"
 #include "uvcbuffer.h"
+#include <QFutureWatcher>
 #include <QList>
 #include <libuvc/libuvc.h>
 
 #include "leptonvariation.h"
 #include "bosonvariation.h"
 #include "dataformatter.h"
+#include "simulatedlepton.h"
 
 //#define PLANAR_BUFFER 1
 //#define ACQ_RGB 1
@@ -15,12 +17,32 @@
 #define PT1_PID 0x0100
 #define FLIR_VID 0x09cb
 
+// host time per frame above which Auto moves pseudo-color to the camera
+#define DEFAULT_COLORIZE_BUDGET_MS 4.0f
+#define COLORIZE_CHECK_MS 2000
+// weight of the newest frame in the host cost
+#define COLORIZE_COST_SMOOTHING 0.1f
+
+VirtualUvcDevice::Config *UvcAcquisition::s_virtualConfig = NULL;
+
 UvcAcquisition::UvcAcquisition(QObject *parent)
     : QObject(parent)
     , ctx(NULL)
     , dev(NULL)
     , devh(NULL)
     , m_cci(NULL)
+    , m_virtual(NULL)
+    , m_telemetryRows(0)
+    , m_telemetryAtTop(false)
+    , m_ffcGating(FfcHold)
+    , m_awaitingFirstFrame(0)
+    , m_colorization(ColorizeAuto)
+    , m_cameraColorizing(false)
+    , m_rawFramesWanted(false)
+    , m_colorizeSwitches(0)
+    , m_colorizeBudgetMs(DEFAULT_COLORIZE_BUDGET_MS)
+    , m_hostColorizeUs(0)
+    , m_colorizeTimer(new QTimer(this))
 {
     _ids.append({ PT1_VID, PT1_PID });
     _ids.append({ FLIR_VID, 0x0000 }); // any flir camera
@@ -33,22 +55,47 @@ UvcAcquisition::UvcAcquisition(QList<UsbId> ids)
     , devh(NULL)
     , m_cci(NULL)
     , _ids(ids)
+    , m_virtual(NULL)
+    , m_telemetryRows(0)
+    , m_telemetryAtTop(false)
+    , m_ffcGating(FfcHold)
+    , m_awaitingFirstFrame(0)
+    , m_colorization(ColorizeAuto)
+    , m_cameraColorizing(false)
+    , m_rawFramesWanted(false)
+    , m_colorizeSwitches(0)
+    , m_colorizeBudgetMs(DEFAULT_COLORIZE_BUDGET_MS)
+    , m_hostColorizeUs(0)
+    , m_colorizeTimer(new QTimer(this))
 {
     init();
 }
 
+void UvcAcquisition::useVirtualDevice(const VirtualUvcDevice::Config &config)
+{
+    delete s_virtualConfig;
+    s_virtualConfig = new VirtualUvcDevice::Config(config);
+}
+
 UvcAcquisition::~UvcAcquisition()
 {
+    // the stream thread calls into the CCI on every frame, so it has to be
+    // gone first, whichever device it belongs to
+    if (m_virtual != NULL || devh != NULL)
+    {
+        stopStreaming();
+        puts("Done streaming.");
+    }
+    delete m_virtual;
+
     if (m_cci != NULL)
     {
+        m_cameraStats.setCci(NULL);
         delete m_cci;
     }
 
     if (devh != NULL)
     {
-        uvc_stop_streaming(devh);
-        puts("Done streaming.");
-
         /* Release our handle on the device */
         uvc_close(devh);
         puts("Device closed");
@@ -73,71 +120,305 @@ void UvcAcquisition::init()
 {
     uvc_error_t res;
 
-    /* Initialize a UVC service context. Libuvc will set up its own libusb
-     * context. Replace NULL with a libusb_context pointer to run libuvc
-     * from an existing libusb context. */
-    res = uvc_init(&ctx, NULL);
-
-    if (res < 0) {
-      uvc_perror(res, "uvc_init");
-      return;
+    connect(&m_remap, &RemapEngine::geometryChanged,
+            this, &UvcAcquisition::updateOutputFormat);
+
+    // stages that need the raw counts bring colorization back to the host
+    connect(&m_stats, &TemporalStats::runningChanged, this, &UvcAcquisition::updateColorization);
+    connect(&m_focus, &FocusMetric::enabledChanged, this, &UvcAcquisition::updateColorization);
+    connect(&m_motion, &MotionDetector::enabledChanged, this, &UvcAcquisition::updateColorization);
+    connect(&m_df, &DataFormatter::psuedocolorPaletteChanged, this, &UvcAcquisition::uploadPalette);
+    connect(m_colorizeTimer, &QTimer::timeout, this, &UvcAcquisition::updateColorization);
+
+    m_startupTimer.start();
+    qint64 phaseStart = 0;
+    auto phaseDone = [this, &phaseStart](const char *phase) {
+        qint64 now = m_startupTimer.elapsed();
+        printf("Startup: %s took %lld ms (%lld ms total)\n", phase, now - phaseStart, now);
+        phaseStart = now;
+    };
+
+    if (s_virtualConfig != NULL)
+    {
+        // no USB at all: a simulated Lepton of the same size answers the
+        // controls; the rendered frames have no telemetry rows, so it
+        // doesn't offer them
+        m_virtual = new VirtualUvcDevice(*s_virtualConfig);
+        SimulatedLepton *lepton = new SimulatedLepton(s_virtualConfig->seed);
+        lepton->setSensorSize(s_virtualConfig->size);
+        lepton->setTelemetrySupported(false);
+        m_cci = new LeptonVariation(lepton);
+        phaseDone("control interface");
     }
+    else
+    {
+        /* Initialize a UVC service context. Libuvc will set up its own libusb
+         * context. Replace NULL with a libusb_context pointer to run libuvc
+         * from an existing libusb context. */
+        res = uvc_init(&ctx, NULL);
+
+        if (res < 0) {
+          uvc_perror(res, "uvc_init");
+          return;
+        }
+
+        puts("UVC initialized");
+        phaseDone("uvc_init");
+
+        /* Locates the first attached UVC device, stores in dev */
+        for (int i = 0; i < _ids.size(); ++i) {
+            res = uvc_find_device(ctx, &dev, _ids[i].vid, _ids[i].pid, NULL);
+            if (res >= 0)
+                break;
+        }
+
+        if (res < 0) {
+            uvc_perror(res, "uvc_find_device"); /* no devices found */
+            return;
+        }
+
+        puts("Device found");
+        phaseDone("device search");
 
-    puts("UVC initialized");
+        /* Try to open the device: requires exclusive access */
+        res = uvc_open(dev, &devh);
 
-    /* Locates the first attached UVC device, stores in dev */
-    for (int i = 0; i < _ids.size(); ++i) {
-        res = uvc_find_device(ctx, &dev, _ids[i].vid, _ids[i].pid, NULL);
-        if (res >= 0)
+        if (res < 0) {
+            uvc_perror(res, "uvc_open"); /* unable to open device */
+
+            /* Release the device descriptor */
+            uvc_unref_device(dev);
+            dev = NULL;
+            return;
+        }
+
+        puts("Device opened");
+        phaseDone("device open");
+
+        uvc_device_descriptor_t *desc;
+        uvc_get_device_descriptor(dev, &desc);
+
+        switch (desc->idVendor)
+        {
+        case PT1_VID:
+            m_cci = new LeptonVariation(ctx, dev, devh);
             break;
+        case FLIR_VID:
+            m_cci = new BosonVariation(ctx, dev, devh);
+            break;
+        default:
+            break;
+        }
+
+        uvc_free_device_descriptor(desc);
+        phaseDone("control interface");
     }
 
-    if (res < 0) {
-        uvc_perror(res, "uvc_find_device"); /* no devices found */
+    if (m_cci != NULL)
+    {
+        connect(m_cci, &AbstractCCInterface::telemetryChanged,
+                this, &UvcAcquisition::onTelemetryChanged);
+        m_awaitingFirstFrame.storeRelease(1);
+        if (m_virtual != NULL && s_virtualConfig->format != QVideoFrame::Format_Y16)
+            setVideoFormat(QVideoSurfaceFormat(s_virtualConfig->size, s_virtualConfig->format));
+        else
+            setVideoFormat(m_cci->getDefaultFormat());
+        phaseDone("stream start");
+        m_colorizeTimer->start(COLORIZE_CHECK_MS);
+        m_cameraStats.setCci(m_cci);
+    }
+
+    /* Print out a message containing all the information that libuvc
+     * knows about the device, once the stream is on its way */
+    if (devh != NULL)
+        uvc_print_diag(devh, stderr);
+}
+
+void UvcAcquisition::setFfcGating(FfcGating gating)
+{
+    if (m_ffcGating == gating)
         return;
+    m_ffcGating = gating;
+    updateFfcMonitoring();
+    emit ffcGatingChanged(gating);
+}
+
+void UvcAcquisition::updateFfcMonitoring()
+{
+    /* Only worth asking the camera when frames are held back or skipped on
+     * the answer, and only when the stream doesn't carry it already: the
+     * telemetry rows report the FFC state with every frame, but not every
+     * format has them. */
+    if (m_cci != NULL)
+    {
+        m_cci->setFfcStateFromStream(m_telemetryRows > 0);
+        m_cci->setFfcMonitoring(m_ffcGating != FfcPassThrough && m_telemetryRows == 0);
     }
+}
 
-    puts("Device found");
+void UvcAcquisition::onTelemetryChanged()
+{
+    // telemetry changes the frame height we have to ask the camera for, and
+    // only comes with the Y16 stream
+    setVideoFormat(m_cci->getDefaultFormat());
+    if (m_cameraColorizing)
+    {
+        m_cameraColorizing = false;
+        emit colorizationChanged();
+    }
+}
 
-    /* Try to open the device: requires exclusive access */
-    res = uvc_open(dev, &devh);
+void UvcAcquisition::setColorization(Colorization colorization)
+{
+    if (m_colorization == colorization)
+        return;
+    m_colorization = colorization;
+    emit colorizationChanged();
+    updateColorization();
+}
 
-    if (res < 0) {
-        uvc_perror(res, "uvc_open"); /* unable to open device */
+void UvcAcquisition::setRawFramesWanted(bool wanted)
+{
+    if (m_rawFramesWanted == wanted)
+        return;
+    m_rawFramesWanted = wanted;
+    emit colorizationChanged();
+    updateColorization();
+}
 
-        /* Release the device descriptor */
-        uvc_unref_device(dev);
-        dev = NULL;
+void UvcAcquisition::setColorizeBudgetMs(float ms)
+{
+    ms = qMax(0.0f, ms);
+    if (m_colorizeBudgetMs == ms)
+        return;
+    m_colorizeBudgetMs = ms;
+    emit colorizationChanged();
+    updateColorization();
+}
+
+bool UvcAcquisition::needsRawFrames()
+{
+    return m_rawFramesWanted || m_stats.isRunning() || m_focus.isEnabled() || m_motion.isEnabled();
+}
+
+/* The host cost is only measured while the host colorizes; on the camera the
+ * last measurement stands, so Auto stays there until raw frames are needed
+ * or the budget is raised above it. Switching restarts the stream. */
+void UvcAcquisition::updateColorization()
+{
+    if (m_cci == NULL)
         return;
+    emit colorizeCostChanged();
+
+    const QVideoSurfaceFormat cameraFormat = m_cci->getCameraColorFormat();
+    bool camera = false;
+    if (cameraFormat.isValid() && !m_cci->getTelemetryEnabled()
+            && m_cci->getDefaultFormat().pixelFormat() == QVideoFrame::Format_Y16)
+    {
+        switch (m_colorization)
+        {
+        case ColorizeOnCamera:
+            camera = true;
+            break;
+        case ColorizeOnHost:
+            camera = false;
+            break;
+        case ColorizeAuto:
+            camera = !needsRawFrames() && getHostColorizeMs() > m_colorizeBudgetMs;
+            break;
+        }
     }
 
-    puts("Device opened");
+    if (camera == m_cameraColorizing)
+        return;
 
-    /* Print out a message containing all the information that libuvc
-     * knows about the device */
-    uvc_print_diag(devh, stderr);
+    printf("Colorizing on the %s, host cost %.2f ms per frame\n", camera ? "camera" : "host", getHostColorizeMs());
+    m_cameraColorizing = camera;
+    const quint32 request = ++m_colorizeSwitches;
+    emit colorizationChanged();
+    if (!camera)
+    {
+        setVideoFormat(m_cci->getDefaultFormat());
+        return;
+    }
+
+    // the camera keeps its old LUT until ours is in, so the stream only
+    // switches once the upload is done
+    QByteArray rgb = paletteRgb();
+    AbstractCCInterface *cci = m_cci;
+    QFutureWatcher<bool> *watcher = new QFutureWatcher<bool>(this);
+    connect(watcher, &QFutureWatcher<bool>::finished, this, [this, watcher, request, cameraFormat]() {
+        watcher->deleteLater();
+        // superseded by a later switch
+        if (request != m_colorizeSwitches || !m_cameraColorizing)
+            return;
+        if (!watcher->result())
+        {
+            puts("Palette upload failed, colorizing on the host");
+            m_cameraColorizing = false;
+            emit colorizationChanged();
+            return;
+        }
+        setVideoFormat(cameraFormat);
+    });
+    watcher->setFuture(cci->executor()->submit<bool>([cci, rgb]() { return cci->uploadPalette(rgb); }));
+}
 
-    uvc_device_descriptor_t *desc;
-    uvc_get_device_descriptor(dev, &desc);
+QByteArray UvcAcquisition::paletteRgb()
+{
+    return QByteArray((const char*)DataFormatter::getPalette(m_df.getPseudocolorPalette())->colormap, 256 * 3);
+}
+
+void UvcAcquisition::uploadPalette()
+{
+    if (m_cci == NULL || !m_cameraColorizing)
+        return;
 
-    switch (desc->idVendor)
+    QByteArray rgb = paletteRgb();
+    AbstractCCInterface *cci = m_cci;
+    cci->executor()->post([cci, rgb]() { cci->uploadPalette(rgb); });
+}
+
+FrameTelemetry UvcAcquisition::getTelemetry()
+{
+    QMutexLocker lock(&m_telemetryMutex);
+    return m_telemetry;
+}
+
+void UvcAcquisition::updateOutputFormat()
+{
+    // the image without the telemetry rows
+    const QSize size(m_uvc_format.frameWidth(), m_uvc_format.frameHeight() - m_telemetryRows);
+
+    // the remap only applies where we convert into our own RGBA buffer
+    QVideoSurfaceFormat format;
+    switch(m_uvc_format.pixelFormat())
     {
-    case PT1_VID:
-        m_cci = new LeptonVariation(ctx, dev, devh);
+    case QVideoFrame::Format_YUV420P:
+        format = QVideoSurfaceFormat(size, m_uvc_format.pixelFormat());
+        break;
+    case QVideoFrame::Format_RGB24:
+        format = QVideoSurfaceFormat(m_remap.outputSize(size), QVideoFrame::Format_RGB32);
         break;
-    case FLIR_VID:
-        m_cci = new BosonVariation(ctx, dev, devh);
+    case QVideoFrame::Format_Y16:
+        format = QVideoSurfaceFormat(m_remap.outputSize(size), QVideoFrame::Format_RGB32);
+        break;
+    case QVideoFrame::Format_YV12:
+        format = QVideoSurfaceFormat(size, m_uvc_format.pixelFormat());
         break;
     default:
+        format = QVideoSurfaceFormat(size, QVideoFrame::Format_Invalid);
         break;
     }
 
-    uvc_free_device_descriptor(desc);
-
-    if (m_cci != NULL)
     {
-        setVideoFormat(m_cci->getDefaultFormat());
+        QMutexLocker lock(&m_formatMutex);
+        m_format = format;
     }
+
+    // Notify connections of format change
+    emit formatChanged(format);
+    emit videoSizeChanged(format.frameSize());
 }
 
 void UvcAcquisition::setVideoFormat(const QVideoSurfaceFormat &format)
@@ -145,7 +426,7 @@ void UvcAcquisition::setVideoFormat(const QVideoSurfaceFormat &format)
     uvc_error_t res;
     enum uvc_frame_format uvcFormat;
 
-    uvc_stop_streaming(devh);
+    stopStreaming();
 
     switch(format.pixelFormat())
     {
@@ -163,10 +444,13 @@ void UvcAcquisition::setVideoFormat(const QVideoSurfaceFormat &format)
         break;
     }
 
-    res = uvc_get_stream_ctrl_format_size(
-                devh, &ctrl, /* result stored in ctrl */
-                uvcFormat,
-                format.frameWidth(), format.frameHeight(), 0);
+    if (m_virtual != NULL)
+        res = m_virtual->getStreamCtrl(&ctrl, uvcFormat, format.frameWidth(), format.frameHeight());
+    else
+        res = uvc_get_stream_ctrl_format_size(
+                    devh, &ctrl, /* result stored in ctrl */
+                    uvcFormat,
+                    format.frameWidth(), format.frameHeight(), 0);
 
     /* Print out the result */
     uvc_print_stream_ctrl(&ctrl, stderr);
@@ -177,42 +461,30 @@ void UvcAcquisition::setVideoFormat(const QVideoSurfaceFormat &format)
     }
 
     m_uvc_format = format;
+    m_lastFrame = QVideoFrame();
 
-    switch(format.pixelFormat())
+    m_telemetryRows = 0;
+    if (m_cci != NULL && format.pixelFormat() == QVideoFrame::Format_Y16
+            && m_cci->getTelemetryRows() < format.frameHeight())
     {
-    case QVideoFrame::Format_YUV420P:
-        m_format = QVideoSurfaceFormat(format.frameSize(), format.pixelFormat());
-        break;
-    case QVideoFrame::Format_RGB24:
-        m_format = QVideoSurfaceFormat(format.frameSize(), QVideoFrame::Format_RGB32);
-        break;
-    case QVideoFrame::Format_Y16:
-        m_format = QVideoSurfaceFormat(format.frameSize(), QVideoFrame::Format_RGB32);
-        break;
-    case QVideoFrame::Format_YV12:
-        m_format = QVideoSurfaceFormat(format.frameSize(), format.pixelFormat());
-        break;
-    default:
-        m_format = QVideoSurfaceFormat(format.frameSize(), QVideoFrame::Format_Invalid);
-        break;
+        m_telemetryRows = m_cci->getTelemetryRows();
+        m_telemetryAtTop = m_cci->getTelemetryAtTop();
+    }
+    {
+        QMutexLocker lock(&m_telemetryMutex);
+        m_telemetry = FrameTelemetry();
     }
+    updateFfcMonitoring();
 
-    // Notify connections of format change
-    emit formatChanged(m_format);
-    emit videoSizeChanged(m_format.frameSize());
+    updateOutputFormat();
 
     /* Start the video stream. The library will call user function cb:
      *   cb(frame, (void*) 12345)
      */
-    res = uvc_start_streaming(devh, &ctrl, UvcAcquisition::cb, this, 0);
-
-    if (res < 0) {
-        uvc_perror(res, "start_streaming"); /* unable to start stream */
-        uvc_close(devh);
-        puts("Device closed");
+    res = startStreaming();
 
+    if (res < 0)
         return;
-    }
 
     puts("Streaming...");
 }
@@ -224,38 +496,157 @@ void UvcAcquisition::cb(uvc_frame_t *frame, void *ptr) {
 
     UvcAcquisition *_this = static_cast<UvcAcquisition*>(ptr);
 
-    Q_ASSERT((int)frame->width == _this->m_format.frameWidth());
-    Q_ASSERT((int)frame->height == _this->m_format.frameHeight());
+    // the output format as of this frame; the GUI thread replaces it when
+    // the remap geometry changes
+    QVideoSurfaceFormat format;
+    {
+        QMutexLocker lock(&_this->m_formatMutex);
+        format = _this->m_format;
+    }
+
+    Q_ASSERT((int)frame->width == _this->m_uvc_format.frameWidth());
+    Q_ASSERT((int)frame->height == _this->m_uvc_format.frameHeight());
+
+    // wall clock time the frame came off the bus, for end-to-end latency
+    const qint64 captureUs = frame->capture_time.tv_sec * 1000000LL + frame->capture_time.tv_usec;
+
+    if (_this->m_awaitingFirstFrame.testAndSetOrdered(1, 0))
+        printf("Startup: first frame after %lld ms\n", _this->m_startupTimer.elapsed());
+
+    // control traffic backs off when frames start arriving unevenly
+    if (_this->m_cci != NULL)
+        _this->m_cci->executor()->noteFrameArrival();
+
+    // split off telemetry rows: the rest of the pipeline gets a view of the
+    // image rows in the same buffer
+    uvc_frame_t imageView;
+    FrameTelemetry telemetry;
+    if (_this->m_telemetryRows > 0)
+    {
+        const int rows = _this->m_telemetryRows;
+        const size_t telemetryBytes = rows * frame->step;
+        uint8_t *data = (uint8_t*)frame->data;
+        uint8_t *telemetryData = _this->m_telemetryAtTop ? data : data + (frame->height - rows) * frame->step;
+
+        if (_this->m_cci->parseTelemetry(telemetryData, frame->width, rows, frame->step, &telemetry))
+        {
+            QMutexLocker lock(&_this->m_telemetryMutex);
+            _this->m_telemetry = telemetry;
+        }
+
+        imageView = *frame;
+        imageView.data = _this->m_telemetryAtTop ? data + telemetryBytes : data;
+        imageView.height -= rows;
+        imageView.data_bytes -= telemetryBytes;
+        imageView.library_owns_data = 1;
+        frame = &imageView;
+
+        if (telemetry.valid)
+        {
+            _this->m_cci->updateFfcState(telemetry.ffcState == FrameTelemetry::FfcInProgress);
+            emit _this->telemetryUpdated();
+        }
+    }
+
+    // repeated frames are dropped before any stage sees them, so sinks and
+    // statistics only get new data; otherwise they are flagged in metadata
+    const bool duplicate = _this->m_duplicates.check(frame, telemetry.valid ? telemetry.frameCounter : -1);
+    if (duplicate && _this->m_duplicates.skipDuplicates())
+        return;
+
+    // frames from behind the closed shutter would skew AGC and statistics
+    if (_this->m_ffcGating != FfcPassThrough && _this->m_cci != NULL && _this->m_cci->getFfcInProgress())
+    {
+        if (_this->m_ffcGating == FfcHold && _this->m_lastFrame.isValid())
+            _this->emitFrameReady(_this->m_lastFrame);
+        return;
+    }
 
 //    QImage image((uchar*)frame->data, frame->width, frame->height, QImage::Format_RGB888);
 //    QImage image("/Users/kurt/Desktop/uvc.png");
 //    QVideoFrame qframe(image.convertToFormat(QImage::Format_ARGB32));
 
     // Need to reshape UVC input
-    if (_this->m_uvc_format.pixelFormat() != _this->m_format.pixelFormat())
+    if (_this->m_uvc_format.pixelFormat() != format.pixelFormat())
     {
         // we don't have a reason to handle frame buffers other than RGBA for now
-        Q_ASSERT(_this->m_format.pixelFormat() == QVideoFrame::Format_RGB32);
+        Q_ASSERT(format.pixelFormat() == QVideoFrame::Format_RGB32);
 
-        QVideoFrame qframe(_this->m_format.frameWidth() * _this->m_format.frameHeight() * 4,
-                           _this->m_format.frameSize(),
-                           _this->m_format.frameWidth() * 4,
-                           _this->m_format.pixelFormat());
+        if (_this->m_uvc_format.pixelFormat() == QVideoFrame::Format_Y16)
+        {
+            // these need the raw counts, so must run before AutoGain rescales in place
+            _this->m_stats.update(frame);
+            _this->m_focus.update(frame);
+
+            // nothing changed: the surface keeps showing the last frame
+            if (!_this->m_motion.update(frame) && _this->m_motion.skipUnchanged())
+                return;
+        }
+
+        // the surface expects the format's size; while a geometry change
+        // hasn't reached the format yet, frames are dropped
+        RemapEngine &remap = _this->m_remap;
+        const QSize inputSize(frame->width, frame->height);
+        const QSize outputSize = format.frameSize();
+        if (remap.outputSize(inputSize) != outputSize)
+            return;
+        const bool remapped = remap.isEnabled();
+        if (!remapped && outputSize != inputSize)
+            return;
+
+        QVideoFrame qframe(outputSize.width() * outputSize.height() * 4,
+                           outputSize,
+                           outputSize.width() * 4,
+                           format.pixelFormat());
+        // the remap can still change before it is applied, and then refuses
+        bool converted = true;
 
         if (_this->m_uvc_format.pixelFormat() == QVideoFrame::Format_Y16)
         {
-            _this->m_df.AutoGain(frame);
-            _this->m_df.Colorize(frame, qframe);
+            QElapsedTimer colorizeTimer;
+            colorizeTimer.start();
+
+            // the camera's range spares the full min/max pass when it fits this frame
+            uint16_t cameraMin, cameraMax;
+            if (_this->m_cameraStats.lookup(inputSize, &cameraMin, &cameraMax))
+            {
+                _this->m_df.AutoGain(frame, cameraMin, cameraMax);
+            }
+            else
+            {
+                _this->m_df.AutoGain(frame);
+                _this->m_cameraStats.noteHostRange(inputSize, _this->m_df.getMinVal(), _this->m_df.getMaxVal());
+            }
+            if (remapped)
+                converted = _this->m_df.Colorize(frame, qframe, remap);
+            else
+                _this->m_df.Colorize(frame, qframe);
+
+            int us = (int)(colorizeTimer.nsecsElapsed() / 1000);
+            int average = _this->m_hostColorizeUs.load();
+            _this->m_hostColorizeUs.store(average ? average + (int)((us - average) * COLORIZE_COST_SMOOTHING) : us);
         }
         else if (_this->m_uvc_format.pixelFormat() == QVideoFrame::Format_RGB24)
         {
             qframe.map(QAbstractVideoBuffer::WriteOnly);
-            for (int i = 0; i < qframe.height(); i++)
+
+            // with a remap, expand to RGBA in scratch first so the bilinear
+            // gather works on whole pixels
+            uchar *rgba = qframe.bits();
+            int rgbaStride = qframe.bytesPerLine();
+            if (remapped)
+            {
+                rgbaStride = frame->width * 4;
+                _this->m_rgbaScratch.resize(rgbaStride * frame->height);
+                rgba = _this->m_rgbaScratch.data();
+            }
+
+            for (uint32_t i = 0; i < frame->height; i++)
             {
                 uchar* rgb_line = &((uchar*)frame->data)[frame->step * i];
-                uchar* rgba_line = &qframe.bits()[qframe.bytesPerLine() * i];
+                uchar* rgba_line = &rgba[rgbaStride * i];
 
-                for (int j = 0; j < qframe.width(); j++)
+                for (uint32_t j = 0; j < frame->width; j++)
                 {
                     rgba_line[j * 4 + 0] = rgb_line[j * 3 + 0];
                     rgba_line[j * 4 + 1] = rgb_line[j * 3 + 1];
@@ -263,15 +654,28 @@ void UvcAcquisition::cb(uvc_frame_t *frame, void *ptr) {
                     rgba_line[j * 4 + 3] = 0;
                 }
             }
+
+            if (remapped)
+                converted = remap.remapRgba(rgba, inputSize, rgbaStride, qframe.bits(), outputSize, qframe.bytesPerLine());
+
             qframe.unmap();
         }
+        if (!converted)
+            return;
+        qframe.setMetaData("duplicate", duplicate);
+        qframe.setStartTime(captureUs);
+        if (telemetry.valid)
+            qframe.setMetaData("telemetry", QVariant::fromValue(telemetry));
+        _this->m_lastFrame = qframe;
         _this->emitFrameReady(qframe);
     }
     else
     {
         UvcBuffer *buffer = new UvcBuffer();
         buffer->setBackendBuffer((uchar*)frame->data, frame->width, frame->height, frame->step, frame->data_bytes);
-        QVideoFrame qframe(buffer, _this->m_format.frameSize(), _this->m_format.pixelFormat());
+        QVideoFrame qframe(buffer, format.frameSize(), format.pixelFormat());
+        qframe.setMetaData("duplicate", duplicate);
+        qframe.setStartTime(captureUs);
         _this->emitFrameReady(qframe);
     }
 }
@@ -282,17 +686,36 @@ void UvcAcquisition::emitFrameReady(const QVideoFrame &frame)
 }
 
 void UvcAcquisition::pauseStream() {
-    uvc_stop_streaming(devh);
+    stopStreaming();
 }
 
 void UvcAcquisition::resumeStream() {
-    uvc_error_t res = uvc_start_streaming(devh, &ctrl, UvcAcquisition::cb, this, 0);
+    startStreaming();
+}
+
+uvc_error_t UvcAcquisition::startStreaming()
+{
+    uvc_error_t res;
+    if (m_virtual != NULL)
+        res = m_virtual->startStreaming(&ctrl, UvcAcquisition::cb, this);
+    else
+        res = uvc_start_streaming(devh, &ctrl, UvcAcquisition::cb, this, 0);
 
     if (res < 0) {
         uvc_perror(res, "start_streaming"); /* unable to start stream */
-        uvc_close(devh);
-        puts("Device closed");
-
-        return;
+        if (m_virtual == NULL)
+        {
+            uvc_close(devh);
+            puts("Device closed");
+        }
     }
+    return res;
+}
+
+void UvcAcquisition::stopStreaming()
+{
+    if (m_virtual != NULL)
+        m_virtual->stopStreaming();
+    else if (devh != NULL)
+        uvc_stop_streaming(devh);
 }
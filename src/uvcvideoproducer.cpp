@@ -31,8 +31,12 @@ void UvcVideoProducer::setVideoSurface(QAbstractVideoSurface *surface)
 void UvcVideoProducer::setUvc(UvcAcquisition *uvc)
 {
     if (m_uvc)
+    {
         disconnect(m_uvc, &UvcAcquisition::frameReady,
                    this, &UvcVideoProducer::onNewVideoContentReceived);
+        disconnect(m_uvc, &UvcAcquisition::formatChanged,
+                   this, &UvcVideoProducer::onFormatChanged);
+    }
 
     m_uvc = uvc;
     emit uvcChanged(uvc);
@@ -54,6 +58,8 @@ void UvcVideoProducer::setUvc(UvcAcquisition *uvc)
 
     connect(m_uvc, &UvcAcquisition::frameReady,
             this, &UvcVideoProducer::onNewVideoContentReceived);
+    connect(m_uvc, &UvcAcquisition::formatChanged,
+            this, &UvcVideoProducer::onFormatChanged);
 }
 
 void UvcVideoProducer::onNewVideoContentReceived(const QVideoFrame &frame)
@@ -61,3 +67,15 @@ void UvcVideoProducer::onNewVideoContentReceived(const QVideoFrame &frame)
     if (m_surface)
         m_surface->present(frame);
 }
+
+void UvcVideoProducer::onFormatChanged(const QVideoSurfaceFormat &format)
+{
+    // e.g. a rotation swaps width and height; the surface has to be restarted
+    if (!m_surface || (m_surface->isActive() && m_surface->surfaceFormat() == format))
+        return;
+
+    if (m_surface->isActive())
+        m_surface->stop();
+
+    m_surface->start(format);
+}
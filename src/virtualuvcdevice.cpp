@@ -0,0 +1,209 @@
+#include "virtualuvcdevice.h"
+#include "functionthread.h"
+
+#include <QElapsedTimer>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+VirtualUvcDevice::Config::Config()
+    : size(160, 120)
+    , format(QVideoFrame::Format_Y16)
+    , fps(8.7f)
+    , jitterUs(0)
+    , dropRate(0.0)
+    , stallRate(0.0)
+    , stallMs(0)
+    , sceneBlobs(3)
+    , ffcInterval(900)
+    , seed(1)
+{
+}
+
+VirtualUvcDevice::VirtualUvcDevice(const Config &config)
+    : m_config(config)
+    , m_random(config.seed)
+    , m_format(UVC_FRAME_FORMAT_UNKNOWN)
+    , m_scene(NULL)
+    , m_cb(NULL)
+    , m_user(NULL)
+    , m_thread(NULL)
+    , m_running(0)
+    , m_generated(0)
+    , m_delivered(0)
+    , m_dropped(0)
+    , m_stalled(0)
+{
+    m_config.fps = qMax(0.1f, m_config.fps);
+    printf("Virtual UVC device: %dx%d at %.1f fps, jitter %d us, drop rate %.3f, stall rate %.3f for %d ms\n",
+           m_config.size.width(), m_config.size.height(), m_config.fps, m_config.jitterUs,
+           m_config.dropRate, m_config.stallRate, m_config.stallMs);
+}
+
+VirtualUvcDevice::~VirtualUvcDevice()
+{
+    stopStreaming();
+    delete m_scene;
+}
+
+uvc_error_t VirtualUvcDevice::getStreamCtrl(uvc_stream_ctrl_t *ctrl, uvc_frame_format format, int width, int height)
+{
+    switch (format)
+    {
+    case UVC_FRAME_FORMAT_Y16:
+    case UVC_FRAME_FORMAT_RGB:
+    case UVC_FRAME_FORMAT_I420:
+        break;
+    default:
+        return UVC_ERROR_INVALID_MODE;
+    }
+    if (width <= 0 || height <= 0 || (format == UVC_FRAME_FORMAT_I420 && (width % 2 || height % 2)))
+        return UVC_ERROR_INVALID_MODE;
+
+    memset(ctrl, 0, sizeof(*ctrl));
+    ctrl->bmHint = 1;
+    ctrl->bFormatIndex = format == UVC_FRAME_FORMAT_Y16 ? 1 : format == UVC_FRAME_FORMAT_RGB ? 2 : 3;
+    ctrl->bFrameIndex = 1;
+    ctrl->dwFrameInterval = (uint32_t)(10000000 / m_config.fps);
+
+    m_format = format;
+    if (m_scene == NULL || m_frameSize != QSize(width, height))
+    {
+        // the same scene for the same size, so format switches don't change it
+        m_frameSize = QSize(width, height);
+        delete m_scene;
+        m_scene = new SyntheticScene(m_frameSize, m_config.seed);
+        m_scene->setBlobCount(m_config.sceneBlobs);
+        m_scene->setFfcInterval(m_config.ffcInterval, qMax(1, (int)(m_config.fps * 0.2f)));
+    }
+    return UVC_SUCCESS;
+}
+
+uvc_error_t VirtualUvcDevice::startStreaming(uvc_stream_ctrl_t *ctrl, uvc_frame_callback_t *cb, void *user)
+{
+    Q_UNUSED(ctrl);
+    if (m_format == UVC_FRAME_FORMAT_UNKNOWN)
+        return UVC_ERROR_INVALID_MODE;
+    if (m_thread != NULL)
+        return UVC_ERROR_BUSY;
+
+    m_cb = cb;
+    m_user = user;
+    m_running.storeRelease(1);
+    m_thread = new FunctionThread([this]() { run(); });
+    m_thread->setObjectName("VirtualUvcDevice");
+    m_thread->start(QThread::TimeCriticalPriority);
+    return UVC_SUCCESS;
+}
+
+void VirtualUvcDevice::stopStreaming()
+{
+    if (m_thread == NULL)
+        return;
+    m_running.storeRelease(0);
+    m_thread->wait();
+    delete m_thread;
+    m_thread = NULL;
+}
+
+/* Frames are due on a fixed schedule from the start of the stream, so
+ * jitter delays a frame without pushing back the ones after it. */
+void VirtualUvcDevice::run()
+{
+    const qint64 intervalNs = (qint64)(1e9 / m_config.fps);
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+    std::uniform_int_distribution<int> jitter(0, qMax(0, m_config.jitterUs));
+
+    QElapsedTimer clock;
+    clock.start();
+    quint32 sequence = 0;
+    while (m_running.loadAcquire())
+    {
+        qint64 due = sequence * intervalNs + jitter(m_random) * 1000LL;
+        qint64 wait = due - clock.nsecsElapsed();
+        if (wait > 0)
+            QThread::usleep(wait / 1000);
+        if (!m_running.loadAcquire())
+            break;
+
+        if (m_config.stallMs > 0 && chance(m_random) < m_config.stallRate)
+        {
+            QThread::msleep(m_config.stallMs);
+            quint32 resume = (quint32)(clock.nsecsElapsed() / intervalNs) + 1;
+            m_stalled.fetchAndAddRelaxed(resume - sequence);
+            sequence = resume;
+            continue;
+        }
+
+        m_generated.fetchAndAddRelaxed(1);
+        if (chance(m_random) < m_config.dropRate)
+        {
+            m_dropped.fetchAndAddRelaxed(1);
+            sequence++;
+            continue;
+        }
+
+        uvc_frame_t frame;
+        fill(&frame, sequence);
+        m_cb(&frame, m_user);
+        m_delivered.fetchAndAddRelaxed(1);
+        sequence++;
+    }
+}
+
+void VirtualUvcDevice::fill(uvc_frame_t *frame, quint32 sequence)
+{
+    const int width = m_frameSize.width(), height = m_frameSize.height();
+    size_t step, bytes;
+    switch (m_format)
+    {
+    case UVC_FRAME_FORMAT_Y16: step = width * 2; bytes = step * height; break;
+    case UVC_FRAME_FORMAT_RGB: step = width * 3; bytes = step * height; break;
+    default: step = width; bytes = width * height * 3 / 2; break;
+    }
+    m_buffer.resize(bytes);
+    uint8_t *data = m_buffer.data();
+
+    if (m_format == UVC_FRAME_FORMAT_Y16)
+    {
+        m_scene->render(sequence, (uint16_t*)data, width);
+    }
+    else
+    {
+        m_counts.resize(width * height);
+        m_scene->render(sequence, m_counts.data(), width);
+        for (int y = 0; y < height; y++)
+        {
+            const uint16_t *counts = m_counts.constData() + y * width;
+            uint8_t *line = data + y * step;
+            for (int x = 0; x < width; x++)
+            {
+                // room temperature to a few hundred counts above it
+                const uint8_t v = (uint8_t)qBound(0, (counts[x] - 7600) / 6, 255);
+                if (m_format == UVC_FRAME_FORMAT_RGB)
+                {
+                    line[x * 3 + 0] = v;
+                    line[x * 3 + 1] = v;
+                    line[x * 3 + 2] = v;
+                }
+                else
+                {
+                    line[x] = v;
+                }
+            }
+        }
+        if (m_format == UVC_FRAME_FORMAT_I420)
+            memset(data + width * height, 128, width * height / 2);
+    }
+
+    memset(frame, 0, sizeof(*frame));
+    frame->data = data;
+    frame->data_bytes = bytes;
+    frame->width = width;
+    frame->height = height;
+    frame->frame_format = m_format;
+    frame->step = step;
+    frame->sequence = sequence;
+    gettimeofday(&frame->capture_time, NULL);
+    frame->library_owns_data = 1;
+}
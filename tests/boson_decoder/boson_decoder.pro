@@ -0,0 +1,19 @@
+# Checks the Boson frame decoder against random chunkings, bad CRCs and
+# frames for other channels, then times it. No camera needed:
+#   qmake && make check
+
+TEMPLATE = app
+TARGET = tst_boson_decoder
+CONFIG += console testcase link_pkgconfig
+CONFIG -= qt app_bundle
+
+INCLUDEPATH += ../../boson_sdk ../../lepton_sdk/Inc
+
+SOURCES += \
+    tst_boson_decoder.c \
+    ../../boson_sdk/flirChannels.c \
+    ../../boson_sdk/flirCRC.c \
+    ../../lepton_sdk/Src/crc16fast.c
+
+PKGCONFIG += libusb-1.0
+unix:LIBS += -lpthread
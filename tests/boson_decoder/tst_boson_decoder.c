@@ -0,0 +1,201 @@
+/* The decoder is static in the transport, so it is built in here with it.
+ * Nothing below opens a device; libusb is only linked. */
+#include "libusb_binary_protocol.c"
+
+#include <stdlib.h>
+
+#define ITERATIONS      2000
+#define BENCH_ROUNDS    200
+#define BENCH_CHUNK     512
+#define MAX_PAYLOAD     1500
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+static uint32_t seed = 1;
+
+// the same sequence on every platform, unlike rand()
+static uint32_t next_random(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 16) & 0x7fff;
+}
+
+static int escape_into(uint8_t *out, uint8_t c)
+{
+    switch (c) {
+    case START_FRAME_BYTE:
+        out[0] = ESCAPE_BYTE;
+        out[1] = ESCAPED_START_FRAME_BYTE;
+        return 2;
+    case END_FRAME_BYTE:
+        out[0] = ESCAPE_BYTE;
+        out[1] = ESCAPED_END_FRAME_BYTE;
+        return 2;
+    case ESCAPE_BYTE:
+        out[0] = ESCAPE_BYTE;
+        out[1] = ESCAPED_ESCAPE_BYTE;
+        return 2;
+    default:
+        out[0] = c;
+        return 1;
+    }
+}
+
+// a frame on any channel, with its CRC spoiled if corrupt
+static int make_frame(uint8_t *out, uint8_t channel_ID, const uint8_t *payload, int len, int corrupt)
+{
+    uint16_t crc = FLIR_CRC_INITIAL_VALUE;
+    int i, n = 0;
+
+    crc = updateFlirCRC16Bytes(crc, 1, &channel_ID);
+    crc = updateFlirCRC16Bytes(crc, len, payload);
+    if (corrupt)
+        crc ^= 1;
+
+    out[n++] = START_FRAME_BYTE;
+    n += escape_into(&out[n], channel_ID);
+    for (i = 0; i < len; i++)
+        n += escape_into(&out[n], payload[i]);
+    n += escape_into(&out[n], (crc >> 8) & 0xFF);
+    n += escape_into(&out[n], crc & 0xFF);
+    out[n++] = END_FRAME_BYTE;
+    return n;
+}
+
+// random bytes, a quarter of them ones that need escaping
+static void fill_payload(uint8_t *payload, int len)
+{
+    static const uint8_t special[] = { START_FRAME_BYTE, END_FRAME_BYTE, ESCAPE_BYTE, ESCAPED_ESCAPE_BYTE };
+    int i;
+    for (i = 0; i < len; i++)
+        payload[i] = next_random() % 4 == 0 ? special[next_random() % 4] : (uint8_t)next_random();
+}
+
+static void clear_channel(CHANNEL_T *channel)
+{
+    drop_bytes(channel->len, channel);
+}
+
+/* Unframed bytes, a frame each for a known and an unknown other channel, a
+ * command frame with a bad CRC, then two good command frames; fed in
+ * chunks of random size, only the two good ones may come out. */
+static void test_stream(int iteration)
+{
+    static uint8_t stream[4 * 2 * (MAX_PAYLOAD + 8) + 64];
+    uint8_t payload[2][MAX_PAYLOAD], other[300];
+    int lengths[2], other_len, i, len = 0, pos = 0, got = 0;
+    int max_chunk = iteration % 3 == 0 ? 3 : 700;
+    struct frame_decoder dec;
+    CHANNEL_T *unframed, *debug;
+    uint32_t used;
+
+    get_unframed(&unframed);
+    get_channel(0x99, &debug);
+
+    for (i = 0; i < 5; i++)
+        stream[len++] = next_random() % 0x80;
+    other_len = next_random() % sizeof(other);
+    fill_payload(other, other_len);
+    len += make_frame(&stream[len], 0x99, other, other_len, 0);
+    len += make_frame(&stream[len], 0x42, other, other_len, 0);
+    len += make_frame(&stream[len], 0x00, other, other_len, 1);
+    for (i = 0; i < 2; i++) {
+        lengths[i] = next_random() % MAX_PAYLOAD;
+        fill_payload(payload[i], lengths[i]);
+        len += make_frame(&stream[len], 0x00, payload[i], lengths[i], 0);
+    }
+
+    init_decoder(&dec, 0x00, unframed);
+    while (pos < len && got < 2) {
+        uint32_t chunk = 1 + next_random() % max_chunk;
+        if (chunk > (uint32_t)(len - pos))
+            chunk = len - pos;
+        while (chunk > 0) {
+            if (decode_block(&dec, &stream[pos], chunk, &used)) {
+                CHECK(got < 2);
+                if (got < 2) {
+                    CHECK(dec.len - NUM_FRAMING_BYTES == (uint32_t)lengths[got]);
+                    CHECK(memcmp(&dec.buf[FRAME_START_IDX], payload[got], lengths[got]) == 0);
+                }
+                got++;
+            }
+            pos += used;
+            chunk -= used;
+        }
+    }
+    CHECK(got == 2);
+
+    // the known channel's frame was put aside whole, as read_frame finds it
+    uint8_t *span;
+    int32_t span_len;
+    init_decoder(&dec, 0x99, NULL);
+    got = 0;
+    while (!got && (span_len = peek_bytes(&span, debug)) > 0) {
+        got = decode_block(&dec, span, span_len, &used);
+        drop_bytes(used, debug);
+    }
+    CHECK(got);
+    if (got) {
+        CHECK(dec.len - NUM_FRAMING_BYTES == (uint32_t)other_len);
+        CHECK(memcmp(&dec.buf[FRAME_START_IDX], other, other_len) == 0);
+    }
+
+    // the unknown one went out with the unframed bytes
+    CHECK(unframed->len >= 5 + other_len);
+
+    clear_channel(debug);
+    clear_channel(unframed);
+}
+
+// MB/s of framed input, in blocks the size of an IN transfer
+static void bench(void)
+{
+    static uint8_t stream[1 << 20];
+    uint8_t payload[1000];
+    int len = 0, round, frames = 0, expected = 0;
+    struct timespec start, end;
+    struct frame_decoder dec;
+    uint32_t used;
+
+    fill_payload(payload, sizeof(payload));
+    while (len + 2 * (int)sizeof(payload) + 8 < (int)sizeof(stream)) {
+        len += make_frame(&stream[len], 0x00, payload, sizeof(payload), 0);
+        expected++;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (round = 0; round < BENCH_ROUNDS; round++) {
+        int pos = 0;
+        init_decoder(&dec, 0x00, NULL);
+        while (pos < len) {
+            int chunk = len - pos < BENCH_CHUNK ? len - pos : BENCH_CHUNK;
+            frames += decode_block(&dec, &stream[pos], chunk, &used);
+            pos += used;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    CHECK(frames == expected * BENCH_ROUNDS);
+    printf("Decoded %d frames at %.0f MB/s\n", frames,
+           (double)BENCH_ROUNDS * len / diff_timespec(&end, &start) / 1e6);
+}
+
+int main(void)
+{
+    int i;
+
+    initialize_channels();
+    for (i = 0; i < ITERATIONS; i++)
+        test_stream(i);
+    printf("%d streams decoded, %d failures\n", ITERATIONS, failures);
+
+    bench();
+    return failures ? 1 : 0;
+}